@@ -5,6 +5,7 @@
 #include "jemalloc.h"
 #endif
 #include "assoc_array.h"
+#include "ht_mem.h"
 #include "mock_mem_functions.h"
 
 // redefine mem functions with custom version
@@ -38,10 +39,73 @@ static void free_assoc_array_entry(void *entry) {
   free(assoc_entry); // Free the entry itself
 }
 
+// default free_entry of ARRAY_POOL arrays, the entry itself goes back to the pool
+static void free_assoc_array_pooled_entry(void *entry) {
+  assoc_array_entry_t *assoc_entry = (assoc_array_entry_t *)entry;
+  free(assoc_entry->data);
+  free(assoc_entry->key);
+}
+
+// ARRAY_STABLE: array_add() already copied the key into the entry
+static int fill_assoc_array_inline_entry(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size) {
+  entry->key_size = key_size;
+  entry->data = data;
+  return 0;
+}
+
+static void free_assoc_array_inline_entry(void *entry) {
+  (void)entry; // inline key and entry go back to the pool, data is not owned
+}
+
+static inline bool array_is_ordered(const assoc_array_t *arr) {
+  return !(arr->flags & ARRAY_UNORDERED);
+}
+
+static inline assoc_array_entry_t *array_alloc_entry(assoc_array_t *arr) {
+  return arr->pool ? mempool_alloc(arr->pool) : malloc(arr->entry_size);
+}
+
+static inline void array_put_entry(assoc_array_t *arr, assoc_array_entry_t *entry) {
+  if (arr->pool)
+    mempool_free(arr->pool, entry);
+  else
+    free(entry);
+}
+
+static void array_free_entry_now(assoc_array_t *arr, assoc_array_entry_t *entry) {
+  arr->free_entry(entry); // frees the entry too unless it is pooled
+  if (arr->pool) mempool_free(arr->pool, entry);
+}
+
+static void array_free_entry_deferred(void *entry, void *arr) {
+  array_free_entry_now(arr, entry);
+}
+
+// release an entry already unlinked from the hashtable and the list
+static inline void array_release_entry(assoc_array_t *arr, assoc_array_entry_t *entry) {
+  if (arr->qsbr)
+    qsbr_defer(arr->qsbr, array_free_entry_deferred, entry, arr); // lock-free readers may still hold it
+  else
+    array_free_entry_now(arr, entry);
+}
+
+static inline void array_unhash_entry(assoc_array_t *arr, assoc_array_entry_t *entry) {
+  if (arr->qsbr)
+    hlist_del_rcu(&entry->hnode);
+  else
+    hlist_del(&entry->hnode);
+}
+
 // Function to create and initialize a new associative array
 assoc_array_t *
 array_create(uint32_t bits, void (*free_entry)(void *),
              int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  return array_create_ex(bits, 0, free_entry, fill_entry);
+}
+
+static assoc_array_t *
+_array_create(uint32_t bits, size_t size, uint32_t flags, uint8_t key_room, void (*free_entry)(void *),
+              int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
   // Allocate memory for the associative array structure
   assoc_array_t *arr = malloc(sizeof(assoc_array_t));
   if (!arr) {
@@ -49,8 +113,13 @@ array_create(uint32_t bits, void (*free_entry)(void *),
     return NULL; // Memory allocation failed
   }
 
-  // Create the hash table using the provided ht_create function
-  arr->ht = ht_create(bits);
+  // Create the hash table using the provided ht_create function,
+  // size != 0 means an exact bucket count, HT_* creation options are forwarded
+  uint32_t ht_flags = flags & HT_CREATE_MASK;
+  if (size)
+    arr->ht = ht_create_size(size, ht_flags);
+  else
+    arr->ht = ht_flags ? ht_create_ex(bits, ht_flags) : ht_create(bits);
   if (!arr->ht) {
     perror("Failed to create hashtable");
     free(arr);   // Clean up previously allocated memory
@@ -62,18 +131,152 @@ array_create(uint32_t bits, void (*free_entry)(void *),
 
   // Initialize the size
   arr->size = 0;
+  arr->flags = flags;
+  // unordered entries are allocated without the trailing lnode
+  arr->entry_size = array_is_ordered(arr) ? sizeof(assoc_array_entry_t) : ARRAY_ENTRY_SIZE_UNORDERED;
+
+  arr->key_room = key_room;
+  arr->qsbr = NULL;
+  arr->pool = NULL;
+  if (flags & ARRAY_POOL) {
+    // entries stay on the node of the bucket array, interleaving them would only add remote accesses
+    arr->pool = mempool_create(arr->entry_size + key_room, 0, HT_MEM_OPTS(ht_flags) & ~HT_MEM_OPT_INTERLEAVE);
+    if (!arr->pool) {
+      perror("Failed to create entry pool");
+      ht_destroy(arr->ht);
+      free(arr);
+      return NULL;
+    }
+  }
 
-  arr->free_entry = free_entry ? free_entry : free_assoc_array_entry;
+  if (flags & ARRAY_STABLE) {
+    arr->free_entry = free_entry ? free_entry : free_assoc_array_inline_entry;
+    arr->fill_entry = fill_entry ? fill_entry : fill_assoc_array_inline_entry;
+    return arr;
+  }
+  arr->free_entry = free_entry ? free_entry : arr->pool ? free_assoc_array_pooled_entry : free_assoc_array_entry;
   arr->fill_entry = fill_entry ? fill_entry : fill_assoc_array_entry;
 
   return arr; // Return the newly created associative array
 }
 
+// Same as array_create() but with ARRAY_* flags
+assoc_array_t *
+array_create_ex(uint32_t bits, uint32_t flags, void (*free_entry)(void *),
+                int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  return _array_create(bits, 0, flags & ~ARRAY_STABLE, 0, free_entry, fill_entry);
+}
+
+// Same as array_create_ex() but with exactly 'size' buckets, 'size' need not be a power of two
+assoc_array_t *
+array_create_size(size_t size, uint32_t flags, void (*free_entry)(void *),
+                  int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  if (size == 0) return NULL;
+  return _array_create(0, size, flags & ~ARRAY_STABLE, 0, free_entry, fill_entry);
+}
+
+/**
+ * array_create_inline - create an array of pooled entries with inline keys
+ * @bits: log2 of the bucket count
+ * @max_key_size: longest key array_add() has to accept
+ * @flags: ARRAY_* flags and HT_* creation options, ARRAY_STABLE is implied
+ * @free_entry: called on delete, NULL releases nothing (data is not owned)
+ * @fill_entry: called after the key was copied into the entry, NULL stores data and key_size
+ *
+ * Entries and keys are type-stable: their memory stays in the pool until
+ * array_free(). Returns the new array or NULL on failure.
+ */
+assoc_array_t *
+array_create_inline(uint32_t bits, uint8_t max_key_size, uint32_t flags, void (*free_entry)(void *),
+                    int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  if (max_key_size == 0) return NULL;
+  return _array_create(bits, 0, flags | ARRAY_STABLE | ARRAY_POOL, max_key_size, free_entry, fill_entry);
+}
+
+/**
+ * array_create_stable - create an array with no allocation or page fault in the hot path
+ * @capacity: number of entries to reserve, also used as the bucket count
+ * @max_key_size: longest key array_add() has to accept, keys are stored inline
+ * @flags: ARRAY_* flags and HT_* creation options, ARRAY_STABLE is implied
+ * @free_entry: called on delete, NULL releases nothing (data is not owned)
+ * @fill_entry: called after the key was copied into the entry, NULL stores data and key_size
+ *
+ * The bucket array and @capacity pooled entries are faulted in and, as far as
+ * RLIMIT_MEMLOCK allows, locked at creation. Until more than @capacity
+ * entries are live, array_add() and array_del() neither call the system
+ * allocator nor touch a new page; beyond that the pool grows by chunks.
+ *
+ * Returns the new array or NULL on failure.
+ */
+assoc_array_t *
+array_create_stable(size_t capacity, uint8_t max_key_size, uint32_t flags, void (*free_entry)(void *),
+                    int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  if (capacity == 0 || max_key_size == 0) return NULL;
+  assoc_array_t *arr = _array_create(0, capacity, flags | ARRAY_STABLE | ARRAY_POOL | HT_LOCKED, max_key_size,
+                                     free_entry, fill_entry);
+  if (arr && array_reserve(arr, capacity)) {
+    array_free(arr);
+    return NULL;
+  }
+  return arr;
+}
+
+// pre-allocate pool entries so that 'capacity' entries fit without growing, ARRAY_POOL arrays only
+int array_reserve(assoc_array_t *arr, size_t capacity) {
+  if (!arr || !arr->pool) return -1;
+  return capacity > arr->size ? mempool_reserve(arr->pool, capacity - arr->size) : 0;
+}
+
+/**
+ * array_set_qsbr - switch an array to lock-free readers
+ * @arr: array, must be empty
+ * @q: qsbr domain the readers are registered with, NULL to switch back
+ *
+ * Afterwards array_get_by_key_rcu() may run concurrently with the writers,
+ * which still have to be serialized among themselves. Deleted entries are
+ * handed to free_entry only after a grace period of @q, from a later
+ * qsbr_poll()/qsbr_synchronize(); those run the callbacks of every array
+ * in @q, so arrays sharing a domain must share their writer too.
+ * Returns 0 on success or -1 if the array is not empty.
+ */
+int array_set_qsbr(assoc_array_t *arr, qsbr_t *q) {
+  if (!arr || arr->size) return -1;
+  arr->qsbr = q;
+  return 0;
+}
+
+/**
+ * array_get_by_key_rcu - lock-free lookup
+ * @arr: array set up with array_set_qsbr()
+ * @key: the key
+ * @key_size: its size
+ *
+ * Takes no lock and executes no atomic instruction. The entry stays valid
+ * until the calling reader's next qsbr_quiescent().
+ */
+assoc_array_entry_t *array_get_by_key_rcu(assoc_array_t *arr, void *key, uint8_t key_size) {
+  if (!arr) return NULL;
+  u64 hash_key = hash64_str(key, key_size);
+  assoc_array_entry_t *cur;
+
+  hashtable_for_each_possible_rcu(arr->ht, cur, hnode, hash_key) {
+    if (cur->key_size == key_size && memcmp(cur->key, key, key_size) == 0) return cur;
+  }
+  return NULL;
+}
+
 assoc_array_entry_t *array_get_by_key(assoc_array_t *arr, void *key, uint8_t key_size) {
   if (!arr) return NULL;
-  // Calculate the hash key and bucket index
-  u32 hash_key = hash32_str(key, key_size);
-  u32 bkt = calc_bkt(hash_key, 1 << arr->ht->bits);
+  return array_get_by_key_hashed(arr, hash64_str(key, key_size), key, key_size);
+}
+
+/*
+ * The _hashed variants take hash64_str(key, key_size) from the caller,
+ * so that batching front ends can hash outside their critical section.
+ */
+assoc_array_entry_t *array_get_by_key_hashed(assoc_array_t *arr, u64 hash, void *key, uint8_t key_size) {
+  if (!arr) return NULL;
+  size_t bkt = ht_bkt(arr->ht, hash);
 
   struct hlist_node *tmp;
   assoc_array_entry_t *cur;
@@ -82,7 +285,7 @@ assoc_array_entry_t *array_get_by_key(assoc_array_t *arr, void *key, uint8_t key
   hlist_for_each_entry_safe(cur, tmp, &arr->ht->table[bkt], hnode) {
     // Assuming you have a way to compare the key stored within `cur`
     // For this, you might need to store the key or its hash within `cur` or have a global way to access keys
-    if (memcmp(cur->key, key, key_size) == 0) { // Assuming `cur->key` exists and can be compared
+    if (cur->key_size == key_size && memcmp(cur->key, key, key_size) == 0) { // Assuming `cur->key` exists and can be compared
       return cur;                               // Found
     }
   }
@@ -91,22 +294,35 @@ assoc_array_entry_t *array_get_by_key(assoc_array_t *arr, void *key, uint8_t key
 
 int array_add(assoc_array_t *arr, void *data, void *key, uint8_t key_size) {
   if (!arr) return -1;
-  assoc_array_entry_t *new_entry = malloc(sizeof(assoc_array_entry_t));
+  return array_add_hashed(arr, hash64_str(key, key_size), data, key, key_size);
+}
+
+int array_add_hashed(assoc_array_t *arr, u64 hash, void *data, void *key, uint8_t key_size) {
+  if (!arr) return -1;
+  if (arr->key_room && key_size > arr->key_room) return -1; // does not fit the inline key
+  assoc_array_entry_t *new_entry = array_alloc_entry(arr);
   if (!new_entry) {
     perror("malloc for the new_entry failed");
     return -1; // Memory allocation failed
   }
+  if (arr->key_room) {
+    new_entry->key = (uint8_t *)new_entry + arr->entry_size;
+    memcpy(new_entry->key, key, key_size);
+  }
 
   int ret = arr->fill_entry(new_entry, data, key, key_size);
   if (ret) {
     perror("fill_entry failed");
-    free(new_entry);
+    array_put_entry(arr, new_entry);
     return -1; // Memory allocation failed
   }
 
-  int hash_key = hash32_str(key, key_size);           // Generate a hash for the key
-  hashtable_add(arr->ht, &new_entry->hnode, hash_key); // Add to the hash table
-  k_list_add_tail(&new_entry->lnode, &arr->list);      // Add to the end of the list
+  if (arr->qsbr)
+    hashtable_add_rcu(arr->ht, &new_entry->hnode, hash); // publish to lock-free readers
+  else
+    hashtable_add(arr->ht, &new_entry->hnode, hash); // Add to the hash table
+  if (array_is_ordered(arr))
+    k_list_add_tail(&new_entry->lnode, &arr->list); // Add to the end of the list
   arr->size++;                                         // Increment the size
 
   return 0; // Success
@@ -114,29 +330,45 @@ int array_add(assoc_array_t *arr, void *data, void *key, uint8_t key_size) {
 
 int array_del(assoc_array_t *arr, void *key, uint8_t key_size) {
   if (!arr) return EINVAL;
-  assoc_array_entry_t *existing_entry = array_get_by_key(arr, key, key_size);
+  return array_del_hashed(arr, hash64_str(key, key_size), key, key_size);
+}
+
+int array_del_hashed(assoc_array_t *arr, u64 hash, void *key, uint8_t key_size) {
+  if (!arr) return EINVAL;
+  assoc_array_entry_t *existing_entry = array_get_by_key_hashed(arr, hash, key, key_size);
 
   if (existing_entry == NULL) return 1;
 
-  hlist_del(&existing_entry->hnode);
-  k_list_del(&existing_entry->lnode);
-  arr->free_entry(existing_entry); // Free the existing data using the callback
-  arr->size--;                     // decrease array size
+  array_unhash_entry(arr, existing_entry);
+  if (array_is_ordered(arr))
+    k_list_del(&existing_entry->lnode);
+  array_release_entry(arr, existing_entry); // Free the existing data using the callback
+  arr->size--;                              // decrease array size
   return 0;
 }
 
 int array_add_replace(assoc_array_t *arr, void *data, void *key, uint8_t key_size) {
   if (!arr) return -1;
-  (void)array_del(arr, key, key_size);
+  return array_add_replace_hashed(arr, hash64_str(key, key_size), data, key, key_size);
+}
+
+int array_add_replace_hashed(assoc_array_t *arr, u64 hash, void *data, void *key, uint8_t key_size) {
+  if (!arr) return -1;
+  (void)array_del_hashed(arr, hash, key, key_size);
   // Delegate the addition of a new entry to a separate function
-  return array_add(arr, data, key, key_size);
+  return array_add_hashed(arr, hash, data, key, key_size);
 }
 
 int array_free(assoc_array_t *arr) {
   if (arr == NULL) return -1; // Check if the pointer is NULL
 
+  // entries deleted earlier may still wait for their grace period
+  if (arr->qsbr) qsbr_synchronize(arr->qsbr);
+
   // Use the HT_FREE macro to free all entries in the hash table
   HT_FREE(arr->ht, assoc_array_entry_t, hnode, arr->free_entry);
+  // pooled entries are not freed one by one, the whole pool goes at once
+  mempool_destroy(arr->pool);
 
   // Finally, free the associative array structure itself
   free(arr);
@@ -145,7 +377,7 @@ int array_free(assoc_array_t *arr) {
 }
 
 static assoc_array_entry_t *_array_get_first(assoc_array_t *arr, bool is_first) {
-  if (arr == NULL || k_list_empty(&arr->list) || arr->size == 0) return NULL;
+  if (arr == NULL || !array_is_ordered(arr) || k_list_empty(&arr->list) || arr->size == 0) return NULL;
   if (is_first) {
     return k_list_first_entry(&arr->list, assoc_array_entry_t, lnode);
   } else {
@@ -162,7 +394,7 @@ assoc_array_entry_t *array_get_last(assoc_array_t *arr) {
 }
 
 static int _array_del_first(assoc_array_t *arr, bool is_first) {
-  if (arr == NULL || k_list_empty(&arr->list) || arr->size == 0) return -1;
+  if (arr == NULL || !array_is_ordered(arr) || k_list_empty(&arr->list) || arr->size == 0) return -1;
   assoc_array_entry_t *e;
   if (is_first) {
     e = k_list_first_entry(&arr->list, assoc_array_entry_t, lnode);
@@ -172,11 +404,11 @@ static int _array_del_first(assoc_array_t *arr, bool is_first) {
   if (e == NULL) return -1;
 
   // delete from ht and list
-  hlist_del(&e->hnode);
+  array_unhash_entry(arr, e);
   k_list_del(&e->lnode);
 
   // free entry and decrease size
-  arr->free_entry(e);
+  array_release_entry(arr, e);
   arr->size--;
 
   return 0;
@@ -195,10 +427,10 @@ int array_collision_percent(const assoc_array_t *arr) {
         return 0;
     }
 
-    uint32_t num_buckets = 1 << arr->ht->bits; 
+    size_t num_buckets = arr->ht->size;
     size_t collisions = 0;
 
-    for (uint32_t i = 0; i < num_buckets; i++) {
+    for (size_t i = 0; i < num_buckets; i++) {
         struct hlist_head *head = &arr->ht->table[i];
         size_t count = 0;
         assoc_array_entry_t *cur;
@@ -213,4 +445,110 @@ int array_collision_percent(const assoc_array_t *arr) {
     }
 
     return (int)((collisions * 100) / arr->size);
-}
\ No newline at end of file
+}
+
+// replica entries point to the key and data of the source entry
+static int fill_replica_entry(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size) {
+  entry->key = key;
+  entry->key_size = key_size;
+  entry->data = data;
+  return 0;
+}
+
+static void free_replica_entry(void *entry) {
+  (void)entry; // key and data belong to the source array, the entry to the pool
+}
+
+static int array_replica_add(assoc_array_t *replica, assoc_array_entry_t *src_entry) {
+  return array_add(replica, src_entry->data, src_entry->key, src_entry->key_size);
+}
+
+/**
+ * array_replicate - create a replica of @src on every NUMA node
+ * @src: the read-mostly array to replicate
+ *
+ * Each replica has as many buckets as @src, its bucket array and entry pool
+ * are bound to its node (huge page options of @src are kept) and its entries
+ * share key and data with @src, so @src must outlive the replicas.
+ * On a machine without NUMA a single replica is created.
+ *
+ * Returns the replica set or NULL on failure.
+ */
+array_replicas_t *array_replicate(assoc_array_t *src) {
+  if (!src) return NULL;
+  int nodes = ht_numa_nodes();
+  array_replicas_t *r = calloc(1, sizeof(array_replicas_t) + nodes * sizeof(assoc_array_t *));
+  if (!r) return NULL;
+  r->src = src;
+  r->nodes = nodes;
+
+  uint32_t flags = ARRAY_POOL | (src->flags & ARRAY_UNORDERED) | (src->ht->flags & (HT_HUGETLB | HT_THP));
+  for (int n = 0; n < nodes; n++) {
+    assoc_array_t *replica = array_create_size(src->ht->size, flags | HT_NODE(n), free_replica_entry, fill_replica_entry);
+    r->replica[n] = replica;
+    if (!replica) goto fail;
+
+    // ordered arrays are copied in insertion order so get_first/get_last match
+    assoc_array_entry_t *e;
+    if (array_is_ordered(src)) {
+      k_list_for_each_entry(e, &src->list, lnode) {
+        if (array_replica_add(replica, e)) goto fail;
+      }
+    } else {
+      size_t bkt;
+      hashtable_for_each(src->ht, bkt, e, hnode) {
+        if (array_replica_add(replica, e)) goto fail;
+      }
+    }
+  }
+  return r;
+
+fail:
+  array_replicas_free(r);
+  return NULL;
+}
+
+// free all replicas, the source array is left alone
+void array_replicas_free(array_replicas_t *r) {
+  if (!r) return;
+  for (int n = 0; n < r->nodes; n++) {
+    array_free(r->replica[n]);
+  }
+  free(r);
+}
+
+// add to the source array and to every replica, returns 0 or -1 with nothing added
+int array_replicas_add(array_replicas_t *r, void *data, void *key, uint8_t key_size) {
+  if (!r) return -1;
+  if (array_add(r->src, data, key, key_size)) return -1;
+  // the newest entry is at the head of its bucket
+  assoc_array_entry_t *e = array_get_by_key(r->src, key, key_size);
+
+  for (int n = 0; n < r->nodes; n++) {
+    if (array_replica_add(r->replica[n], e)) {
+      while (n--) {
+        array_del(r->replica[n], key, key_size);
+      }
+      // the caller keeps ownership of data on failure
+      e->data = NULL;
+      array_del(r->src, key, key_size);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// delete from every replica and then from the source array, same return values as array_del()
+int array_replicas_del(array_replicas_t *r, void *key, uint8_t key_size) {
+  if (!r) return EINVAL;
+  for (int n = 0; n < r->nodes; n++) {
+    array_del(r->replica[n], key, key_size);
+  }
+  return array_del(r->src, key, key_size);
+}
+
+// replica on the NUMA node of the calling CPU
+assoc_array_t *array_replica_local(array_replicas_t *r) {
+  int node = ht_numa_current_node();
+  return r->replica[node < r->nodes ? node : 0];
+}
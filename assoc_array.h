@@ -2,21 +2,52 @@
 #define ASSOC_ARRAY_H
 
 #include "hashtable.h" // Include your hashtable header file
+#include "mempool.h"
+#include "qsbr.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+// array_create_ex() flags, HT_* creation options (HT_CREATE_MASK) may be or-ed in and are passed to the hashtable
+#define ARRAY_UNORDERED (1U << 0) // do not track insertion order, entries are allocated without lnode
+/*
+ * allocate entries from a per-array mempool_t placed like the bucket array
+ * (HT_HUGETLB/HT_THP/HT_NODE(), HT_INTERLEAVE is not applied to the pool).
+ * free_entry must then release only what the entry points to, never the
+ * entry itself; the default one frees key and data.
+ */
+#define ARRAY_POOL (1U << 1)
+/*
+ * pooled entries with the key stored inline (array_create_inline()), so an
+ * entry and its key never leave the pool memory; array_create_stable() also
+ * faults in and locks bucket array and pool (HT_LOCKED). The array does not
+ * own data, the default free_entry releases nothing.
+ */
+#define ARRAY_STABLE (1U << 2)
+
+/*
+ * lnode must stay the last member: arrays created with ARRAY_UNORDERED
+ * allocate only ARRAY_ENTRY_SIZE_UNORDERED bytes per entry and never touch it.
+ */
 typedef struct array_entry {
   struct hlist_node hnode; // Node for hash table linkage
-  struct k_list_head lnode;  // Node for doubly linked list
   void *key;
-  uint8_t key_size;
   void *data; // Data of the item
+  uint8_t key_size;
+  struct k_list_head lnode;  // Node for doubly linked list (ordered arrays only)
 } assoc_array_entry_t;
 
+#define ARRAY_ENTRY_SIZE_UNORDERED offsetof(assoc_array_entry_t, lnode)
+
 typedef struct array_struct {
   hashtable_t *ht;                                                                        // the hash table
   struct k_list_head list;                                                                  // Head of the doubly linked list for accessing first and last items
   size_t size;                                                                            // Current number of elements in the array
+  size_t entry_size;                                                                      // bytes allocated per entry
+  uint32_t flags;                                                                         // ARRAY_* creation flags
+  mempool_t *pool;                                                                        // entry pool (ARRAY_POOL only)
+  size_t key_room;                                                                        // bytes for an inline key after each entry, the key is at entry + entry_size (ARRAY_STABLE only)
+  qsbr_t *qsbr;                                                                           // reclamation domain of lock-free readers, see array_set_qsbr()
   void (*free_entry)(void *);                                                             // cb function to free entry memory
   int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size); // cb function to fill entry
 } assoc_array_t;
@@ -25,13 +56,32 @@ typedef struct array_struct {
 assoc_array_t *
 array_create(uint32_t bits, void (*free_entry)(void *),
              int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+assoc_array_t *
+array_create_ex(uint32_t bits, uint32_t flags, void (*free_entry)(void *),
+                int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+assoc_array_t *
+array_create_size(size_t size, uint32_t flags, void (*free_entry)(void *),
+                  int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+assoc_array_t *
+array_create_inline(uint32_t bits, uint8_t max_key_size, uint32_t flags, void (*free_entry)(void *),
+                    int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+assoc_array_t *
+array_create_stable(size_t capacity, uint8_t max_key_size, uint32_t flags, void (*free_entry)(void *),
+                    int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+int array_reserve(assoc_array_t *arr, size_t capacity);
 int array_free(assoc_array_t *arr);
 
 int array_add(assoc_array_t *arr, void *data, void *key, uint8_t key_size);
 int array_add_replace(assoc_array_t *arr, void *data, void *key, uint8_t key_size);
 int array_del(assoc_array_t *arr, void *key, uint8_t key_size);
+int array_add_hashed(assoc_array_t *arr, u64 hash, void *data, void *key, uint8_t key_size);
+int array_add_replace_hashed(assoc_array_t *arr, u64 hash, void *data, void *key, uint8_t key_size);
+int array_del_hashed(assoc_array_t *arr, u64 hash, void *key, uint8_t key_size);
 
 assoc_array_entry_t *array_get_by_key(assoc_array_t *arr, void *key, uint8_t key_size);
+assoc_array_entry_t *array_get_by_key_hashed(assoc_array_t *arr, u64 hash, void *key, uint8_t key_size);
+int array_set_qsbr(assoc_array_t *arr, qsbr_t *q);
+assoc_array_entry_t *array_get_by_key_rcu(assoc_array_t *arr, void *key, uint8_t key_size);
 assoc_array_entry_t *array_get_head_entry(assoc_array_t *arr);
 assoc_array_entry_t *array_get_tail_entry(assoc_array_t *arr);
 
@@ -41,6 +91,25 @@ assoc_array_entry_t *array_get_last(assoc_array_t *arr);
 int array_del_first(assoc_array_t *arr);
 int array_del_last(assoc_array_t *arr);
 
+/*
+ * Per-NUMA-node read-only copies of an array. Every replica has its own
+ * bucket array and entry pool on its node, entries borrow key and data from
+ * the source entries. Lookups on a replica are only safe against concurrent
+ * readers: all modifications must go through array_replicas_add()/_del()
+ * and be serialized by the caller.
+ */
+typedef struct array_replicas {
+  assoc_array_t *src; // the array all replicas are copied from
+  int nodes;          // number of replicas, one per NUMA node
+  assoc_array_t *replica[];
+} array_replicas_t;
+
+array_replicas_t *array_replicate(assoc_array_t *src);
+void array_replicas_free(array_replicas_t *r);
+int array_replicas_add(array_replicas_t *r, void *data, void *key, uint8_t key_size);
+int array_replicas_del(array_replicas_t *r, void *key, uint8_t key_size);
+assoc_array_t *array_replica_local(array_replicas_t *r);
+
 //this func allow to redefine ht_create
 void set_ht_create(hashtable_t *(*ht_create_func)(uint32_t));
 #endif // ASSOC_ARRAY_H
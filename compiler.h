@@ -39,6 +39,17 @@
 /* The "volatile" is due to gcc bugs */
 #define barrier() __asm__ __volatile__("": : :"memory")
 
+/* Busy-wait hint for spin loops */
+#ifndef cpu_relax
+# if defined(__x86_64__) || defined(__i386__)
+#  define cpu_relax() __builtin_ia32_pause()
+# elif defined(__aarch64__)
+#  define cpu_relax() __asm__ __volatile__("yield": : :"memory")
+# else
+#  define cpu_relax() barrier()
+# endif
+#endif
+
 #ifndef __always_inline
 # define __always_inline	inline __attribute__((always_inline))
 #endif
@@ -207,6 +218,25 @@ static __always_inline void __write_once_size(volatile void *p, void *res, int s
 })
 
 
+/*
+ * Ordered accessors for data shared between threads. A store-release makes
+ * all earlier writes visible to whoever observes the stored value with a
+ * load-acquire (or, for pointers, with a dependent READ_ONCE()).
+ */
+#define smp_mb()			__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_load_acquire(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v)		__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/*
+ * rcu_assign_pointer - publish a pointer to a fully initialized object
+ * rcu_dereference - read a published pointer, safe to dereference afterwards
+ *
+ * Readers rely on the address dependency of the loaded pointer, so
+ * rcu_dereference() costs a plain load on every supported architecture.
+ */
+#define rcu_assign_pointer(p, v)	smp_store_release(&(p), (v))
+#define rcu_dereference(p)		READ_ONCE(p)
+
 /* Indirect macros required for expanded argument pasting, eg. __LINE__. */
 #define ___PASTE(a, b) a##b
 #define __PASTE(a, b) ___PASTE(a, b)
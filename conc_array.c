@@ -0,0 +1,521 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "conc_array.h"
+#include "mock_mem_functions.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+// head of an old bucket whose entries have been moved to c->next
+#define CONC_FORWARD ((struct hlist_node *)1)
+
+static inline bool conc_is_ordered(const conc_array_t *c) {
+  return !(c->arr->flags & ARRAY_UNORDERED);
+}
+
+static inline void conc_list_lock(conc_array_t *c) {
+  ht_spin_lock(&c->list_lock.spin);
+}
+
+static inline void conc_list_unlock(conc_array_t *c) {
+  ht_spin_unlock(&c->list_lock.spin);
+}
+
+static inline bool conc_is_seq(const conc_array_t *c) {
+  return c->stripes.type == HT_LOCK_SEQ;
+}
+
+static conc_array_t *conc_wrap(assoc_array_t *arr, uint32_t stripes, uint32_t type) {
+  if (!arr) return NULL;
+  void *mem;
+  // the locks sit on cache lines of their own, which malloc() alignment does not guarantee
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(conc_array_t))) goto fail;
+  conc_array_t *c = mem;
+  c->arr = arr;
+  // a stripe must cover whole buckets: stripe(hash) == stripe(bucket of hash) for every table size to come
+  if (stripes == 0) stripes = HT_STRIPES_DEFAULT;
+  if (stripes > arr->ht->size) stripes = arr->ht->size;
+  if (ht_stripes_init(&c->stripes, stripes, type)) goto fail_c;
+  ht_lock_init(&c->list_lock, HT_LOCK_SPIN);
+  ht_lock_init(&c->pool_lock, HT_LOCK_SPIN);
+  ht_lock_init(&c->resize_lock, HT_LOCK_SPIN);
+  c->next = NULL;
+  c->buckets = arr->ht->size;
+  c->resize_size = c->resize_claim = c->resize_done = 0;
+  c->max_load = 0;
+  return c;
+
+fail_c:
+  free(c);
+fail:
+  array_free(arr);
+  return NULL;
+}
+
+/**
+ * conc_array_create - create a concurrent associative array
+ * @bits: log2 of the bucket count, raised to cover @stripes with CONC_ARRAY_GROW
+ * @stripes: number of bucket lock stripes, 0 for HT_STRIPES_DEFAULT; capped to
+ *           the initial bucket count
+ * @flags: CONC_ARRAY_RWLOCK, CONC_ARRAY_GROW, ARRAY_UNORDERED and HT_* creation
+ *         options; pooled arrays (ARRAY_POOL, ARRAY_STABLE) are not supported since
+ *         the pool itself is not thread safe
+ * @free_entry: same as for array_create()
+ * @fill_entry: same as for array_create(), called without any lock held
+ *
+ * Returns the new array or NULL on failure.
+ */
+conc_array_t *
+conc_array_create(uint32_t bits, uint32_t stripes, uint32_t flags, void (*free_entry)(void *),
+                  int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  if (flags & (ARRAY_POOL | ARRAY_STABLE)) return NULL;
+  if (flags & CONC_ARRAY_GROW) {
+    // stripes are capped to the initial bucket count for good, start with enough buckets for all of them
+    uint32_t count = stripes ? stripes : HT_STRIPES_DEFAULT;
+    if (count <= (1U << 31)) {
+      uint32_t stripe_bits = ilog2(count) + !!(count & (count - 1));
+      if (bits < stripe_bits) bits = stripe_bits;
+    }
+  }
+
+  assoc_array_t *arr = array_create_ex(bits, flags & ~(CONC_ARRAY_RWLOCK | CONC_ARRAY_GROW), free_entry, fill_entry);
+  conc_array_t *c = conc_wrap(arr, stripes, flags & CONC_ARRAY_RWLOCK ? HT_LOCK_RW : HT_LOCK_SPIN);
+  if (c && (flags & CONC_ARRAY_GROW)) c->max_load = CONC_ARRAY_MAX_LOAD;
+  return c;
+}
+
+/**
+ * conc_array_create_seq - create a concurrent array with optimistic readers
+ * @bits: log2 of the bucket count
+ * @stripes: number of bucket seqlock stripes, 0 for HT_STRIPES_DEFAULT
+ * @max_key_size: longest key to accept, keys are stored inline in the entries
+ * @flags: ARRAY_UNORDERED and HT_* creation options
+ * @free_entry: same as for array_create_inline(), must not free the entry
+ * @fill_entry: same as for array_create_inline()
+ *
+ * Returns the new array or NULL on failure.
+ */
+conc_array_t *
+conc_array_create_seq(uint32_t bits, uint32_t stripes, uint8_t max_key_size, uint32_t flags,
+                      void (*free_entry)(void *),
+                      int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  assoc_array_t *arr =
+      array_create_inline(bits, max_key_size, flags & ~(CONC_ARRAY_RWLOCK | CONC_ARRAY_GROW), free_entry, fill_entry);
+  return conc_wrap(arr, stripes, HT_LOCK_SEQ);
+}
+
+static size_t conc_migrate_bucket(conc_array_t *c, size_t bkt);
+static void conc_resize_finish(conc_array_t *c);
+
+// free the array and all entries, must not race with any other call
+int conc_array_free(conc_array_t *c) {
+  if (!c) return -1;
+  if (c->next) {
+    // a resize left unfinished by its helpers, nobody else runs now
+    for (size_t bkt = 0; bkt < c->resize_size; bkt++)
+      conc_migrate_bucket(c, bkt);
+    conc_resize_finish(c);
+  }
+  array_free(c->arr);
+  ht_stripes_destroy(&c->stripes);
+  free(c);
+  return 0;
+}
+
+/*
+ * Bucket of 'hash' in the table currently holding it, the stripe of 'hash'
+ * must be held. The table switch takes all stripes, so both table pointers
+ * are stable here.
+ */
+static struct hlist_head *conc_head(conc_array_t *c, u64 hash) {
+  struct hlist_head *head = &c->arr->ht->table[ht_bkt(c->arr->ht, hash)];
+  if (head->first == CONC_FORWARD) head = &c->next->table[ht_bkt(c->next, hash)];
+  return head;
+}
+
+// first entry with 'key' in 'head', the stripe of the bucket must be held
+static assoc_array_entry_t *conc_find(struct hlist_head *head, void *key, uint8_t key_size) {
+  assoc_array_entry_t *cur;
+  hlist_for_each_entry(cur, head, hnode) {
+    if (cur->key_size == key_size && memcmp(cur->key, key, key_size) == 0) return cur;
+  }
+  return NULL;
+}
+
+// unlink an entry, the stripe of its bucket must be write locked
+static void conc_unlink(conc_array_t *c, assoc_array_entry_t *e) {
+  if (conc_is_seq(c))
+    hlist_del_rcu(&e->hnode); // keeps ->next for readers standing on it
+  else
+    hlist_del(&e->hnode);
+  if (conc_is_ordered(c)) {
+    conc_list_lock(c);
+    k_list_del(&e->lnode);
+    conc_list_unlock(c);
+  }
+  __atomic_fetch_sub(&c->arr->size, 1, __ATOMIC_RELAXED);
+}
+
+static assoc_array_entry_t *conc_alloc_entry(conc_array_t *c) {
+  if (!c->arr->pool) return malloc(c->arr->entry_size);
+  ht_spin_lock(&c->pool_lock.spin);
+  assoc_array_entry_t *e = mempool_alloc(c->arr->pool);
+  ht_spin_unlock(&c->pool_lock.spin);
+  return e;
+}
+
+static void conc_put_entry(conc_array_t *c, assoc_array_entry_t *e) {
+  if (!c->arr->pool) {
+    free(e);
+    return;
+  }
+  ht_spin_lock(&c->pool_lock.spin);
+  mempool_free(c->arr->pool, e);
+  ht_spin_unlock(&c->pool_lock.spin);
+}
+
+// free an unlinked entry, no lock may be held
+static void conc_release(conc_array_t *c, assoc_array_entry_t *e) {
+  c->arr->free_entry(e); // frees the entry too unless it is pooled
+  if (c->arr->pool) conc_put_entry(c, e);
+}
+
+static inline uint8_t *conc_inline_key(const conc_array_t *c, assoc_array_entry_t *e) {
+  return (uint8_t *)e + c->arr->entry_size;
+}
+
+/*
+ * Move old bucket 'bkt' into c->next and leave a forwarding marker behind.
+ * The stripe of 'bkt' is the stripe of every key in it and of the new
+ * buckets they land in. Claims may be stale (from an earlier resize or
+ * handed out twice around a restart), so everything is checked again under
+ * the lock. Returns 1 if this call migrated the bucket.
+ */
+static size_t conc_migrate_bucket(conc_array_t *c, size_t bkt) {
+  size_t moved = 0;
+
+  ht_stripe_write_lock(&c->stripes, bkt);
+  hashtable_t *old = c->arr->ht, *next = __atomic_load_n(&c->next, __ATOMIC_ACQUIRE);
+  if (next && bkt < old->size && old->table[bkt].first != CONC_FORWARD) {
+    assoc_array_entry_t *e;
+    struct hlist_node *tmp;
+    hlist_for_each_entry_safe(e, tmp, &old->table[bkt], hnode) {
+      hlist_del(&e->hnode);
+      hlist_add_head(&e->hnode, &next->table[ht_bkt(next, hash64_str(e->key, e->key_size))]);
+    }
+    old->table[bkt].first = CONC_FORWARD;
+    moved = 1;
+  }
+  ht_stripe_unlock(&c->stripes, bkt);
+  return moved;
+}
+
+// switch to the new table once every old bucket is forwarded
+static void conc_resize_finish(conc_array_t *c) {
+  ht_stripes_t *s = &c->stripes;
+  for (size_t i = 0; i <= s->mask; i++)
+    ht_lock_write(&s->locks[i], s->type);
+
+  hashtable_t *old = c->arr->ht;
+  c->arr->ht = c->next;
+  __atomic_store_n(&c->buckets, c->next->size, __ATOMIC_RELAXED);
+  __atomic_store_n(&c->next, NULL, __ATOMIC_RELEASE);
+
+  for (size_t i = 0; i <= s->mask; i++)
+    ht_unlock(&s->locks[i], s->type);
+  ht_destroy(old); // no stripe holder can still see it
+}
+
+/*
+ * Start growing to 'buckets' buckets unless a resize is already running.
+ * The new table is mapped lazily, so allocating even a huge one is cheap.
+ */
+static int conc_resize_start(conc_array_t *c, size_t buckets) {
+  if (conc_is_seq(c)) return -1;
+  if (__atomic_load_n(&c->next, __ATOMIC_ACQUIRE) || buckets <= __atomic_load_n(&c->buckets, __ATOMIC_RELAXED))
+    return 0;
+
+  hashtable_t *next = ht_create_ex(ilog2(buckets), c->arr->flags & HT_CREATE_MASK);
+  if (!next) return -1;
+
+  ht_spin_lock(&c->resize_lock.spin);
+  // the finishing thread clears 'next' without this lock, after updating 'buckets'
+  if (__atomic_load_n(&c->next, __ATOMIC_ACQUIRE) || buckets <= c->buckets) {
+    ht_spin_unlock(&c->resize_lock.spin);
+    ht_destroy(next); // lost the race to another starter
+    return 0;
+  }
+  __atomic_store_n(&c->resize_size, c->buckets, __ATOMIC_RELAXED);
+  __atomic_store_n(&c->resize_done, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&c->next, next, __ATOMIC_RELEASE);
+  // after 'next': a claim taken from the new counter always sees the new table
+  __atomic_store_n(&c->resize_claim, 0, __ATOMIC_RELEASE);
+  ht_spin_unlock(&c->resize_lock.spin);
+  return 0;
+}
+
+/*
+ * Claim the next chunk of old buckets and migrate it, called by every add
+ * and delete while a resize runs so the work is spread over all writers.
+ * Returns false once nothing is left to claim.
+ */
+static bool conc_resize_help(conc_array_t *c) {
+  if (!__atomic_load_n(&c->next, __ATOMIC_ACQUIRE)) return false;
+
+  size_t start = __atomic_fetch_add(&c->resize_claim, CONC_RESIZE_CHUNK, __ATOMIC_ACQ_REL);
+  size_t size = __atomic_load_n(&c->resize_size, __ATOMIC_RELAXED);
+  if (start >= size) return false;
+
+  size_t end = start + CONC_RESIZE_CHUNK < size ? start + CONC_RESIZE_CHUNK : size, moved = 0;
+  for (size_t bkt = start; bkt < end; bkt++)
+    moved += conc_migrate_bucket(c, bkt);
+
+  // whoever migrates the last bucket switches the tables
+  if (moved && __atomic_add_fetch(&c->resize_done, moved, __ATOMIC_ACQ_REL) ==
+                   __atomic_load_n(&c->resize_size, __ATOMIC_RELAXED))
+    conc_resize_finish(c);
+  return true;
+}
+
+static int conc_add(conc_array_t *c, void *data, void *key, uint8_t key_size, bool replace) {
+  if (!c) return -1;
+  assoc_array_t *arr = c->arr;
+  if (arr->key_room && key_size > arr->key_room) return -1;
+
+  // allocation and fill_entry happen outside the lock
+  assoc_array_entry_t *new_entry = conc_alloc_entry(c);
+  if (!new_entry) return -1;
+  if (arr->key_room) {
+    new_entry->key = conc_inline_key(c, new_entry);
+    memcpy(new_entry->key, key, key_size);
+  }
+  if (arr->fill_entry(new_entry, data, key, key_size)) {
+    conc_put_entry(c, new_entry);
+    return -1;
+  }
+
+  // stripes are selected by hash, the bucket index depends on the table which may change until locked
+  u64 hash_key = hash64_str(key, key_size);
+  assoc_array_entry_t *old = NULL;
+
+  ht_stripe_write_lock(&c->stripes, hash_key);
+  struct hlist_head *head = conc_head(c, hash_key);
+  if (replace) {
+    old = conc_find(head, key, key_size);
+    if (old) conc_unlink(c, old);
+  }
+  // optimistic readers must only see fully initialized entries
+  hlist_add_head_rcu(&new_entry->hnode, head);
+  if (conc_is_ordered(c)) {
+    conc_list_lock(c);
+    k_list_add_tail(&new_entry->lnode, &arr->list);
+    conc_list_unlock(c);
+  }
+  size_t size = __atomic_add_fetch(&arr->size, 1, __ATOMIC_RELAXED);
+  ht_stripe_unlock(&c->stripes, hash_key);
+
+  if (old) conc_release(c, old);
+  if (c->max_load) {
+    size_t buckets = __atomic_load_n(&c->buckets, __ATOMIC_RELAXED);
+    if (size >= buckets * c->max_load) conc_resize_start(c, buckets * 2);
+  }
+  conc_resize_help(c);
+  return 0;
+}
+
+int conc_array_add(conc_array_t *c, void *data, void *key, uint8_t key_size) {
+  return conc_add(c, data, key, key_size, false);
+}
+
+// same as conc_array_add() but atomically replaces an entry with the same key
+int conc_array_add_replace(conc_array_t *c, void *data, void *key, uint8_t key_size) {
+  return conc_add(c, data, key, key_size, true);
+}
+
+// returns 0 if an entry was deleted, 1 if the key was not found
+int conc_array_del(conc_array_t *c, void *key, uint8_t key_size) {
+  if (!c) return EINVAL;
+  u64 hash_key = hash64_str(key, key_size);
+
+  ht_stripe_write_lock(&c->stripes, hash_key);
+  assoc_array_entry_t *e = conc_find(conc_head(c, hash_key), key, key_size);
+  if (e) conc_unlink(c, e);
+  ht_stripe_unlock(&c->stripes, hash_key);
+
+  conc_resize_help(c);
+  if (!e) return 1;
+  conc_release(c, e); // free_entry runs outside the lock
+  return 0;
+}
+
+/*
+ * Optimistic lookup in a seqlock array: walk the chain without a lock and
+ * copy the matching entry with its inline key into 'snap'. Pool memory is
+ * never unmapped, so stale pointers are harmless; the key is always read at
+ * its fixed place behind the entry and the walk gives up as soon as the
+ * stripe changed, which also bounds it.
+ */
+static bool conc_find_seq(conc_array_t *c, size_t bkt, void *key, uint8_t key_size, assoc_array_entry_t *snap) {
+  struct ht_lock *l = ht_stripe(&c->stripes, bkt);
+  size_t size = c->arr->entry_size + key_size;
+
+  for (;;) {
+    uint32_t seq = ht_seq_read_begin(l);
+    bool found = false, torn = false;
+    assoc_array_entry_t *cur;
+
+    hlist_for_each_entry_rcu(cur, &c->arr->ht->table[bkt], hnode) {
+      if (ht_seq_read_retry(l, seq)) {
+        torn = true;
+        break;
+      }
+      if (READ_ONCE(cur->key_size) == key_size && memcmp(conc_inline_key(c, cur), key, key_size) == 0) {
+        memcpy(snap, cur, size);
+        found = true;
+        break;
+      }
+    }
+    if (!torn && !ht_seq_read_retry(l, seq)) {
+      snap->key = conc_inline_key(c, snap);
+      return found;
+    }
+  }
+}
+
+/**
+ * conc_array_lookup - run a callback on the entry of a key
+ * @c: concurrent array
+ * @key: the key
+ * @key_size: its size
+ * @fn: called with the entry while its stripe is locked, may be NULL;
+ *      must not call back into @c. For conc_array_create_seq() arrays no
+ *      lock is held and @fn gets a consistent private copy of the entry.
+ * @arg: passed to @fn
+ *
+ * Returns -1 if the key was not found, otherwise the return value of @fn
+ * (0 if @fn is NULL).
+ */
+int conc_array_lookup(conc_array_t *c, void *key, uint8_t key_size,
+                      int (*fn)(assoc_array_entry_t *entry, void *arg), void *arg) {
+  if (!c) return -1;
+  u64 hash_key = hash64_str(key, key_size);
+  int ret = -1;
+
+  if (conc_is_seq(c)) {
+    size_t bkt = ht_bkt(c->arr->ht, hash_key); // never resized
+    if (key_size > c->arr->key_room) return -1;
+    // room for the largest entry with its inline key
+    uint64_t buf[(sizeof(assoc_array_entry_t) + UINT8_MAX + 7) / 8];
+    assoc_array_entry_t *snap = (assoc_array_entry_t *)buf;
+    if (!conc_find_seq(c, bkt, key, key_size, snap)) return -1;
+    return fn ? fn(snap, arg) : 0;
+  }
+
+  ht_stripe_read_lock(&c->stripes, hash_key);
+  assoc_array_entry_t *e = conc_find(conc_head(c, hash_key), key, key_size);
+  if (e) ret = fn ? fn(e, arg) : 0;
+  ht_stripe_unlock(&c->stripes, hash_key);
+  return ret;
+}
+
+static int conc_copy_data(assoc_array_entry_t *entry, void *arg) {
+  *(void **)arg = entry->data;
+  return 0;
+}
+
+// store the data of 'key' in '*data', returns 0 or -1 if the key was not found
+int conc_array_get_data(conc_array_t *c, void *key, uint8_t key_size, void **data) {
+  return conc_array_lookup(c, key, key_size, conc_copy_data, data);
+}
+
+/*
+ * The list end can only be read under the list lock, but its bucket stripe
+ * has to be taken first. Remember the entry and its key, take the stripe,
+ * then check under the list lock that the same entry is still at that end.
+ * The key compare guards against the entry having been freed and its memory
+ * reused for another key living in a different stripe.
+ */
+static int conc_del_end(conc_array_t *c, bool is_first) {
+  if (!c || !conc_is_ordered(c)) return -1;
+  assoc_array_t *arr = c->arr;
+  uint8_t key[UINT8_MAX];
+
+  for (;;) {
+    conc_list_lock(c);
+    if (k_list_empty(&arr->list)) {
+      conc_list_unlock(c);
+      return -1;
+    }
+    assoc_array_entry_t *e = is_first ? k_list_first_entry(&arr->list, assoc_array_entry_t, lnode)
+                                      : k_list_last_entry(&arr->list, assoc_array_entry_t, lnode);
+    uint8_t key_size = e->key_size;
+    memcpy(key, e->key, key_size);
+    conc_list_unlock(c);
+
+    u64 hash_key = hash64_str((char *)key, key_size);
+    ht_stripe_write_lock(&c->stripes, hash_key);
+    conc_list_lock(c);
+    assoc_array_entry_t *cur = NULL;
+    if (!k_list_empty(&arr->list))
+      cur = is_first ? k_list_first_entry(&arr->list, assoc_array_entry_t, lnode)
+                     : k_list_last_entry(&arr->list, assoc_array_entry_t, lnode);
+    bool same = cur == e && cur->key_size == key_size && memcmp(cur->key, key, key_size) == 0;
+    if (same) {
+      if (conc_is_seq(c))
+        hlist_del_rcu(&e->hnode);
+      else
+        hlist_del(&e->hnode);
+      k_list_del(&e->lnode);
+      __atomic_fetch_sub(&arr->size, 1, __ATOMIC_RELAXED);
+    }
+    conc_list_unlock(c);
+    ht_stripe_unlock(&c->stripes, hash_key);
+
+    if (same) {
+      conc_release(c, e);
+      return 0;
+    }
+  }
+}
+
+/**
+ * conc_array_resize - grow the bucket array to at least 1 << @bits buckets
+ * @c: concurrent array, not a seqlock one
+ * @bits: log2 of the bucket count
+ *
+ * May run concurrently with all other operations, which help migrating.
+ * Returns once the table has the requested size: 0 on success or -1 on
+ * failure. Tables never shrink, smaller sizes are a no-op.
+ */
+int conc_array_resize(conc_array_t *c, uint32_t bits) {
+  if (!c || conc_is_seq(c) || bits >= sizeof(size_t) * 8) return -1;
+  size_t buckets = (size_t)1 << bits;
+
+  while (__atomic_load_n(&c->buckets, __ATOMIC_ACQUIRE) < buckets) {
+    if (conc_resize_start(c, buckets)) return -1;
+    while (conc_resize_help(c))
+      ;
+    // the remaining chunks are claimed by other threads, wait for the switch
+    while (__atomic_load_n(&c->next, __ATOMIC_ACQUIRE))
+      cpu_relax();
+  }
+  return 0;
+}
+
+int conc_array_del_first(conc_array_t *c) {
+  return conc_del_end(c, true);
+}
+
+int conc_array_del_last(conc_array_t *c) {
+  return conc_del_end(c, false);
+}
+
+size_t conc_array_size(const conc_array_t *c) {
+  return __atomic_load_n(&c->arr->size, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,82 @@
+/*
+ * Concurrent associative array with striped bucket locks
+ *
+ * Wraps an assoc_array_t: every bucket is guarded by one of a configurable
+ * number of padded lock stripes and the insertion-order list, when the
+ * array is ordered, by a lock of its own. Operations on keys in different
+ * stripes run in parallel; the list lock is only held for the O(1) list
+ * link/unlink. Lock order is always stripe -> list.
+ *
+ * Entries can be freed by a concurrent delete as soon as the stripe lock
+ * is released, so lookups hand the entry to a callback run under the lock
+ * instead of returning a pointer.
+ *
+ * conc_array_create_seq() makes the stripes seqlocks: writers still take
+ * the stripe spinlock, readers take nothing and retry when a writer touched
+ * their stripe meanwhile. Entries and their inline keys come from a
+ * type-stable pool, so a reader running into a just deleted entry only ever
+ * reads pool memory and the retry discards what it saw.
+ *
+ * Growing is cooperative (conc_array_resize(), CONC_ARRAY_GROW): the new
+ * table is published next to the old one and every add or delete that
+ * finds a resize running claims a chunk of old buckets and migrates them,
+ * leaving a forwarding marker in each old head. Operations landing on a
+ * forwarded bucket continue in the new table. The stripe count is capped
+ * to the initial bucket count, so a stripe always covers an old bucket and
+ * all the buckets it splits into; only the final table switch takes every
+ * stripe. Since the cap never lifts, CONC_ARRAY_GROW arrays start with at
+ * least one bucket per stripe.
+ * Seqlock arrays cannot be resized.
+ */
+
+#ifndef __CONC_ARRAY_H__
+#define __CONC_ARRAY_H__
+
+#include "assoc_array.h"
+#include "ht_lock.h"
+
+// conc_array_create() flags, bits 24-31; ARRAY_* flags and HT_* creation options may be or-ed in
+#define CONC_ARRAY_RWLOCK (1U << 24) // rwlock stripes, lookups share a stripe; spinlocks otherwise
+#define CONC_ARRAY_GROW (1U << 25)   // double the bucket count once it holds CONC_ARRAY_MAX_LOAD entries per bucket
+
+#define CONC_ARRAY_MAX_LOAD 2
+#define CONC_RESIZE_CHUNK 64 // old buckets migrated per claim
+
+typedef struct conc_array {
+  assoc_array_t *arr;         // the wrapped array, only touched under the locks below
+  ht_stripes_t stripes;       // bucket locks
+  struct ht_lock list_lock;   // insertion-order list lock, always a spinlock
+  struct ht_lock pool_lock;   // entry pool lock (conc_array_create_seq() only)
+  struct ht_lock resize_lock; // serializes starting a resize
+  hashtable_t *next;          // table being migrated to, NULL unless a resize is running
+  size_t buckets;             // bucket count of arr->ht, readable without a stripe lock
+  size_t resize_size;         // old bucket count of the running resize
+  size_t resize_claim;        // next old bucket handed out to a helping thread
+  size_t resize_done;         // old buckets migrated so far
+  uint32_t max_load;          // entries per bucket that start a resize, 0 never
+} conc_array_t;
+
+conc_array_t *
+conc_array_create(uint32_t bits, uint32_t stripes, uint32_t flags, void (*free_entry)(void *),
+                  int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+conc_array_t *
+conc_array_create_seq(uint32_t bits, uint32_t stripes, uint8_t max_key_size, uint32_t flags,
+                      void (*free_entry)(void *),
+                      int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+int conc_array_free(conc_array_t *c);
+
+int conc_array_add(conc_array_t *c, void *data, void *key, uint8_t key_size);
+int conc_array_add_replace(conc_array_t *c, void *data, void *key, uint8_t key_size);
+int conc_array_del(conc_array_t *c, void *key, uint8_t key_size);
+int conc_array_lookup(conc_array_t *c, void *key, uint8_t key_size,
+                      int (*fn)(assoc_array_entry_t *entry, void *arg), void *arg);
+int conc_array_get_data(conc_array_t *c, void *key, uint8_t key_size, void **data);
+
+int conc_array_resize(conc_array_t *c, uint32_t bits);
+
+int conc_array_del_first(conc_array_t *c);
+int conc_array_del_last(conc_array_t *c);
+
+size_t conc_array_size(const conc_array_t *c);
+
+#endif
@@ -3,6 +3,7 @@
  * (C) 2022  Isaev Ruslan <legale.legale@gmail.com>
  */
 #include <stdlib.h>
+#include <string.h>
 #ifdef JEMALLOC
 #include "jemalloc.h"
 #endif
@@ -11,20 +12,19 @@
 deq_t *deque_create(void){
   deq_t *deq = malloc(sizeof(deq_t));
   if(!deq) return NULL;
-  K_INIT_LIST_HEAD(&deq->list);
+  deq_init(deq);
   return deq;
 }
 
 
 void _deq_push(deq_t *name, bool push_tail_flag, void *data) {
-	++name->size;
   deq_entry_t *deq_item = (deq_entry_t *)malloc(sizeof(deq_entry_t));
   deq_item->data = data;
 
   if (push_tail_flag) {
-    k_list_add_tail(&deq_item->list, &name->list);
+    deq_push_tail_node(name, &deq_item->list);
   } else {
-    k_list_add(&deq_item->list, &name->list);
+    deq_push_head_node(name, &deq_item->list);
   }
 }
 
@@ -95,3 +95,319 @@ deq_entry_t *deq_get_head(deq_t *deq) {
 deq_entry_t *deq_get_tail(deq_t *deq) {
     return _deq_get(deq, true); 
 }
+
+/*
+ * Unlink the 'k' nodes between the head (or tail) of 'deq' and 'stop', the
+ * first node left in the deque, with one pointer update on each side and
+ * one size update.
+ */
+static void _deq_cut(deq_t *deq, struct k_list_head *stop, int k, bool from_tail) {
+  if (from_tail) {
+    deq->list.prev = stop;
+    stop->next = &deq->list;
+  } else {
+    deq->list.next = stop;
+    stop->prev = &deq->list;
+  }
+  deq->size -= k;
+}
+
+static int _deq_pop_nodes(deq_t *deq, struct k_list_head **nodes, int n, bool from_tail) {
+  struct k_list_head *pos = from_tail ? deq->list.prev : deq->list.next;
+  int k = 0;
+
+  while (k < n && pos != &deq->list) {
+    nodes[k++] = pos;
+    pos = from_tail ? pos->prev : pos->next;
+  }
+  _deq_cut(deq, pos, k, from_tail);
+  return k;
+}
+
+/**
+ * deq_pop_head_nodes - pop up to @n nodes from the head of an intrusive deque
+ * @deq: deque
+ * @nodes: array receiving the nodes in pop order
+ * @n: its size
+ *
+ * The popped nodes keep their stale links, initialize them before testing
+ * them with k_list_empty(). Returns the number of nodes popped.
+ */
+int deq_pop_head_nodes(deq_t *deq, struct k_list_head **nodes, int n) {
+  return _deq_pop_nodes(deq, nodes, n, false);
+}
+
+// deq_pop_head_nodes() from the tail, nodes[0] is the last element
+int deq_pop_tail_nodes(deq_t *deq, struct k_list_head **nodes, int n) {
+  return _deq_pop_nodes(deq, nodes, n, true);
+}
+
+static int _deq_pop_batch(deq_t *deq, void **data, int n, bool from_tail) {
+  struct k_list_head *pos = from_tail ? deq->list.prev : deq->list.next;
+  int k = 0;
+
+  while (k < n && pos != &deq->list) {
+    deq_entry_t *item = k_list_entry(pos, deq_entry_t, list);
+    pos = from_tail ? pos->prev : pos->next;
+    data[k++] = item->data;
+    free(item);
+  }
+  _deq_cut(deq, pos, k, from_tail);
+  return k;
+}
+
+/**
+ * deq_pop_head_batch - pop up to @n elements from the head of a deq_entry_t deque
+ * @deq: deque
+ * @data: array receiving the data pointers in pop order
+ * @n: its size
+ *
+ * The entries are freed. Returns the number of elements popped.
+ */
+int deq_pop_head_batch(deq_t *deq, void **data, int n) {
+  return _deq_pop_batch(deq, data, n, false);
+}
+
+// deq_pop_head_batch() from the tail, data[0] is the last element
+int deq_pop_tail_batch(deq_t *deq, void **data, int n) {
+  return _deq_pop_batch(deq, data, n, true);
+}
+
+/**
+ * deq_ring_create - create an array-backed deque
+ * @capacity: number of elements to make room for, rounded up to a power of
+ *            two of at least DEQ_RING_MIN_CAPACITY
+ *
+ * Returns the new deque or NULL on failure.
+ */
+deq_ring_t *deq_ring_create(size_t capacity) {
+  deq_ring_t *r = malloc(sizeof(deq_ring_t));
+  if (!r) return NULL;
+
+  size_t cap = DEQ_RING_MIN_CAPACITY;
+  while (cap < capacity) {
+    if (cap > SIZE_MAX / 2 / sizeof(void *)) {
+      free(r);
+      return NULL;
+    }
+    cap <<= 1;
+  }
+  r->buf = malloc(cap * sizeof(void *));
+  if (!r->buf) {
+    free(r);
+    return NULL;
+  }
+  r->mask = cap - 1;
+  r->head = 0;
+  r->size = 0;
+  return r;
+}
+
+// free the deque, the elements themselves are not touched
+void deq_ring_free(deq_ring_t *r) {
+  if (!r) return;
+  free(r->buf);
+  free(r);
+}
+
+/*
+ * Double the ring until it holds 'capacity' elements. The wrapped part at
+ * the start of the old buffer is moved behind the old end, so the elements
+ * stay contiguous modulo the new capacity.
+ */
+int deq_ring_reserve(deq_ring_t *r, size_t capacity) {
+  size_t old_cap = r->mask + 1, cap = old_cap;
+  while (cap < capacity) {
+    if (cap > SIZE_MAX / 2 / sizeof(void *)) return -1;
+    cap <<= 1;
+  }
+  if (cap == old_cap) return 0;
+
+  void **buf = realloc(r->buf, cap * sizeof(void *));
+  if (!buf) return -1;
+  if (r->head + r->size > old_cap) memcpy(buf + old_cap, buf, (r->head + r->size - old_cap) * sizeof(void *));
+  r->buf = buf;
+  r->mask = cap - 1;
+  return 0;
+}
+
+// returns 0 or -1 if the ring could not grow
+int deq_ring_push_tail(deq_ring_t *r, void *data) {
+  if (r->size > r->mask && deq_ring_reserve(r, r->size + 1)) return -1;
+  r->buf[(r->head + r->size) & r->mask] = data;
+  r->size++;
+  return 0;
+}
+
+int deq_ring_push_head(deq_ring_t *r, void *data) {
+  if (r->size > r->mask && deq_ring_reserve(r, r->size + 1)) return -1;
+  r->head = (r->head - 1) & r->mask;
+  r->buf[r->head] = data;
+  r->size++;
+  return 0;
+}
+
+// returns the element or NULL if the deque is empty
+void *deq_ring_pop_tail(deq_ring_t *r) {
+  if (!r->size) return NULL;
+  r->size--;
+  return r->buf[(r->head + r->size) & r->mask];
+}
+
+void *deq_ring_pop_head(deq_ring_t *r) {
+  if (!r->size) return NULL;
+  void *data = r->buf[r->head];
+  r->head = (r->head + 1) & r->mask;
+  r->size--;
+  return data;
+}
+
+/**
+ * deq_chunked_create - create a chunked deque
+ * @elem_size: bytes per element, elements are copied in and out
+ *
+ * Returns the new deque or NULL on failure.
+ */
+deq_chunked_t *deq_chunked_create(size_t elem_size) {
+  if (!elem_size || elem_size > SIZE_MAX / DEQ_CHUNK_ELEMS) return NULL;
+  deq_chunked_t *d = malloc(sizeof(deq_chunked_t));
+  if (!d) return NULL;
+
+  d->map = malloc(DEQ_MAP_MIN * sizeof(uint8_t *));
+  if (!d->map) {
+    free(d);
+    return NULL;
+  }
+  d->map_cap = DEQ_MAP_MIN;
+  d->first = DEQ_MAP_MIN / 2; // room to grow at both ends
+  d->nchunks = 0;
+  d->head = 0;
+  d->size = 0;
+  d->elem_size = elem_size;
+  d->spare = NULL;
+  d->nspare = 0;
+  return d;
+}
+
+void deq_chunked_free(deq_chunked_t *d) {
+  if (!d) return;
+  for (size_t i = 0; i < d->nchunks; i++)
+    free(d->map[d->first + i]);
+  while (d->spare) {
+    uint8_t *next = *(uint8_t **)d->spare;
+    free(d->spare);
+    d->spare = next;
+  }
+  free(d->map);
+  free(d);
+}
+
+static uint8_t *deq_chunk_get(deq_chunked_t *d) {
+  uint8_t *chunk = d->spare;
+  if (!chunk) return malloc(DEQ_CHUNK_ELEMS * d->elem_size);
+  d->spare = *(uint8_t **)chunk;
+  d->nspare--;
+  return chunk;
+}
+
+static void deq_chunk_put(deq_chunked_t *d, uint8_t *chunk) {
+  if (d->nspare == DEQ_CHUNK_SPARE) {
+    free(chunk);
+    return;
+  }
+  *(uint8_t **)chunk = d->spare;
+  d->spare = chunk;
+  d->nspare++;
+}
+
+/*
+ * Make a free map slot before the head chunk ('front') or after the tail
+ * chunk. The used slots are re-centered if the map is at most half full,
+ * otherwise the map doubles. Only chunk pointers move, never elements.
+ */
+static int deq_map_room(deq_chunked_t *d, bool front) {
+  if (front ? d->first > 0 : d->first + d->nchunks < d->map_cap) return 0;
+
+  uint8_t **map = d->map;
+  size_t cap = d->map_cap;
+  if (d->nchunks + 1 > cap / 2) {
+    cap *= 2;
+    map = malloc(cap * sizeof(uint8_t *));
+    if (!map) return -1;
+  }
+  size_t first = (cap - d->nchunks) / 2;
+  memmove(map + first, d->map + d->first, d->nchunks * sizeof(uint8_t *));
+  if (map != d->map) {
+    free(d->map);
+    d->map = map;
+    d->map_cap = cap;
+  }
+  d->first = first;
+  return 0;
+}
+
+// returns the address of the stored copy of 'elem' or NULL on allocation failure
+void *deq_chunked_push_tail(deq_chunked_t *d, const void *elem) {
+  if (d->head + d->size == d->nchunks * DEQ_CHUNK_ELEMS) {
+    if (deq_map_room(d, false)) return NULL;
+    uint8_t *chunk = deq_chunk_get(d);
+    if (!chunk) return NULL;
+    d->map[d->first + d->nchunks++] = chunk;
+  }
+  d->size++;
+  void *slot = deq_chunked_get(d, d->size - 1);
+  memcpy(slot, elem, d->elem_size);
+  return slot;
+}
+
+void *deq_chunked_push_head(deq_chunked_t *d, const void *elem) {
+  if (d->head == 0) {
+    if (deq_map_room(d, true)) return NULL;
+    uint8_t *chunk = deq_chunk_get(d);
+    if (!chunk) return NULL;
+    d->map[--d->first] = chunk;
+    d->nchunks++;
+    d->head = DEQ_CHUNK_ELEMS;
+  }
+  d->head--;
+  d->size++;
+  void *slot = deq_chunked_get(d, 0);
+  memcpy(slot, elem, d->elem_size);
+  return slot;
+}
+
+// an empty deque gives all chunks back and restarts in the middle of the map
+static void deq_chunked_reset(deq_chunked_t *d) {
+  while (d->nchunks)
+    deq_chunk_put(d, d->map[d->first + --d->nchunks]);
+  d->first = d->map_cap / 2;
+  d->head = 0;
+}
+
+// copy the tail element to 'elem' (may be NULL) and remove it, returns 0 or -1 if empty
+int deq_chunked_pop_tail(deq_chunked_t *d, void *elem) {
+  if (!d->size) return -1;
+  if (elem) memcpy(elem, deq_chunked_get(d, d->size - 1), d->elem_size);
+  d->size--;
+  if (!d->size) {
+    deq_chunked_reset(d);
+  } else if (d->nchunks * DEQ_CHUNK_ELEMS - (d->head + d->size) == DEQ_CHUNK_ELEMS) {
+    deq_chunk_put(d, d->map[d->first + --d->nchunks]);
+  }
+  return 0;
+}
+
+int deq_chunked_pop_head(deq_chunked_t *d, void *elem) {
+  if (!d->size) return -1;
+  if (elem) memcpy(elem, deq_chunked_get(d, 0), d->elem_size);
+  d->head++;
+  d->size--;
+  if (!d->size) {
+    deq_chunked_reset(d);
+  } else if (d->head == DEQ_CHUNK_ELEMS) {
+    deq_chunk_put(d, d->map[d->first++]);
+    d->nchunks--;
+    d->head = 0;
+  }
+  return 0;
+}
@@ -88,6 +88,84 @@ typedef struct deq_entry {
 
 
 
+/*
+ * Intrusive deq_t API: callers embed a struct k_list_head in their own
+ * objects and push those directly, nothing is allocated and an element is
+ * one container_of() away from its node. A deq_t is either used through
+ * this API or through the deq_entry_t one, never both; deq_free() must not
+ * be used on intrusive deques, the caller owns every node.
+ */
+static inline void deq_init(deq_t *deq) {
+  K_INIT_LIST_HEAD(&deq->list);
+  deq->size = 0;
+}
+
+static inline void deq_push_tail_node(deq_t *deq, struct k_list_head *node) {
+  k_list_add_tail(node, &deq->list);
+  deq->size++;
+}
+
+static inline void deq_push_head_node(deq_t *deq, struct k_list_head *node) {
+  k_list_add(node, &deq->list);
+  deq->size++;
+}
+
+// unlink a node from anywhere in the deque, O(1)
+static inline void deq_del_node(deq_t *deq, struct k_list_head *node) {
+  k_list_del_init(node);
+  deq->size--;
+}
+
+static inline struct k_list_head *deq_get_head_node(deq_t *deq) {
+  return k_list_empty(&deq->list) ? NULL : deq->list.next;
+}
+
+static inline struct k_list_head *deq_get_tail_node(deq_t *deq) {
+  return k_list_empty(&deq->list) ? NULL : deq->list.prev;
+}
+
+// returns the removed node or NULL if the deque is empty
+static inline struct k_list_head *deq_pop_head_node(deq_t *deq) {
+  struct k_list_head *node = deq_get_head_node(deq);
+  if (node) deq_del_node(deq, node);
+  return node;
+}
+
+static inline struct k_list_head *deq_pop_tail_node(deq_t *deq) {
+  struct k_list_head *node = deq_get_tail_node(deq);
+  if (node) deq_del_node(deq, node);
+  return node;
+}
+
+// struct containing the popped node or NULL
+#define deq_pop_head_entry(deq, type, member) \
+  ({ struct k_list_head *__node = deq_pop_head_node(deq); __node ? k_list_entry(__node, type, member) : NULL; })
+
+#define deq_pop_tail_entry(deq, type, member) \
+  ({ struct k_list_head *__node = deq_pop_tail_node(deq); __node ? k_list_entry(__node, type, member) : NULL; })
+
+#define deq_for_each_entry(pos, deq, member) k_list_for_each_entry(pos, &(deq)->list, member)
+
+#define deq_for_each_entry_safe(pos, n, deq, member) k_list_for_each_entry_safe(pos, n, &(deq)->list, member)
+
+/*
+ * Bulk transfer between deques, O(1) whatever their sizes: every element of
+ * 'src' is moved to the tail (or head) of 'dst' keeping its order and 'src'
+ * is left empty. Both deques must use the same API, intrusive or
+ * deq_entry_t.
+ */
+static inline void deq_splice_tail(deq_t *dst, deq_t *src) {
+  k_list_splice_tail_init(&src->list, &dst->list);
+  dst->size += src->size;
+  src->size = 0;
+}
+
+static inline void deq_splice_head(deq_t *dst, deq_t *src) {
+  k_list_splice_init(&src->list, &dst->list);
+  dst->size += src->size;
+  src->size = 0;
+}
+
 deq_t *deque_create(void);
 bool deq_isempty(deq_t *name);
 void deq_free(deq_t *name);
@@ -101,4 +179,116 @@ deq_entry_t *deq_pop_head(deq_t *name);
 deq_entry_t *deq_get_head(deq_t *deq);
 deq_entry_t *deq_get_tail(deq_t *deq);
 
+int deq_pop_head_nodes(deq_t *deq, struct k_list_head **nodes, int n);
+int deq_pop_tail_nodes(deq_t *deq, struct k_list_head **nodes, int n);
+int deq_pop_head_batch(deq_t *deq, void **data, int n);
+int deq_pop_tail_batch(deq_t *deq, void **data, int n);
+
+/*
+ * Array-backed deque of pointers: a power-of-two ring that doubles when
+ * full. No per-element allocation and no pointer chasing, elements can be
+ * accessed by index. Element slots move when the ring grows, use deq_t for
+ * intrusive or address-stable uses.
+ */
+#define DEQ_RING_MIN_CAPACITY 8
+
+typedef struct deq_ring {
+  void **buf;  // 'mask + 1' slots
+  size_t mask; // capacity - 1
+  size_t head; // slot of the first element
+  size_t size; // number of elements
+} deq_ring_t;
+
+deq_ring_t *deq_ring_create(size_t capacity);
+void deq_ring_free(deq_ring_t *r);
+int deq_ring_reserve(deq_ring_t *r, size_t capacity);
+
+int deq_ring_push_tail(deq_ring_t *r, void *data);
+int deq_ring_push_head(deq_ring_t *r, void *data);
+void *deq_ring_pop_tail(deq_ring_t *r);
+void *deq_ring_pop_head(deq_ring_t *r);
+
+// element 'idx' counted from the head, 'idx' must be below r->size
+static inline void *deq_ring_get(const deq_ring_t *r, size_t idx) {
+  return r->buf[(r->head + idx) & r->mask];
+}
+
+static inline void *deq_ring_get_head(const deq_ring_t *r) {
+  return r->size ? r->buf[r->head] : NULL;
+}
+
+static inline void *deq_ring_get_tail(const deq_ring_t *r) {
+  return r->size ? r->buf[(r->head + r->size - 1) & r->mask] : NULL;
+}
+
+static inline bool deq_ring_isempty(const deq_ring_t *r) {
+  return r->size == 0;
+}
+
+// walk all elements from head to tail, 'i' is a size_t index
+#define deq_ring_for_each(r, i, data) \
+  for ((i) = 0; (i) < (r)->size && ((data) = deq_ring_get((r), (i)), 1); (i)++)
+
+/*
+ * Chunked deque of fixed-size elements, like std::deque: elements live in
+ * chunks of DEQ_CHUNK_ELEMS, a map of chunk pointers grows at both ends.
+ * Elements never move, their addresses stay valid until they are popped,
+ * and traversal streams through whole chunks. Emptied chunks are kept on a
+ * short free list and reused before new ones are allocated.
+ */
+#define DEQ_CHUNK_SHIFT 6
+#define DEQ_CHUNK_ELEMS (1U << DEQ_CHUNK_SHIFT)
+#define DEQ_CHUNK_SPARE 4 // emptied chunks kept for reuse
+#define DEQ_MAP_MIN 8     // initial chunk map slots
+
+typedef struct deq_chunked {
+  uint8_t **map;     // chunk pointers, used from map[first] to map[first + nchunks - 1]
+  size_t map_cap;    // slots in map
+  size_t first;      // map slot of the head chunk
+  size_t nchunks;    // chunks in use
+  size_t head;       // index of the first element in the head chunk
+  size_t size;       // number of elements
+  size_t elem_size;  // bytes per element
+  uint8_t *spare;    // free list of recycled chunks, linked through their first bytes
+  size_t nspare;
+} deq_chunked_t;
+
+deq_chunked_t *deq_chunked_create(size_t elem_size);
+void deq_chunked_free(deq_chunked_t *d);
+
+void *deq_chunked_push_tail(deq_chunked_t *d, const void *elem);
+void *deq_chunked_push_head(deq_chunked_t *d, const void *elem);
+int deq_chunked_pop_tail(deq_chunked_t *d, void *elem);
+int deq_chunked_pop_head(deq_chunked_t *d, void *elem);
+
+// element 'idx' counted from the head, 'idx' must be below d->size
+static inline void *deq_chunked_get(const deq_chunked_t *d, size_t idx) {
+  size_t pos = d->head + idx;
+  return d->map[d->first + (pos >> DEQ_CHUNK_SHIFT)] + (pos & (DEQ_CHUNK_ELEMS - 1)) * d->elem_size;
+}
+
+/*
+ * deq_chunked_span - contiguous run of elements starting at 'idx'
+ * Returns the address of element 'idx' and stores in '*n' how many elements
+ * follow it in the same chunk, itself included.
+ */
+static inline void *deq_chunked_span(const deq_chunked_t *d, size_t idx, size_t *n) {
+  size_t off = (d->head + idx) & (DEQ_CHUNK_ELEMS - 1);
+  size_t left = d->size - idx;
+  *n = DEQ_CHUNK_ELEMS - off < left ? DEQ_CHUNK_ELEMS - off : left;
+  return deq_chunked_get(d, idx);
+}
+
+static inline void *deq_chunked_get_head(const deq_chunked_t *d) {
+  return d->size ? deq_chunked_get(d, 0) : NULL;
+}
+
+static inline void *deq_chunked_get_tail(const deq_chunked_t *d) {
+  return d->size ? deq_chunked_get(d, d->size - 1) : NULL;
+}
+
+static inline bool deq_chunked_isempty(const deq_chunked_t *d) {
+  return d->size == 0;
+}
+
 #endif
\ No newline at end of file
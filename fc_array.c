@@ -0,0 +1,230 @@
+#include <errno.h>
+#include <stdlib.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "array_size.h"
+#include "fc_array.h"
+#include "mock_mem_functions.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+/**
+ * fc_array_create - create a flat-combining associative array
+ * @bits: log2 of the bucket count
+ * @flags: same as for array_create_ex(), pooled arrays are fine
+ * @free_entry: same as for array_create(), run by the combining thread
+ * @fill_entry: same as for array_create(), run by the combining thread
+ *
+ * Returns the new array or NULL on failure.
+ */
+fc_array_t *
+fc_array_create(uint32_t bits, uint32_t flags, void (*free_entry)(void *),
+                int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  void *mem;
+  // combiner lock and slot registry sit on separate cache lines
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(fc_array_t))) return NULL;
+  fc_array_t *fc = mem;
+
+  fc->arr = array_create_ex(bits, flags, free_entry, fill_entry);
+  if (!fc->arr) {
+    free(fc);
+    return NULL;
+  }
+  fc->lock = (ht_spinlock_t)HT_SPINLOCK_INIT;
+  fc->reg_lock = (ht_spinlock_t)HT_SPINLOCK_INIT;
+  fc->combines = 0;
+  fc->combined = 0;
+  fc->slots = NULL;
+  return fc;
+}
+
+// free the array, its entries and all slots; no thread may use it any more
+int fc_array_free(fc_array_t *fc) {
+  if (!fc) return -1;
+  fc_slot_t *s = fc->slots;
+  while (s) {
+    fc_slot_t *next = s->next;
+    free(s);
+    s = next;
+  }
+  array_free(fc->arr);
+  free(fc);
+  return 0;
+}
+
+// get a publication slot for the calling thread
+fc_slot_t *fc_array_register(fc_array_t *fc) {
+  fc_slot_t *s;
+
+  ht_spin_lock(&fc->reg_lock);
+  for (s = fc->slots; s; s = s->next) {
+    if (!s->in_use) break;
+  }
+  if (!s) {
+    void *mem;
+    if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(fc_slot_t))) {
+      ht_spin_unlock(&fc->reg_lock);
+      return NULL;
+    }
+    s = mem;
+    s->fc = fc;
+    s->op = 0;
+    s->next = fc->slots;
+    // combiners walk the registry without the lock
+    rcu_assign_pointer(fc->slots, s);
+  }
+  s->in_use = 1;
+  ht_spin_unlock(&fc->reg_lock);
+  return s;
+}
+
+// give a slot back, it must have no request pending
+void fc_array_unregister(fc_slot_t *s) {
+  if (!s) return;
+  ht_spin_lock(&s->fc->reg_lock);
+  s->in_use = 0;
+  ht_spin_unlock(&s->fc->reg_lock);
+}
+
+static int fc_apply(assoc_array_t *arr, fc_slot_t *s) {
+  assoc_array_entry_t *e;
+
+  switch (s->op) {
+  case FC_OP_ADD:
+    return array_add_hashed(arr, s->hash, s->data, s->key, s->key_size);
+  case FC_OP_ADD_REPLACE:
+    return array_add_replace_hashed(arr, s->hash, s->data, s->key, s->key_size);
+  case FC_OP_DEL:
+    return array_del_hashed(arr, s->hash, s->key, s->key_size);
+  case FC_OP_LOOKUP:
+    e = array_get_by_key_hashed(arr, s->hash, s->key, s->key_size);
+    if (!e) return -1;
+    return s->fn ? s->fn(e, s->arg) : 0;
+  case FC_OP_DEL_FIRST:
+    return array_del_first(arr);
+  case FC_OP_DEL_LAST:
+    return array_del_last(arr);
+  }
+  return -1;
+}
+
+/*
+ * One combining turn, the combiner lock is held. Each pass first collects
+ * the pending slots and prefetches their buckets so the misses overlap,
+ * then applies the requests in registry order and releases their owners.
+ */
+static void fc_combine(fc_array_t *fc) {
+  assoc_array_t *arr = fc->arr;
+  fc_slot_t *batch[64];
+
+  fc->combines++;
+  for (int pass = 0; pass < FC_COMBINE_PASSES; pass++) {
+    size_t applied = 0;
+    fc_slot_t *s = smp_load_acquire(&fc->slots);
+
+    while (s) {
+      size_t n = 0;
+      for (; s && n < ARRAY_SIZE(batch); s = s->next) {
+        if (!smp_load_acquire(&s->op)) continue;
+        if (s->key) __builtin_prefetch(&arr->ht->table[ht_bkt(arr->ht, s->hash)]);
+        batch[n++] = s;
+      }
+      for (size_t i = 0; i < n; i++) {
+        batch[i]->ret = fc_apply(arr, batch[i]);
+        smp_store_release(&batch[i]->op, 0); // hands the slot back to its owner
+      }
+      applied += n;
+    }
+    fc->combined += applied;
+    if (!applied) break; // nothing new arrived since the last pass
+  }
+}
+
+// publish a request and wait until some combiner, maybe this thread, applied it
+static int fc_run(fc_slot_t *s, uint32_t op) {
+  fc_array_t *fc = s->fc;
+
+  smp_store_release(&s->op, op);
+  for (;;) {
+    if (!smp_load_acquire(&s->op)) return s->ret;
+    if (ht_spin_trylock(&fc->lock)) {
+      fc_combine(fc);
+      ht_spin_unlock(&fc->lock);
+    } else {
+      cpu_relax();
+    }
+  }
+}
+
+static int fc_run_key(fc_slot_t *s, uint32_t op, void *data, void *key, uint8_t key_size) {
+  if (!s) return -1;
+  s->hash = hash64_str(key, key_size); // outside the combiner's critical path
+  s->key = key;
+  s->key_size = key_size;
+  s->data = data;
+  return fc_run(s, op);
+}
+
+int fc_array_add(fc_slot_t *s, void *data, void *key, uint8_t key_size) {
+  return fc_run_key(s, FC_OP_ADD, data, key, key_size);
+}
+
+int fc_array_add_replace(fc_slot_t *s, void *data, void *key, uint8_t key_size) {
+  return fc_run_key(s, FC_OP_ADD_REPLACE, data, key, key_size);
+}
+
+// returns 0 if an entry was deleted, 1 if the key was not found
+int fc_array_del(fc_slot_t *s, void *key, uint8_t key_size) {
+  if (!s) return EINVAL;
+  return fc_run_key(s, FC_OP_DEL, NULL, key, key_size);
+}
+
+/**
+ * fc_array_lookup - run a callback on the entry of a key
+ * @s: slot of the calling thread
+ * @key: the key
+ * @key_size: its size
+ * @fn: called with the entry by the combining thread, may be NULL;
+ *      must not call back into the array
+ * @arg: passed to @fn
+ *
+ * Returns -1 if the key was not found, otherwise the return value of @fn
+ * (0 if @fn is NULL).
+ */
+int fc_array_lookup(fc_slot_t *s, void *key, uint8_t key_size, int (*fn)(assoc_array_entry_t *entry, void *arg),
+                    void *arg) {
+  if (!s) return -1;
+  s->fn = fn;
+  s->arg = arg;
+  return fc_run_key(s, FC_OP_LOOKUP, NULL, key, key_size);
+}
+
+static int fc_copy_data(assoc_array_entry_t *entry, void *arg) {
+  *(void **)arg = entry->data;
+  return 0;
+}
+
+// store the data of 'key' in '*data', returns 0 or -1 if the key was not found
+int fc_array_get_data(fc_slot_t *s, void *key, uint8_t key_size, void **data) {
+  return fc_array_lookup(s, key, key_size, fc_copy_data, data);
+}
+
+int fc_array_del_first(fc_slot_t *s) {
+  if (!s) return -1;
+  s->key = NULL; // nothing to prefetch
+  return fc_run(s, FC_OP_DEL_FIRST);
+}
+
+int fc_array_del_last(fc_slot_t *s) {
+  if (!s) return -1;
+  s->key = NULL;
+  return fc_run(s, FC_OP_DEL_LAST);
+}
+
+size_t fc_array_size(const fc_array_t *fc) {
+  return __atomic_load_n(&fc->arr->size, __ATOMIC_RELAXED);
+}
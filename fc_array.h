@@ -0,0 +1,76 @@
+/*
+ * Flat-combining front end for assoc_array_t
+ *
+ * Instead of fighting over bucket locks, every thread publishes its request
+ * in a per-thread slot on its own cache line and the thread that gets the
+ * combiner lock applies all pending requests in one batch. The array itself
+ * is only ever touched by the current combiner, so its cache lines stay in
+ * one core's cache for a whole batch and pooled arrays (ARRAY_POOL,
+ * ARRAY_STABLE) can be used as is. Requests that were applied by someone
+ * else cost their thread nothing but spinning on its own slot.
+ *
+ * A batch hashes nothing itself: publishers hash their key first, the
+ * combiner prefetches the buckets of all pending requests and then runs
+ * them through the array_*_hashed() functions with those hashes.
+ */
+
+#ifndef __FC_ARRAY_H__
+#define __FC_ARRAY_H__
+
+#include "assoc_array.h"
+#include "ht_lock.h"
+
+#define FC_COMBINE_PASSES 4 // slot scans per combining turn while new requests keep arriving
+
+// fc_slot.op values, 0 means no request is pending
+#define FC_OP_ADD 1
+#define FC_OP_ADD_REPLACE 2
+#define FC_OP_DEL 3
+#define FC_OP_LOOKUP 4
+#define FC_OP_DEL_FIRST 5
+#define FC_OP_DEL_LAST 6
+
+// per thread publication record, written by its owner and the combiner only
+typedef struct fc_slot {
+  uint32_t op; // FC_OP_* of the pending request, cleared by the combiner once applied
+  uint8_t key_size;
+  int ret;     // result of the last request
+  u64 hash;    // hash of key, computed by the publisher
+  void *key;
+  void *data;
+  int (*fn)(assoc_array_entry_t *entry, void *arg); // FC_OP_LOOKUP callback, run by the combiner
+  void *arg;
+  struct fc_array *fc;  // array the slot is registered with
+  struct fc_slot *next; // registry link, slots are reused but never freed before fc_array_free()
+  int in_use;           // owned by a registered thread
+} __attribute__((aligned(HT_CACHELINE_SIZE))) fc_slot_t;
+
+typedef struct fc_array {
+  assoc_array_t *arr;                                             // the wrapped array, combiner only
+  ht_spinlock_t lock __attribute__((aligned(HT_CACHELINE_SIZE))); // combiner lock
+  size_t combines;                                                // combining turns taken (statistics)
+  size_t combined;                                                // requests applied in them
+  fc_slot_t *slots __attribute__((aligned(HT_CACHELINE_SIZE)));
+  ht_spinlock_t reg_lock; // slot registry updates
+} fc_array_t;
+
+fc_array_t *
+fc_array_create(uint32_t bits, uint32_t flags, void (*free_entry)(void *),
+                int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+int fc_array_free(fc_array_t *fc);
+
+fc_slot_t *fc_array_register(fc_array_t *fc);
+void fc_array_unregister(fc_slot_t *s);
+
+int fc_array_add(fc_slot_t *s, void *data, void *key, uint8_t key_size);
+int fc_array_add_replace(fc_slot_t *s, void *data, void *key, uint8_t key_size);
+int fc_array_del(fc_slot_t *s, void *key, uint8_t key_size);
+int fc_array_lookup(fc_slot_t *s, void *key, uint8_t key_size, int (*fn)(assoc_array_entry_t *entry, void *arg),
+                    void *arg);
+int fc_array_get_data(fc_slot_t *s, void *key, uint8_t key_size, void **data);
+int fc_array_del_first(fc_slot_t *s);
+int fc_array_del_last(fc_slot_t *s);
+
+size_t fc_array_size(const fc_array_t *fc);
+
+#endif
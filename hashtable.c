@@ -6,6 +6,7 @@
 #include "jemalloc.h"
 #endif
 #include "hashtable.h"
+#include "ht_mem.h"
 #include "mock_mem_functions.h"
 
 // redefine mem functions with custom version
@@ -13,17 +14,55 @@
 #define calloc custom_calloc
 #define free custom_free
 
-hashtable_t *ht_create(uint32_t bits) {
+static hashtable_t *_ht_create(uint32_t bits, size_t size, uint32_t flags) {
+  // bucket array size in bytes must not overflow size_t
+  if (size > SIZE_MAX / sizeof(struct hlist_head)) return NULL;
+
   hashtable_t *ht = malloc(sizeof(hashtable_t));
   if (!ht) return NULL;
 
   ht->bits = bits;
-  ht->table = malloc((1 << bits) * sizeof(struct hlist_head));
+  ht->size = size;
+  ht->flags = flags;
+  // zero-filled memory is an array of empty buckets, no hashtable_init() needed
+  ht->table = ht_mem_zalloc(size * sizeof(struct hlist_head), HT_MEM_OPTS(flags), &ht->mem);
   if (!ht->table) {
     free(ht);
     return NULL;
   }
 
-  hashtable_init(ht);
   return ht;
 }
+
+hashtable_t *ht_create(uint32_t bits) {
+  return ht_create_ex(bits, 0);
+}
+
+// same as ht_create() with HT_* creation options
+hashtable_t *ht_create_ex(uint32_t bits, uint32_t flags) {
+  if (bits >= sizeof(size_t) * 8) return NULL; // 1 << bits must fit size_t
+  return _ht_create(bits, (size_t)1 << bits, flags & HT_CREATE_MASK);
+}
+
+// create a hashtable with exactly 'size' buckets, 'size' need not be a power of two
+hashtable_t *ht_create_size(size_t size, uint32_t flags) {
+  if (size == 0) return NULL;
+  if (is_power_of_2(size)) return ht_create_ex(ilog2(size), flags);
+
+  flags &= HT_CREATE_MASK;
+  flags |= size > UINT32_MAX ? HT_FASTRANGE | HT_FASTRANGE64 : HT_FASTRANGE;
+  return _ht_create(0, size, flags);
+}
+
+// free the bucket array and the hashtable_t itself, entries must be removed beforehand
+void ht_destroy(hashtable_t *ht) {
+  if (!ht) return;
+  ht_mem_free(ht->table, ht->size * sizeof(struct hlist_head), ht->mem);
+  free(ht);
+}
+
+void ht_get_stats(const hashtable_t *ht, struct ht_stats *stats) {
+  stats->buckets = ht->size;
+  stats->table_bytes = ht->size * sizeof(struct hlist_head);
+  stats->mem = ht->mem;
+}
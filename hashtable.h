@@ -27,13 +27,24 @@ void set_ht_create_function(void *(*ht_create_func)(uint32_t));
  *
  * The 'table' pointer should point to a dynamically allocated array of hlist_head
  * structures, each of which serves as the head of a linked list for handling hash
- * collisions. The actual hash table size (number of buckets) is computed as 1 << bits.
+ * collisions. The actual hash table size (number of buckets) is computed as 1 << bits
+ * and cached in 'size'.
+ *
+ * Tables created with ht_create_size() may have any number of buckets. If it is not
+ * a power of two, HT_FASTRANGE is set, 'bits' is 0 and only the hashtable_* helpers
+ * (which go through ht_bkt() and 'size') may be used on it, not the hash_*_bits ones.
+ *
+ * Bucket counts, bucket indices and keys are 64-bit. Tables with more than 2^32 buckets
+ * must be fed 64-bit hashes (e.g. hash64_str()), a 32-bit hash can only reach the first
+ * 2^32 buckets of a power-of-two table.
  *
  * Example Usage:
  *
  * hashtable_t my_hashtable;
- * my_hashtable.table = malloc((1 << my_hashtable.bits) * sizeof(struct hlist_head));
  * my_hashtable.bits = 10; // Example: creating a hash table with 1024 buckets
+ * my_hashtable.size = 1 << my_hashtable.bits;
+ * my_hashtable.flags = 0;
+ * my_hashtable.table = malloc(my_hashtable.size * sizeof(struct hlist_head));
  *
  * // ... [Operations on the hash table] ...
  *
@@ -43,9 +54,44 @@ void set_ht_create_function(void *(*ht_create_func)(uint32_t));
 
 typedef struct hashtable {
   struct hlist_head *table; // Pointer to an array of hlist_head, representing the hash table's buckets array
-  uint32_t bits;            // Number of bits determining the size of the table
+  uint32_t bits;            // Number of bits determining the size of the table (power-of-two tables only)
+  uint32_t flags;           // HT_* flags
+  size_t size;              // Number of buckets
+  uint32_t mem;             // HT_MEM_* flags describing how ht_create() obtained 'table'
 } hashtable_t;
 
+// hashtable_t flags
+#define HT_FASTRANGE (1U << 0)   // size is not a power of two, buckets are selected with calc_bkt_range()
+#define HT_FASTRANGE64 (1U << 1) // HT_FASTRANGE with more than 2^32 buckets, uses calc_bkt_range64()
+
+/*
+ * ht_create_ex()/ht_create_size() options, bits 8-23 are reserved for them.
+ * They are the HT_MEM_OPT_* options of ht_mem.h shifted left by 8.
+ */
+#define HT_HUGETLB (1U << 8)                              // back the bucket array with hugetlbfs pages, falling back to HT_THP
+#define HT_THP (1U << 9)                                  // back the bucket array with transparent huge pages
+#define HT_INTERLEAVE (1U << 10)                          // interleave the bucket array over all NUMA nodes, overrides HT_NODE()
+#define HT_LOCKED (1U << 11)                              // fault in and mlock() the bucket array at creation
+#define HT_NODE(n) ((((uint32_t)(n) + 1) & 0xff) << 16) // place the bucket array on NUMA node n
+#define HT_CREATE_MASK 0xffff00U
+
+// HT_MEM_OPT_* options for ht_mem_zalloc() matching the HT_* creation options in 'flags'
+#define HT_MEM_OPTS(flags) (((flags) & HT_CREATE_MASK) >> 8)
+
+/**
+ * struct ht_stats - hashtable_t memory statistics, filled by ht_get_stats()
+ * @buckets: number of buckets
+ * @table_bytes: size of the bucket array in bytes
+ * @mem: HT_MEM_* flags describing the backing actually obtained for the bucket
+ *       array, ht_mem_backing_name() turns them into "heap", "mmap", "thp" or "hugetlb",
+ *       ht_mem_placement_name() into the NUMA placement
+ */
+struct ht_stats {
+  size_t buckets;
+  size_t table_bytes;
+  uint32_t mem;
+};
+
 #define DEFINE_HASHTABLE(name, bits)    \
   struct hlist_head name[1 << (bits)] = \
       {[0 ...((1 << (bits)) - 1)] = HLIST_HEAD_INIT}
@@ -72,11 +118,63 @@ typedef struct hashtable {
  * @param divisor The divisor, which must be a power of two.
  * @return The remainder of 'num' divided by 'divisor'.
  */
-static inline u32 calc_bkt(u32 num, int divisor) {
-  return (u32)num & (divisor - 1);
+static inline u64 calc_bkt(u64 num, u64 divisor) {
+  return num & (divisor - 1);
+}
+
+/**
+ * Maps 'num' onto [0, range) for any 'range' (Lemire's fastrange).
+ *
+ * The 32-bit hash is treated as a fraction of 2^32 and scaled by 'range' with a
+ * single widening multiply, so no division is needed and the bucket is taken from
+ * the high bits of the hash, which are the well mixed ones for the multiplicative
+ * hashes in hash.h. Unlike calc_bkt() the result is not 'num' modulo 'range'.
+ *
+ * @param num The hash value.
+ * @param range The number of buckets, must not be 0.
+ * @return A bucket index in [0, range).
+ */
+static inline u32 calc_bkt_range(u32 num, u32 range) {
+  return (u32)(((u64)num * range) >> 32);
+}
+
+/**
+ * Same as calc_bkt_range() for a 64-bit hash and more than 2^32 buckets.
+ */
+static inline u64 calc_bkt_range64(u64 num, u64 range) {
+#ifdef __SIZEOF_INT128__
+  return (u64)(((unsigned __int128)num * range) >> 64);
+#else
+  // 64x64 -> high 64 bits multiply from 32-bit halves
+  u64 lo = (u64)(u32)num * (u32)range;
+  u64 m1 = (num >> 32) * (u32)range + (lo >> 32);
+  u64 m2 = (u64)(u32)num * (range >> 32) + (u32)m1;
+  return (num >> 32) * (range >> 32) + (m1 >> 32) + (m2 >> 32);
+#endif
+}
+
+/**
+ * ht_bkt - select the bucket of a key in a hashtable_t
+ * @ht: Pointer to the hashtable_t structure
+ * @key: The hash of the object
+ *
+ * Power-of-two tables keep using calc_bkt() so bucket indices stay the same as with
+ * the hash_*_bits macros, other sizes go through calc_bkt_range(). Up to 2^32 buckets
+ * the two halves of the key are folded first, so 32-bit and 64-bit hashes both work.
+ */
+static inline size_t ht_bkt(const hashtable_t *ht, u64 key) {
+  if (ht->flags & HT_FASTRANGE64)
+    return calc_bkt_range64(key, ht->size);
+  if (ht->flags & HT_FASTRANGE)
+    return calc_bkt_range((u32)(key ^ (key >> 32)), ht->size);
+  return calc_bkt(key, ht->size);
 }
 
 hashtable_t *ht_create(uint32_t bits);
+hashtable_t *ht_create_ex(uint32_t bits, uint32_t flags);
+hashtable_t *ht_create_size(size_t size, uint32_t flags);
+void ht_destroy(hashtable_t *ht);
+void ht_get_stats(const hashtable_t *ht, struct ht_stats *stats);
 
 /**
  * CLEAR_HASHTABLE_BITS - safely clear and free all elements in a hash table
@@ -118,11 +216,17 @@ hashtable_t *ht_create(uint32_t bits);
  *
  */
 #define CLEAR_HASHTABLE_BITS(tbl, bits, struct_type, node_member, free_func) \
+  CLEAR_HASHTABLE_SIZE(tbl, (size_t)1 << (bits), struct_type, node_member, free_func)
+
+/**
+ * CLEAR_HASHTABLE_SIZE - same as CLEAR_HASHTABLE_BITS for a table of @size buckets
+ */
+#define CLEAR_HASHTABLE_SIZE(tbl, size, struct_type, node_member, free_func) \
   do {                                                                       \
-    uint32_t bkt;                                                            \
+    size_t bkt;                                                              \
     struct hlist_node *tmp;                                                  \
     struct_type *cur;                                                        \
-    hash_for_each_safe_bits(tbl, bits, bkt, tmp, cur, node_member) {         \
+    hash_for_each_safe_size(tbl, size, bkt, tmp, cur, node_member) {         \
       hash_del(&cur->node_member);                                           \
       free_func(cur);                                                        \
     }                                                                        \
@@ -136,7 +240,7 @@ hashtable_t *ht_create(uint32_t bits);
  * @count: Variable to store the count of entries
  *
  * This macro is used for iterating over a hash table to count the total number
- * of entries it contains. It leverages the hash_for_each_bits macro to iterate
+ * of entries it contains. It leverages the hash_for_each_size macro to iterate
  * over every bucket and every entry within those buckets in the hash table,
  * incrementing the count for each found entry.
  *
@@ -168,9 +272,9 @@ hashtable_t *ht_create(uint32_t bits);
 #define COUNT_ENTRIES_IN_HASHTABLE(ht, type, node, count)     \
   do {                                                        \
     count = 0;                                                \
-    uint32_t bkt;                                             \
+    size_t bkt;                                               \
     type *cur;                                                \
-    hash_for_each_bits(ht->table, ht->bits, bkt, cur, node) { \
+    hash_for_each_size(ht->table, ht->size, bkt, cur, node) { \
       count++;                                                \
     }                                                         \
   } while (0)
@@ -182,7 +286,7 @@ hashtable_t *ht_create(uint32_t bits);
  * @node_member: The name of the hlist_node member within the struct_type
  * @free_func: Function pointer for custom memory deallocation of the struct_type
  *
- * This macro is an extension of CLEAR_HASHTABLE_BITS and is specifically designed to be used
+ * This macro is an extension of CLEAR_HASHTABLE_SIZE and is specifically designed to be used
  * with a hashtable_t structure. It encapsulates the functionality of CLEAR_HASHTABLE_BITS
  * by automatically providing the hash table and its size from the hashtable_t structure.
  * This macro iterates over the hash table within the hashtable_t structure, safely removing
@@ -208,9 +312,8 @@ hashtable_t *ht_create(uint32_t bits);
  */
 #define HT_FREE(ht, struct_type, node_member, free_func)                                \
   do {                                                                                  \
-    CLEAR_HASHTABLE_BITS((ht)->table, (ht)->bits, struct_type, node_member, free_func); \
-    free((ht)->table);                                                                  \
-    free(ht);                                                                           \
+    CLEAR_HASHTABLE_SIZE((ht)->table, (ht)->size, struct_type, node_member, free_func); \
+    ht_destroy(ht);                                                                     \
   } while (0)
 
 /**
@@ -221,10 +324,7 @@ hashtable_t *ht_create(uint32_t bits);
  *
  * This macro is used to add an object to a hash table. It calculates the appropriate
  * bucket for the object based on the provided key and the size of the hash table
- * (determined by the number of bits stored in the hashtable_t structure).
- *
- * It is a wrapper around the hash_add_bits macro, leveraging the hashtable_t
- * structure to simplify the process of adding objects to the hash table.
+ * with ht_bkt(), so it works for tables of any size.
  *
  * Usage Example:
  *
@@ -239,7 +339,7 @@ hashtable_t *ht_create(uint32_t bits);
  * hashtable_add(&my_hashtable, &data.node, key);
  */
 #define hashtable_add(ht, node, key) \
-  hash_add_bits((ht)->table, (ht)->bits, node, key)
+  hlist_add_head(node, &(ht)->table[ht_bkt(ht, key)])
 
 /**
  * hashtable_del - delete an object from a hashtable
@@ -269,8 +369,8 @@ hashtable_t *ht_create(uint32_t bits);
 #define hashtable_del(ht, node) \
   hash_del_bits((ht)->table, (ht)->bits, node)
 
-static inline void __hash_init(struct hlist_head *ht, unsigned int sz) {
-  unsigned int i;
+static inline void __hash_init(struct hlist_head *ht, size_t sz) {
+  size_t i;
 
   for (i = 0; i < sz; i++)
     INIT_HLIST_HEAD(&ht[i]);
@@ -302,11 +402,13 @@ static inline void __hash_init(struct hlist_head *ht, unsigned int sz) {
  * Usage Example:
  *
  * hashtable_t my_hashtable;
- * my_hashtable.table = malloc((1 << bits) * sizeof(struct hlist_head));
  * my_hashtable.bits = bits;
+ * my_hashtable.size = 1 << bits;
+ * my_hashtable.flags = 0;
+ * my_hashtable.table = malloc(my_hashtable.size * sizeof(struct hlist_head));
  * hashtable_init(&my_hashtable);
  */
-#define hashtable_init(ht) __hash_init((ht)->table, 1 << (ht)->bits)
+#define hashtable_init(ht) __hash_init((ht)->table, (ht)->size)
 
 /**
  * hash_add - add an object to a hashtable
@@ -315,10 +417,10 @@ static inline void __hash_init(struct hlist_head *ht, unsigned int sz) {
  * @key: the key of the object to be added
  */
 #define hash_add(hashtable, node, key) \
-  hlist_add_head(node, &hashtable[calc_bkt(key, 1 << (bits))])
+  hlist_add_head(node, &hashtable[calc_bkt(key, HASH_SIZE(hashtable))])
 
 #define hash_add_bits(hashtable, bits, node, key) \
-  hlist_add_head(node, &hashtable[calc_bkt(key, 1 << (bits))])
+  hlist_add_head(node, &hashtable[calc_bkt(key, (u64)1 << (bits))])
 
 /**
  * hash_hashed - check whether an object is in any hashtable
@@ -328,8 +430,8 @@ static inline int hash_hashed(struct hlist_node *node) {
   return !hlist_unhashed(node);
 }
 
-static inline int __hash_empty(struct hlist_head *ht, unsigned int sz) {
-  unsigned int i;
+static inline int __hash_empty(struct hlist_head *ht, size_t sz) {
+  size_t i;
 
   for (i = 0; i < sz; i++)
     if (!hlist_empty(&ht[i]))
@@ -367,11 +469,19 @@ static inline void hash_del(struct hlist_node *node) {
        (bkt)++)                                                       \
   hlist_for_each_entry(obj, &name[bkt], member)
 
-#define hash_for_each_bits(name, bits, bkt, obj, member)                    \
-  for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < (unsigned)(1 << bits); \
-       (bkt)++)                                                             \
+#define hash_for_each_bits(name, bits, bkt, obj, member)                        \
+  for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < ((size_t)1 << (bits)); \
+       (bkt)++)                                                                 \
+  hlist_for_each_entry(obj, &name[bkt], member)
+
+#define hash_for_each_size(name, size, bkt, obj, member)                 \
+  for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < (size_t)(size); \
+       (bkt)++)                                                          \
   hlist_for_each_entry(obj, &name[bkt], member)
 
+#define hashtable_for_each(ht, bkt, obj, member) \
+  hash_for_each_size((ht)->table, (ht)->size, bkt, obj, member)
+
 /**
  * hash_for_each_safe - iterate over a hashtable safe against removal of
  * hash entry
@@ -386,9 +496,14 @@ static inline void hash_del(struct hlist_node *node) {
        (bkt)++)                                                         \
   hlist_for_each_entry_safe(obj, tmp, &name[bkt], member)
 
-#define hash_for_each_safe_bits(name, bits, bkt, tmp, obj, member)          \
-  for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < (unsigned)(1 << bits); \
-       (bkt)++)                                                             \
+#define hash_for_each_safe_bits(name, bits, bkt, tmp, obj, member)              \
+  for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < ((size_t)1 << (bits)); \
+       (bkt)++)                                                                 \
+  hlist_for_each_entry_safe(obj, tmp, &name[bkt], member)
+
+#define hash_for_each_safe_size(name, size, bkt, tmp, obj, member)       \
+  for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < (size_t)(size); \
+       (bkt)++)                                                          \
   hlist_for_each_entry_safe(obj, tmp, &name[bkt], member)
 
 /**
@@ -400,10 +515,74 @@ static inline void hash_del(struct hlist_node *node) {
  * @key: the key of the objects to iterate over
  */
 #define hash_for_each_possible(name, obj, member, key) \
-  hlist_for_each_entry(obj, &name[calc_bkt(key, 1 << HASH_BITS(name))], member)
+  hlist_for_each_entry(obj, &name[calc_bkt(key, HASH_SIZE(name))], member)
 
 #define hash_for_each_possible_bits(name, hash_bits, obj, member, key) \
-  hlist_for_each_entry(obj, &name[calc_bkt(key, 1 << (hash_bits))], member)
+  hlist_for_each_entry(obj, &name[calc_bkt(key, (u64)1 << (hash_bits))], member)
+
+#define hashtable_for_each_possible(ht, obj, member, key) \
+  hlist_for_each_entry(obj, &(ht)->table[ht_bkt(ht, key)], member)
+
+// hashtable_add() for tables read concurrently with hashtable_for_each_possible_rcu()
+#define hashtable_add_rcu(ht, node, key) hlist_add_head_rcu(node, &(ht)->table[ht_bkt(ht, key)])
+
+/**
+ * hashtable_for_each_possible_rcu - lock-free walk of the bucket of a key
+ * @ht: Pointer to the hashtable_t structure
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ * @key: the key of the objects to iterate over
+ *
+ * Writers must use hashtable_add_rcu()/hlist_del_rcu() and defer freeing
+ * removed objects until a grace period has elapsed (qsbr.h).
+ */
+#define hashtable_for_each_possible_rcu(ht, obj, member, key) \
+  hlist_for_each_entry_rcu(obj, &(ht)->table[ht_bkt(ht, key)], member)
+
+/*
+ * Per-bucket bit locks: bit 0 of every bucket head is a spinlock (hlist_bl in
+ * list.h), which gives one lock per bucket at no memory cost. A table used
+ * concurrently this way must only be changed through the hashtable_bl_*
+ * helpers and walked with hashtable_bl_for_each_possible() under the bucket
+ * lock; the plain macros above are fine again once no thread holds a lock
+ * (e.g. HT_FREE() at teardown).
+ */
+
+// lock the bucket of 'key' and return its head
+static inline struct hlist_head *hashtable_bl_lock(hashtable_t *ht, u64 key) {
+  struct hlist_head *head = &ht->table[ht_bkt(ht, key)];
+  hlist_bl_lock(head);
+  return head;
+}
+
+static inline void hashtable_bl_unlock(struct hlist_head *head) {
+  hlist_bl_unlock(head);
+}
+
+static inline void hashtable_bl_add(hashtable_t *ht, struct hlist_node *node, u64 key) {
+  struct hlist_head *head = hashtable_bl_lock(ht, key);
+  hlist_bl_add_head(node, head);
+  hlist_bl_unlock(head);
+}
+
+// 'key' must be the key 'node' was added with, it selects the bucket lock
+static inline void hashtable_bl_del(hashtable_t *ht, struct hlist_node *node, u64 key) {
+  struct hlist_head *head = hashtable_bl_lock(ht, key);
+  hlist_bl_del(node);
+  hlist_bl_unlock(head);
+}
+
+/**
+ * hashtable_bl_for_each_possible - iterate over a bit-locked bucket
+ * @ht: Pointer to the hashtable_t structure
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ * @key: the key of the objects to iterate over
+ *
+ * The bucket must be locked with hashtable_bl_lock(ht, key).
+ */
+#define hashtable_bl_for_each_possible(ht, obj, member, key) \
+  hlist_bl_for_each_entry(obj, &(ht)->table[ht_bkt(ht, key)], member)
 
 /**
  * hash_for_each_possible_safe - iterate over all possible objects hashing to the
@@ -416,6 +595,6 @@ static inline void hash_del(struct hlist_node *node) {
  */
 #define hash_for_each_possible_safe(name, obj, tmp, member, key) \
   hlist_for_each_entry_safe(obj, tmp,                            \
-                            &name[calc_bkt(key, 1 << HASH_BITS(name))], member)
+                            &name[calc_bkt(key, HASH_SIZE(name))], member)
 
 #endif
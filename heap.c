@@ -0,0 +1,311 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "heap.h"
+#include "ht_lock.h"
+#include "mock_mem_functions.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+/*
+ * Slots placed before slots[0] in the allocation: with 16-byte slots
+ * slots[4 * i + 1] then starts at 64 * (i + 1) bytes into the
+ * cache-aligned allocation, so all children of slot i share a line.
+ */
+#define DHEAP_PAD (HT_CACHELINE_SIZE / sizeof(struct dheap_slot) - 1)
+
+dheap_t *dheap_create(size_t capacity) {
+  dheap_t *h = malloc(sizeof(dheap_t));
+  if (!h) return NULL;
+  *h = (dheap_t){0};
+  if (dheap_reserve(h, capacity < DHEAP_MIN_CAPACITY ? DHEAP_MIN_CAPACITY : capacity)) {
+    free(h);
+    return NULL;
+  }
+  return h;
+}
+
+// free the heap, queued nodes are not touched
+void dheap_free(dheap_t *h) {
+  if (!h) return;
+  free(h->mem);
+  free(h);
+}
+
+/**
+ * dheap_reserve - make room for @capacity nodes
+ * @h: heap
+ * @capacity: number of nodes, smaller values are ignored
+ *
+ * Returns 0 or -1 on allocation failure, the heap is unchanged then.
+ */
+int dheap_reserve(dheap_t *h, size_t capacity) {
+  if (capacity <= h->capacity) return 0;
+  if (capacity > SIZE_MAX / 2 / sizeof(struct dheap_slot) - DHEAP_PAD) return -1;
+  size_t cap = h->capacity ? h->capacity : DHEAP_MIN_CAPACITY;
+  while (cap < capacity)
+    cap <<= 1;
+
+  void *mem;
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, (cap + DHEAP_PAD) * sizeof(struct dheap_slot))) return -1;
+  struct dheap_slot *slots = (struct dheap_slot *)mem + DHEAP_PAD;
+  if (h->size) memcpy(slots, h->slots, h->size * sizeof(struct dheap_slot));
+  free(h->mem);
+  h->mem = mem;
+  h->slots = slots;
+  h->capacity = cap;
+  return 0;
+}
+
+static inline void dheap_set(dheap_t *h, size_t i, struct dheap_slot s) {
+  h->slots[i] = s;
+  s.node->idx = i;
+}
+
+static void dheap_sift_up(dheap_t *h, size_t i) {
+  struct dheap_slot s = h->slots[i];
+
+  while (i) {
+    size_t parent = (i - 1) / DHEAP_ARITY;
+    if (h->slots[parent].key <= s.key) break;
+    dheap_set(h, i, h->slots[parent]);
+    i = parent;
+  }
+  dheap_set(h, i, s);
+}
+
+static void dheap_sift_down(dheap_t *h, size_t i) {
+  struct dheap_slot s = h->slots[i];
+
+  for (;;) {
+    size_t first = DHEAP_ARITY * i + 1;
+    if (first >= h->size) break;
+    size_t last = first + DHEAP_ARITY < h->size ? first + DHEAP_ARITY : h->size;
+    size_t best = first;
+    for (size_t c = first + 1; c < last; c++)
+      if (h->slots[c].key < h->slots[best].key) best = c;
+    if (h->slots[best].key >= s.key) break;
+    dheap_set(h, i, h->slots[best]);
+    i = best;
+  }
+  dheap_set(h, i, s);
+}
+
+/**
+ * dheap_push - queue a node
+ * @h: heap
+ * @node: node, must not be queued
+ * @key: its key
+ *
+ * Returns 0 or -1 if the array had to grow and allocation failed.
+ */
+int dheap_push(dheap_t *h, struct dheap_node *node, uint64_t key) {
+  if (h->size == h->capacity && dheap_reserve(h, h->size + 1)) return -1;
+  node->key = key;
+  h->slots[h->size] = (struct dheap_slot){key, node};
+  dheap_sift_up(h, h->size++);
+  return 0;
+}
+
+// remove and return the node with the smallest key, NULL if the heap is empty
+struct dheap_node *dheap_pop(dheap_t *h) {
+  if (!h->size) return NULL;
+  struct dheap_node *node = h->slots[0].node;
+  if (--h->size) {
+    h->slots[0] = h->slots[h->size];
+    dheap_sift_down(h, 0);
+  }
+  node->idx = DHEAP_NONE;
+  return node;
+}
+
+// change the key of a queued node, it moves up or down as needed
+void dheap_update(dheap_t *h, struct dheap_node *node, uint64_t key) {
+  size_t i = node->idx;
+  uint64_t old = h->slots[i].key;
+
+  node->key = h->slots[i].key = key;
+  if (key < old)
+    dheap_sift_up(h, i);
+  else if (key > old)
+    dheap_sift_down(h, i);
+}
+
+// remove a queued node from anywhere in the heap
+void dheap_del(dheap_t *h, struct dheap_node *node) {
+  size_t i = node->idx;
+
+  if (i != --h->size) {
+    uint64_t old = h->slots[i].key;
+    h->slots[i] = h->slots[h->size];
+    if (h->slots[i].key < old)
+      dheap_sift_up(h, i);
+    else
+      dheap_sift_down(h, i);
+  }
+  node->idx = DHEAP_NONE;
+}
+
+/**
+ * dheap_heapify - queue @n nodes at once
+ * @h: heap
+ * @nodes: nodes to queue with their key already set, none may be queued
+ * @n: number of them
+ *
+ * Appends the nodes and restores the heap bottom-up (Floyd), O(size + n)
+ * instead of the O(n log n) of @n pushes. Returns 0 or -1 on allocation
+ * failure, nothing is queued then.
+ */
+int dheap_heapify(dheap_t *h, struct dheap_node **nodes, size_t n) {
+  if (n > SIZE_MAX - h->size || dheap_reserve(h, h->size + n)) return -1;
+  for (size_t i = 0; i < n; i++)
+    h->slots[h->size + i] = (struct dheap_slot){nodes[i]->key, nodes[i]};
+  h->size += n;
+  if (h->size < 2) {
+    if (h->size) h->slots[0].node->idx = 0;
+    return 0;
+  }
+  for (size_t i = (h->size - 2) / DHEAP_ARITY + 1; i-- > 0;)
+    dheap_sift_down(h, i);
+  // leaves were never sifted
+  for (size_t i = (h->size - 2) / DHEAP_ARITY + 1; i < h->size; i++)
+    h->slots[i].node->idx = i;
+  return 0;
+}
+
+// link two roots, the one with the larger key becomes the first child of the other
+static struct pheap_node *pheap_meld(struct pheap_node *a, struct pheap_node *b) {
+  if (b->key < a->key) {
+    struct pheap_node *t = a;
+    a = b;
+    b = t;
+  }
+  b->prev = a;
+  b->next = a->child;
+  if (a->child) a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/*
+ * Two-pass pairing of a sibling list: meld pairs left to right, then
+ * meld the results right to left. Returns the new root.
+ */
+static struct pheap_node *pheap_merge_pairs(struct pheap_node *first) {
+  struct pheap_node *pairs = NULL; // melded pairs, last one first, linked through next
+
+  while (first) {
+    struct pheap_node *a = first, *b = a->next;
+    if (b) {
+      first = b->next;
+      a = pheap_meld(a, b);
+    } else {
+      first = NULL;
+    }
+    a->next = pairs;
+    pairs = a;
+  }
+  if (!pairs) return NULL;
+
+  struct pheap_node *root = pairs;
+  pairs = pairs->next;
+  while (pairs) {
+    struct pheap_node *next = pairs->next;
+    root = pheap_meld(root, pairs);
+    pairs = next;
+  }
+  root->next = root->prev = NULL;
+  return root;
+}
+
+// unlink a non-root node and its subtree from its parent
+static void pheap_cut(struct pheap_node *node) {
+  if (node->prev->child == node)
+    node->prev->child = node->next;
+  else
+    node->prev->next = node->next;
+  if (node->next) node->next->prev = node->prev;
+  node->next = node->prev = NULL;
+}
+
+void pheap_push(pheap_t *h, struct pheap_node *node, uint64_t key) {
+  node->key = key;
+  node->child = node->next = node->prev = NULL;
+  h->root = h->root ? pheap_meld(h->root, node) : node;
+  h->root->prev = NULL;
+  h->size++;
+}
+
+// remove and return the node with the smallest key, NULL if the heap is empty
+struct pheap_node *pheap_pop(pheap_t *h) {
+  struct pheap_node *root = h->root;
+  if (!root) return NULL;
+  h->root = pheap_merge_pairs(root->child);
+  root->child = NULL;
+  h->size--;
+  return root;
+}
+
+/**
+ * pheap_update - change the key of a queued node
+ * @h: heap
+ * @node: queued node
+ * @key: new key
+ *
+ * A smaller key cuts the node's subtree and melds it with the root in
+ * O(1). A larger key can break the order below the node, so the node is
+ * removed and pushed again.
+ */
+void pheap_update(pheap_t *h, struct pheap_node *node, uint64_t key) {
+  if (key > node->key) {
+    pheap_del(h, node);
+    pheap_push(h, node, key);
+    return;
+  }
+  node->key = key;
+  if (node == h->root) return;
+  pheap_cut(node);
+  h->root = pheap_meld(h->root, node);
+  h->root->prev = NULL;
+}
+
+// remove a queued node from anywhere in the heap
+void pheap_del(pheap_t *h, struct pheap_node *node) {
+  if (node == h->root) {
+    pheap_pop(h);
+    return;
+  }
+  pheap_cut(node);
+  struct pheap_node *sub = pheap_merge_pairs(node->child);
+  node->child = NULL;
+  if (sub) {
+    h->root = pheap_meld(h->root, sub);
+    h->root->prev = NULL;
+  }
+  h->size--;
+}
+
+/**
+ * pheap_heapify - queue @n nodes at once
+ * @h: heap
+ * @nodes: nodes to queue with their key already set, none may be queued
+ * @n: number of them
+ *
+ * The nodes are linked into one sibling list and paired in n - 1 melds.
+ */
+void pheap_heapify(pheap_t *h, struct pheap_node **nodes, size_t n) {
+  if (!n) return;
+  for (size_t i = 0; i < n; i++) {
+    nodes[i]->child = nodes[i]->prev = NULL;
+    nodes[i]->next = i + 1 < n ? nodes[i + 1] : NULL;
+  }
+  struct pheap_node *sub = pheap_merge_pairs(nodes[0]);
+  h->root = h->root ? pheap_meld(h->root, sub) : sub;
+  h->root->prev = NULL;
+  h->size += n;
+}
@@ -0,0 +1,102 @@
+/*
+ * Min-priority queues keyed by 64-bit values, e.g. expiry times
+ *
+ * dheap_t is a 4-ary array heap. The array holds the keys next to the
+ * node pointers, so sifting compares without touching the nodes, and it
+ * is offset so that the four children of a slot share one cache line:
+ * every level of a sift-down touches one line, and there are half as
+ * many levels as in a binary heap. Every queued node stores its array
+ * index, which makes update (decrease or increase key) and removal of
+ * any node O(log n) without a search.
+ *
+ * pheap_t is an intrusive pairing heap: nothing is allocated and nodes
+ * never move. Push and decrease-key are O(1) (decrease-key cuts the
+ * subtree and melds it with the root), pop is O(log n) amortized.
+ *
+ * Both build from an array of nodes in O(n) with *_heapify().
+ */
+
+#ifndef __HEAP_H__
+#define __HEAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DHEAP_ARITY 4
+#define DHEAP_MIN_CAPACITY 16
+#define DHEAP_NONE SIZE_MAX // index of a node that is not queued
+
+// embedded in queued objects
+struct dheap_node {
+  uint64_t key;
+  size_t idx; // slot in the heap array, DHEAP_NONE if not queued
+};
+
+struct dheap_slot {
+  uint64_t key; // copy of node->key, compared without dereferencing node
+  struct dheap_node *node;
+};
+
+typedef struct dheap {
+  struct dheap_slot *slots; // slots[1..4] start a cache line, as do the children of every slot
+  void *mem;                // allocation holding 'slots'
+  size_t size;
+  size_t capacity;
+} dheap_t;
+
+dheap_t *dheap_create(size_t capacity);
+void dheap_free(dheap_t *h);
+int dheap_reserve(dheap_t *h, size_t capacity);
+
+int dheap_push(dheap_t *h, struct dheap_node *node, uint64_t key);
+struct dheap_node *dheap_pop(dheap_t *h);
+void dheap_update(dheap_t *h, struct dheap_node *node, uint64_t key);
+void dheap_del(dheap_t *h, struct dheap_node *node);
+int dheap_heapify(dheap_t *h, struct dheap_node **nodes, size_t n);
+
+static inline void dheap_node_init(struct dheap_node *node) {
+  node->idx = DHEAP_NONE;
+}
+
+static inline int dheap_queued(const struct dheap_node *node) {
+  return node->idx != DHEAP_NONE;
+}
+
+// node with the smallest key or NULL
+static inline struct dheap_node *dheap_peek(const dheap_t *h) {
+  return h->size ? h->slots[0].node : NULL;
+}
+
+/*
+ * Pairing heap node: 'child' is the first child, siblings are linked
+ * through 'next' and 'prev' points to the left sibling or, for a first
+ * child, to the parent. The root has no prev.
+ */
+struct pheap_node {
+  struct pheap_node *child;
+  struct pheap_node *next;
+  struct pheap_node *prev;
+  uint64_t key;
+};
+
+typedef struct pheap {
+  struct pheap_node *root;
+  size_t size;
+} pheap_t;
+
+static inline void pheap_init(pheap_t *h) {
+  h->root = NULL;
+  h->size = 0;
+}
+
+static inline struct pheap_node *pheap_peek(const pheap_t *h) {
+  return h->root;
+}
+
+void pheap_push(pheap_t *h, struct pheap_node *node, uint64_t key);
+struct pheap_node *pheap_pop(pheap_t *h);
+void pheap_update(pheap_t *h, struct pheap_node *node, uint64_t key);
+void pheap_del(pheap_t *h, struct pheap_node *node);
+void pheap_heapify(pheap_t *h, struct pheap_node **nodes, size_t n);
+
+#endif
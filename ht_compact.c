@@ -0,0 +1,292 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "ht_compact.h"
+#include "ht_mem.h"
+#include "mock_mem_functions.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+#define CHT_MAGIC 0x31544843 // "CHT1"
+#define CHT_MIN_CAPACITY 16
+// largest element whose node size, header included and rounded up to 8 bytes, still fits a u32
+#define CHT_MAX_ELEM_SIZE ((UINT32_MAX & ~7U) - (u32)sizeof(struct cht_node))
+
+struct cht_file_hdr {
+  u32 magic;
+  u32 bits;
+  u32 elem_size;
+  u32 used;
+  u32 free_list;
+  u32 count;
+};
+
+static u32 cht_node_size(u32 elem_size) {
+  return (sizeof(struct cht_node) + elem_size + 7) & ~7U;
+}
+
+static size_t cht_table_bytes(const cht_t *t) {
+  return ((size_t)1 << t->bits) * sizeof(u32);
+}
+
+static cht_t *cht_alloc(u32 bits, u32 elem_size, u32 capacity, u32 flags) {
+  // bucket heads and pool indices are 32-bit, CHT_NIL is reserved
+  if (bits >= 32 || capacity >= CHT_NIL || elem_size > CHT_MAX_ELEM_SIZE) return NULL;
+  if (capacity == 0) capacity = CHT_MIN_CAPACITY;
+
+  cht_t *t = malloc(sizeof(cht_t));
+  if (!t) return NULL;
+
+  t->bits = bits;
+  t->elem_size = elem_size;
+  t->node_size = cht_node_size(elem_size);
+  t->capacity = capacity;
+  t->used = 0;
+  t->free_list = CHT_NIL;
+  t->count = 0;
+  t->flags = flags & HT_CREATE_MASK;
+
+  t->table = ht_mem_zalloc(cht_table_bytes(t), HT_MEM_OPTS(t->flags), &t->table_mem);
+  if (!t->table) {
+    free(t);
+    return NULL;
+  }
+  t->pool = ht_mem_zalloc((size_t)capacity * t->node_size, HT_MEM_OPTS(t->flags), &t->pool_mem);
+  if (!t->pool) {
+    ht_mem_free(t->table, cht_table_bytes(t), t->table_mem);
+    free(t);
+    return NULL;
+  }
+  return t;
+}
+
+cht_t *cht_create(u32 bits, u32 elem_size, u32 capacity) {
+  return cht_create_ex(bits, elem_size, capacity, 0);
+}
+
+// same as cht_create() with HT_HUGETLB/HT_THP/HT_INTERLEAVE/HT_NODE() backing for the bucket array and the pool
+cht_t *cht_create_ex(u32 bits, u32 elem_size, u32 capacity, u32 flags) {
+  cht_t *t = cht_alloc(bits, elem_size, capacity, flags);
+  if (!t) return NULL;
+
+  // all bits set is CHT_NIL in every bucket
+  memset(t->table, 0xff, cht_table_bytes(t));
+  return t;
+}
+
+void cht_free(cht_t *t) {
+  if (!t) return;
+  ht_mem_free(t->pool, (size_t)t->capacity * t->node_size, t->pool_mem);
+  ht_mem_free(t->table, cht_table_bytes(t), t->table_mem);
+  free(t);
+}
+
+static int cht_grow(cht_t *t) {
+  u32 cap = t->capacity < (CHT_NIL - 1) / 2 ? t->capacity * 2 : CHT_NIL - 1;
+  if (cap <= t->capacity) return -1;
+
+  u8 *pool = ht_mem_realloc(t->pool, (size_t)t->capacity * t->node_size, (size_t)cap * t->node_size,
+                            HT_MEM_OPTS(t->flags), &t->pool_mem);
+  if (!pool) return -1;
+
+  // nodes are linked by index, so moving the pool needs no fixups
+  t->pool = pool;
+  t->capacity = cap;
+  return 0;
+}
+
+/**
+ * cht_add - allocate a node and link it into the bucket of @hash
+ * @t: compact hash table
+ * @hash: hash of the new element
+ *
+ * Returns the pool index of the new node or CHT_NIL if the pool could not
+ * be grown. The element itself is left uninitialized, fill it through
+ * cht_elem(t, idx).
+ */
+u32 cht_add(cht_t *t, u32 hash) {
+  u32 idx;
+
+  if (t->free_list != CHT_NIL) {
+    idx = t->free_list;
+    t->free_list = cht_node(t, idx)->next;
+  } else {
+    if (t->used == t->capacity && cht_grow(t)) return CHT_NIL;
+    idx = t->used++;
+  }
+
+  u32 *head = &t->table[calc_bkt(hash, (size_t)1 << t->bits)];
+  struct cht_node *n = cht_node(t, idx);
+  n->hash = hash;
+  n->next = *head;
+  *head = idx;
+  t->count++;
+  return idx;
+}
+
+/**
+ * cht_del - unlink a node and return its slot to the pool
+ * @t: compact hash table
+ * @idx: pool index returned by cht_add() or found by cht_for_each_possible()
+ *
+ * Returns 0 on success or 1 if @idx is not linked in its bucket.
+ */
+int cht_del(cht_t *t, u32 idx) {
+  if (idx >= t->used) return 1;
+
+  u32 *link = &t->table[calc_bkt(cht_node(t, idx)->hash, (size_t)1 << t->bits)];
+  while (*link != CHT_NIL && *link != idx)
+    link = &cht_node(t, *link)->next;
+  if (*link == CHT_NIL) return 1;
+
+  struct cht_node *n = cht_node(t, idx);
+  *link = n->next;
+  n->next = t->free_list;
+  t->free_list = idx;
+  t->count--;
+  return 0;
+}
+
+/**
+ * cht_compact - pack all live nodes at the start of a right-sized pool
+ * @t: compact hash table
+ *
+ * Nodes are laid out bucket by bucket, so every chain becomes contiguous
+ * in memory and the free list is dropped. All indices previously returned
+ * by cht_add() are invalidated.
+ *
+ * Returns 0 on success or -1 if the new pool could not be allocated, in
+ * which case the table is left untouched.
+ */
+int cht_compact(cht_t *t) {
+  u32 cap = t->count ? t->count : 1;
+  u32 pool_mem;
+  u8 *pool = ht_mem_zalloc((size_t)cap * t->node_size, HT_MEM_OPTS(t->flags), &pool_mem);
+  if (!pool) return -1;
+
+  size_t nbkt = (size_t)1 << t->bits;
+  u32 next = 0;
+  for (size_t bkt = 0; bkt < nbkt; bkt++) {
+    u32 *link = &t->table[bkt];
+    u32 idx = *link;
+    while (idx != CHT_NIL) {
+      struct cht_node *dst = (struct cht_node *)(pool + (size_t)next * t->node_size);
+      memcpy(dst, cht_node(t, idx), t->node_size);
+      idx = dst->next;
+      *link = next;
+      link = &dst->next;
+      next++;
+    }
+  }
+
+  ht_mem_free(t->pool, (size_t)t->capacity * t->node_size, t->pool_mem);
+  t->pool = pool;
+  t->pool_mem = pool_mem;
+  t->capacity = cap;
+  t->used = t->count;
+  t->free_list = CHT_NIL;
+  return 0;
+}
+
+/**
+ * cht_save - write a table to a stream
+ * @t: compact hash table
+ * @f: stream opened for writing
+ *
+ * The image is the bucket array followed by the used part of the pool in
+ * host byte order, it can only be loaded back on a host with the same
+ * endianness. Returns 0 on success or -1 on a write error.
+ */
+int cht_save(const cht_t *t, FILE *f) {
+  struct cht_file_hdr hdr = {
+      .magic = CHT_MAGIC,
+      .bits = t->bits,
+      .elem_size = t->elem_size,
+      .used = t->used,
+      .free_list = t->free_list,
+      .count = t->count,
+  };
+  size_t nbkt = (size_t)1 << t->bits;
+
+  if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) return -1;
+  if (fwrite(t->table, sizeof(u32), nbkt, f) != nbkt) return -1;
+  if (t->used && fwrite(t->pool, t->node_size, t->used, f) != t->used) return -1;
+  return 0;
+}
+
+/*
+ * Check the links of a loaded image before any of them is followed: every
+ * bucket head and chain link must be a used slot or CHT_NIL, every node
+ * must sit in the bucket of its hash, chains and free list must not share
+ * or revisit a slot and together they must cover exactly 'used' slots.
+ */
+static int cht_check(const cht_t *t) {
+  size_t nbkt = (size_t)1 << t->bits;
+  size_t seen_bytes = t->used / 8 + 1;
+  u8 *seen = malloc(seen_bytes);
+  if (!seen) return -1;
+  memset(seen, 0, seen_bytes);
+
+  int ret = -1;
+  u32 linked = 0, free_nodes = 0;
+  for (size_t bkt = 0; bkt < nbkt; bkt++) {
+    for (u32 idx = t->table[bkt]; idx != CHT_NIL; idx = cht_node(t, idx)->next) {
+      if (idx >= t->used || (seen[idx / 8] & (1U << (idx % 8)))) goto out;
+      if (calc_bkt(cht_node(t, idx)->hash, nbkt) != bkt) goto out;
+      seen[idx / 8] |= 1U << (idx % 8);
+      linked++;
+    }
+  }
+  for (u32 idx = t->free_list; idx != CHT_NIL; idx = cht_node(t, idx)->next) {
+    if (idx >= t->used || (seen[idx / 8] & (1U << (idx % 8)))) goto out;
+    seen[idx / 8] |= 1U << (idx % 8);
+    free_nodes++;
+  }
+  if (linked == t->count && (u64)t->count + free_nodes == t->used) ret = 0;
+out:
+  free(seen);
+  return ret;
+}
+
+/**
+ * cht_load - read a table written by cht_save()
+ * @f: stream opened for reading
+ *
+ * The image is validated before it is returned, a truncated or corrupt
+ * file never yields links pointing outside the pool.
+ *
+ * Returns the new table or NULL on a read error, a bad header, an
+ * inconsistent image or a memory allocation failure.
+ */
+cht_t *cht_load(FILE *f) {
+  struct cht_file_hdr hdr;
+
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != CHT_MAGIC) return NULL;
+  // a wrapped node size would give a pool too small for the slots it claims
+  if (hdr.elem_size > CHT_MAX_ELEM_SIZE) return NULL;
+
+  cht_t *t = cht_alloc(hdr.bits, hdr.elem_size, hdr.used, 0);
+  if (!t) return NULL;
+
+  size_t nbkt = (size_t)1 << t->bits;
+  if (fread(t->table, sizeof(u32), nbkt, f) != nbkt ||
+      (hdr.used && fread(t->pool, t->node_size, hdr.used, f) != hdr.used)) {
+    cht_free(t);
+    return NULL;
+  }
+
+  t->used = hdr.used;
+  t->free_list = hdr.free_list;
+  t->count = hdr.count;
+  if (cht_check(t)) {
+    cht_free(t);
+    return NULL;
+  }
+  return t;
+}
@@ -0,0 +1,116 @@
+/*
+ * Compact hash table with 32-bit index links
+ *
+ * Nodes live in one contiguous pool and are linked by 32-bit pool indices
+ * instead of pointers, so a link costs 4 bytes instead of 16 (hlist_node)
+ * and a bucket head 4 bytes instead of 8 (hlist_head). Because no node
+ * stores an address, the pool can be grown with realloc, compacted and
+ * written to / read from a file as is.
+ */
+
+#ifndef __HT_COMPACT_H__
+#define __HT_COMPACT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hashtable.h"
+
+#define CHT_NIL UINT32_MAX // "NULL" link
+
+/**
+ * struct cht_node - link header in front of every pooled element
+ * @next: pool index of the next node in the bucket chain or CHT_NIL
+ * @hash: full 32-bit hash of the element, used to find its bucket on
+ *        delete and to skip most key compares on lookup
+ */
+struct cht_node {
+  u32 next;
+  u32 hash;
+};
+
+/**
+ * struct compact_hashtable - index linked hash table
+ * @table: array of 1 << bits bucket heads, each a pool index or CHT_NIL
+ * @bits: number of bits determining the number of buckets
+ * @pool: node storage, capacity * node_size bytes
+ * @node_size: sizeof(struct cht_node) + elem_size rounded up to 8 bytes
+ * @elem_size: size of the user element stored after each node header
+ * @capacity: number of node slots allocated in @pool
+ * @used: high-water mark of pool slots handed out
+ * @free_list: chain of released slots linked through cht_node.next
+ * @count: number of elements in the table
+ * @flags: HT_* memory options given to cht_create_ex()
+ * @table_mem: HT_MEM_* backing obtained for @table
+ * @pool_mem: HT_MEM_* backing obtained for @pool
+ *
+ * Element pointers returned by cht_elem() are only valid until the next
+ * cht_add() (the pool may be moved by realloc) or cht_compact() (elements
+ * are renumbered). Keep indices, not pointers, across those calls.
+ */
+typedef struct compact_hashtable {
+  u32 *table;
+  u32 bits;
+  u8 *pool;
+  u32 node_size;
+  u32 elem_size;
+  u32 capacity;
+  u32 used;
+  u32 free_list;
+  u32 count;
+  u32 flags;
+  u32 table_mem;
+  u32 pool_mem;
+} cht_t;
+
+cht_t *cht_create(u32 bits, u32 elem_size, u32 capacity);
+cht_t *cht_create_ex(u32 bits, u32 elem_size, u32 capacity, u32 flags);
+void cht_free(cht_t *t);
+
+u32 cht_add(cht_t *t, u32 hash);
+int cht_del(cht_t *t, u32 idx);
+int cht_compact(cht_t *t);
+
+int cht_save(const cht_t *t, FILE *f);
+cht_t *cht_load(FILE *f);
+
+static inline struct cht_node *cht_node(const cht_t *t, u32 idx) {
+  return (struct cht_node *)(t->pool + (size_t)idx * t->node_size);
+}
+
+static inline void *cht_elem(const cht_t *t, u32 idx) {
+  return cht_node(t, idx) + 1;
+}
+
+/**
+ * cht_for_each_possible - iterate over all nodes hashing to the same bucket
+ * @t: compact hash table
+ * @idx: u32 to use as a loop cursor, holds a pool index
+ * @key: the hash of the elements to iterate over
+ *
+ * Usage Example:
+ *
+ * u32 idx;
+ * cht_for_each_possible(t, idx, hash) {
+ *   struct my_data *d = cht_elem(t, idx);
+ *   if (cht_node(t, idx)->hash == hash && d->id == id)
+ *     return d;
+ * }
+ */
+#define cht_for_each_possible(t, idx, key)                                      \
+  for (idx = (t)->table[calc_bkt(key, (size_t)1 << (t)->bits)]; idx != CHT_NIL; \
+       idx = cht_node(t, idx)->next)
+
+/**
+ * cht_for_each - iterate over all nodes in a compact hash table
+ * @t: compact hash table
+ * @bkt: u32 to use as bucket loop cursor
+ * @idx: u32 to use as a loop cursor, holds a pool index
+ *
+ * Not safe against cht_del() of the current node.
+ */
+#define cht_for_each(t, bkt, idx)                                    \
+  for ((bkt) = 0; (bkt) < ((size_t)1 << (t)->bits); (bkt)++)        \
+    for (idx = (t)->table[bkt]; idx != CHT_NIL; idx = cht_node(t, idx)->next)
+
+#endif
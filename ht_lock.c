@@ -0,0 +1,58 @@
+#include <stdlib.h>
+
+#include "ht_lock.h"
+#include "log2.h"
+
+int ht_lock_init(struct ht_lock *l, uint32_t type) {
+  if (type == HT_LOCK_RW) return pthread_rwlock_init(&l->rw, NULL) ? -1 : 0;
+  l->seq.spin.locked = 0;
+  l->seq.seq = 0;
+  return 0;
+}
+
+void ht_lock_destroy(struct ht_lock *l, uint32_t type) {
+  if (type == HT_LOCK_RW) pthread_rwlock_destroy(&l->rw);
+}
+
+/**
+ * ht_stripes_init - allocate and initialize lock stripes
+ * @s: stripes to initialize
+ * @count: number of stripes, rounded up to a power of two, 0 for HT_STRIPES_DEFAULT
+ * @type: HT_LOCK_SPIN, HT_LOCK_RW or HT_LOCK_SEQ
+ *
+ * More stripes than buckets only waste memory; a few times the number of
+ * CPUs is enough to make collisions between unrelated keys rare.
+ * Returns 0 on success or -1 on failure.
+ */
+int ht_stripes_init(ht_stripes_t *s, uint32_t count, uint32_t type) {
+  if (type != HT_LOCK_SPIN && type != HT_LOCK_RW && type != HT_LOCK_SEQ) return -1;
+  if (count == 0) count = HT_STRIPES_DEFAULT;
+  if (count > (1U << 31)) return -1;
+  if (count & (count - 1)) count = 1U << (ilog2(count) + 1);
+
+  // stripes must start on a cache line boundary for the padding to work
+  void *locks;
+  if (posix_memalign(&locks, HT_CACHELINE_SIZE, (size_t)count * sizeof(struct ht_lock))) return -1;
+  s->locks = locks;
+  s->mask = count - 1;
+  s->type = type;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (ht_lock_init(&s->locks[i], type)) {
+      while (i--)
+        ht_lock_destroy(&s->locks[i], type);
+      free(locks);
+      s->locks = NULL;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void ht_stripes_destroy(ht_stripes_t *s) {
+  if (!s->locks) return;
+  for (uint32_t i = 0; i <= s->mask; i++)
+    ht_lock_destroy(&s->locks[i], s->type);
+  free(s->locks);
+  s->locks = NULL;
+}
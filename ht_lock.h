@@ -0,0 +1,171 @@
+/*
+ * Cache-line padded locks and lock stripes for concurrent hash tables
+ *
+ * A stripe array holds a power-of-two number of locks, bucket 'bkt' is
+ * protected by stripe bkt & mask. Every lock sits on its own cache line so
+ * CPUs working on different stripes never bounce a shared line.
+ */
+
+#ifndef __HT_LOCK_H__
+#define __HT_LOCK_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compiler.h"
+
+#define HT_CACHELINE_SIZE 64
+#define HT_STRIPES_DEFAULT 64
+
+// lock types
+#define HT_LOCK_SPIN 0 // test-and-test-and-set spinlock, readers are exclusive too
+#define HT_LOCK_RW 1   // pthread rwlock, readers share the stripe
+#define HT_LOCK_SEQ 2  // spinlock plus sequence counter, readers take no lock and retry instead
+
+typedef struct ht_spinlock {
+  int locked;
+} ht_spinlock_t;
+
+#define HT_SPINLOCK_INIT {0}
+
+static inline void ht_spin_lock(ht_spinlock_t *l) {
+  while (__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE)) {
+    // wait on a shared copy of the line instead of hammering it with writes
+    while (__atomic_load_n(&l->locked, __ATOMIC_RELAXED))
+      cpu_relax();
+  }
+}
+
+static inline int ht_spin_trylock(ht_spinlock_t *l) {
+  return !__atomic_load_n(&l->locked, __ATOMIC_RELAXED) && !__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void ht_spin_unlock(ht_spinlock_t *l) {
+  __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+// seqlock: the count is odd while a writer holds 'spin'
+struct ht_seqlock {
+  ht_spinlock_t spin;
+  uint32_t seq;
+};
+
+// one lock of any type, alone on its cache line
+struct ht_lock {
+  union {
+    ht_spinlock_t spin;
+    pthread_rwlock_t rw;
+    struct ht_seqlock seq;
+  };
+} __attribute__((aligned(HT_CACHELINE_SIZE)));
+
+typedef struct ht_stripes {
+  struct ht_lock *locks; // 'mask + 1' padded locks
+  uint32_t mask;         // stripe count - 1
+  uint32_t type;         // HT_LOCK_SPIN, HT_LOCK_RW or HT_LOCK_SEQ
+} ht_stripes_t;
+
+int ht_lock_init(struct ht_lock *l, uint32_t type);
+void ht_lock_destroy(struct ht_lock *l, uint32_t type);
+
+int ht_stripes_init(ht_stripes_t *s, uint32_t count, uint32_t type);
+void ht_stripes_destroy(ht_stripes_t *s);
+
+static inline void ht_lock_write(struct ht_lock *l, uint32_t type) {
+  if (type == HT_LOCK_RW) {
+    pthread_rwlock_wrlock(&l->rw);
+  } else {
+    ht_spin_lock(&l->spin);
+    if (type == HT_LOCK_SEQ) {
+      // odd count first, then the changes
+      __atomic_store_n(&l->seq.seq, l->seq.seq + 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+  }
+}
+
+static inline void ht_unlock(struct ht_lock *l, uint32_t type) {
+  if (type == HT_LOCK_RW) {
+    pthread_rwlock_unlock(&l->rw);
+  } else {
+    if (type == HT_LOCK_SEQ) smp_store_release(&l->seq.seq, l->seq.seq + 1);
+    ht_spin_unlock(&l->spin);
+  }
+}
+
+// locked read, only HT_LOCK_RW lets readers share the lock
+static inline void ht_lock_read(struct ht_lock *l, uint32_t type) {
+  if (type == HT_LOCK_RW)
+    pthread_rwlock_rdlock(&l->rw);
+  else
+    ht_lock_write(l, type);
+}
+
+/*
+ * Optimistic readers of HT_LOCK_SEQ locks: sample the count, read, and
+ * retry if it changed. Data read in between may be torn and pointers may
+ * lead into freed objects, so the protected objects must be type-stable
+ * (never unmapped, e.g. from a mempool_t) and nothing read may be trusted
+ * before ht_seq_read_retry() returned false.
+ */
+static inline uint32_t ht_seq_read_begin(struct ht_lock *l) {
+  uint32_t seq;
+  while ((seq = smp_load_acquire(&l->seq.seq)) & 1)
+    cpu_relax();
+  return seq;
+}
+
+static inline bool ht_seq_read_retry(struct ht_lock *l, uint32_t seq) {
+  // the reads of the section must complete before the count is checked again
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&l->seq.seq, __ATOMIC_RELAXED) != seq;
+}
+
+// the stripe protecting bucket 'bkt'
+static inline struct ht_lock *ht_stripe(const ht_stripes_t *s, size_t bkt) {
+  return &s->locks[bkt & s->mask];
+}
+
+static inline void ht_stripe_read_lock(const ht_stripes_t *s, size_t bkt) {
+  ht_lock_read(ht_stripe(s, bkt), s->type);
+}
+
+static inline void ht_stripe_write_lock(const ht_stripes_t *s, size_t bkt) {
+  ht_lock_write(ht_stripe(s, bkt), s->type);
+}
+
+static inline void ht_stripe_unlock(const ht_stripes_t *s, size_t bkt) {
+  ht_unlock(ht_stripe(s, bkt), s->type);
+}
+
+/**
+ * ht_stripe_read_begin - start an optimistic read of a bucket (HT_LOCK_SEQ stripes)
+ * @s: lock stripes
+ * @bkt: bucket index
+ *
+ * Usage Example:
+ *
+ * uint32_t seq;
+ * do {
+ *   found = 0;
+ *   seq = ht_stripe_read_begin(&stripes, bkt);
+ *   hash_for_each_possible_bits(table, bits, obj, node, key) {
+ *     if (obj->id == id) {
+ *       value = obj->value;
+ *       found = 1;
+ *       break;
+ *     }
+ *   }
+ * } while (ht_stripe_read_retry(&stripes, bkt, seq));
+ */
+static inline uint32_t ht_stripe_read_begin(const ht_stripes_t *s, size_t bkt) {
+  return ht_seq_read_begin(ht_stripe(s, bkt));
+}
+
+static inline bool ht_stripe_read_retry(const ht_stripes_t *s, size_t bkt, uint32_t seq) {
+  return ht_seq_read_retry(ht_stripe(s, bkt), seq);
+}
+
+#endif
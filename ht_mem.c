@@ -0,0 +1,300 @@
+#define _GNU_SOURCE // sched_getcpu()
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "ht_mem.h"
+#include "mock_mem_functions.h"
+
+// redefine mem functions with custom version
+#define calloc custom_calloc
+#define realloc custom_realloc
+#define free custom_free
+
+// memory policies from <linux/mempolicy.h>, called through syscall() so libnuma is not required
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+#define HT_MEM_NODEMASK_LONGS ((HT_MEM_MAX_NODES + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)))
+#define HT_MEM_MAX_CPUS 4096 // CPUs covered by the cpu -> node map, others ask the kernel
+#define HT_MEM_CPUMASK_LONGS ((HT_MEM_MAX_CPUS + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)))
+
+static size_t ht_mem_huge_round(size_t size) {
+  return (size + HT_MEM_HUGE_PAGE_SIZE - 1) & ~(HT_MEM_HUGE_PAGE_SIZE - 1);
+}
+
+static void *ht_mem_map(size_t size, int flags) {
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+// map 'size' bytes (a multiple of the huge page size) at a huge page aligned address
+static void *ht_mem_map_aligned(size_t size) {
+  uint8_t *raw = ht_mem_map(size + HT_MEM_HUGE_PAGE_SIZE, 0);
+  if (!raw) return NULL;
+
+  uint8_t *ptr = (uint8_t *)(((uintptr_t)raw + HT_MEM_HUGE_PAGE_SIZE - 1) & ~(HT_MEM_HUGE_PAGE_SIZE - 1));
+  size_t head = ptr - raw;
+  if (head) munmap(raw, head);
+  if (HT_MEM_HUGE_PAGE_SIZE - head) munmap(ptr + size, HT_MEM_HUGE_PAGE_SIZE - head);
+  return ptr;
+}
+
+static void *ht_mem_zalloc_huge(size_t size, uint32_t opts, uint32_t *backing) {
+  size_t len = ht_mem_huge_round(size);
+  void *ptr;
+
+#ifdef MAP_HUGETLB
+  if (opts & HT_MEM_OPT_HUGETLB) {
+    // fails unless huge pages are reserved (vm.nr_hugepages) or can be allocated
+    ptr = ht_mem_map(len, MAP_HUGETLB);
+    if (ptr) {
+      *backing = HT_MEM_MMAP | HT_MEM_HUGETLB;
+      return ptr;
+    }
+  }
+#endif
+
+#ifdef MADV_HUGEPAGE
+  // HT_MEM_OPT_HUGETLB falls back to THP
+  ptr = ht_mem_map_aligned(len);
+  if (!ptr) return NULL;
+  if (madvise(ptr, len, MADV_HUGEPAGE) == 0) {
+    *backing = HT_MEM_MMAP | HT_MEM_THP;
+    return ptr;
+  }
+  // THP is not available, give the rounded mapping back and use plain pages
+  munmap(ptr, len);
+#endif
+  (void)opts;
+  (void)len;
+  return NULL;
+}
+
+/*
+ * parse a sysfs list like "0-1,4" into a bitmask of 'max_bits' bits,
+ * returns the highest number found or -1
+ */
+static int ht_sysfs_list(const char *path, unsigned long *mask, long max_bits) {
+  char buf[1024];
+  int max = -1;
+
+  FILE *f = fopen(path, "r");
+  if (!f) return -1;
+  if (!fgets(buf, sizeof(buf), f)) buf[0] = '\0';
+  fclose(f);
+
+  char *p = buf;
+  while (*p >= '0' && *p <= '9') {
+    long first = strtol(p, &p, 10), last = first;
+    if (*p == '-') last = strtol(p + 1, &p, 10);
+    for (long n = first; n <= last && n < max_bits; n++) {
+      mask[n / (8 * sizeof(unsigned long))] |= 1UL << (n % (8 * sizeof(unsigned long)));
+      if (n > max) max = n;
+    }
+    if (*p == ',') p++;
+  }
+  return max;
+}
+
+static int ht_numa_online_mask(unsigned long *mask) {
+  return ht_sysfs_list("/sys/devices/system/node/online", mask, HT_MEM_MAX_NODES);
+}
+
+// number of NUMA nodes (highest online node + 1), 1 if the topology is unknown
+int ht_numa_nodes(void) {
+  unsigned long mask[HT_MEM_NODEMASK_LONGS] = {0};
+  int max = ht_numa_online_mask(mask);
+  return max < 0 ? 1 : max + 1;
+}
+
+// node of every CPU, -1 where unknown; built once from sysfs
+static int16_t ht_cpu_node[HT_MEM_MAX_CPUS];
+static pthread_once_t ht_cpu_node_once = PTHREAD_ONCE_INIT;
+
+static void ht_numa_map_cpus(void) {
+  unsigned long nodes[HT_MEM_NODEMASK_LONGS] = {0};
+  char path[64];
+
+  memset(ht_cpu_node, 0xff, sizeof(ht_cpu_node));
+  int max = ht_numa_online_mask(nodes);
+  for (int n = 0; n <= max; n++) {
+    if (!(nodes[n / (8 * sizeof(unsigned long))] & (1UL << (n % (8 * sizeof(unsigned long)))))) continue;
+    unsigned long cpus[HT_MEM_CPUMASK_LONGS] = {0};
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+    int last = ht_sysfs_list(path, cpus, HT_MEM_MAX_CPUS);
+    for (int c = 0; c <= last; c++) {
+      if (cpus[c / (8 * sizeof(unsigned long))] & (1UL << (c % (8 * sizeof(unsigned long))))) ht_cpu_node[c] = n;
+    }
+  }
+}
+
+/*
+ * NUMA node of the CPU the caller runs on, 0 if it cannot be determined.
+ * Cheap enough for every lookup: sched_getcpu() is served by the vDSO and
+ * the node comes from a map read once, the getcpu system call is only
+ * made for CPUs missing from the map.
+ */
+int ht_numa_current_node(void) {
+  pthread_once(&ht_cpu_node_once, ht_numa_map_cpus);
+  int cpu = sched_getcpu();
+  if (cpu >= 0 && cpu < HT_MEM_MAX_CPUS && ht_cpu_node[cpu] >= 0) return ht_cpu_node[cpu];
+#ifdef SYS_getcpu
+  unsigned ucpu, node;
+  if (syscall(SYS_getcpu, &ucpu, &node, NULL) == 0) return (int)node;
+#endif
+  return 0;
+}
+
+// apply the NUMA part of 'opts' to a mapping, returns the HT_MEM_* placement flag or 0
+static uint32_t ht_mem_set_policy(void *ptr, size_t size, uint32_t opts) {
+#ifdef SYS_mbind
+  unsigned long mask[HT_MEM_NODEMASK_LONGS] = {0};
+  int mode;
+  uint32_t placed;
+
+  if (opts & HT_MEM_OPT_INTERLEAVE) {
+    if (ht_numa_online_mask(mask) < 0) return 0;
+    mode = MPOL_INTERLEAVE;
+    placed = HT_MEM_INTERLEAVE;
+  } else {
+    unsigned node = ((opts & HT_MEM_OPT_NODE_MASK) >> 8) - 1;
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    mode = MPOL_PREFERRED;
+    placed = HT_MEM_NODE;
+  }
+
+  // pages are not faulted in yet, so the policy decides where each one lands
+  if (syscall(SYS_mbind, ptr, size, mode, mask, HT_MEM_MAX_NODES + 1, 0) == 0) return placed;
+#endif
+  (void)ptr;
+  (void)size;
+  (void)opts;
+  return 0; // no NUMA support or policy refused, keep the default first-touch placement
+}
+
+// fault in every page of a fresh mapping now instead of on first access
+static uint32_t ht_mem_prefault(void *ptr, size_t size) {
+  // mlock() populates the whole range and keeps it resident
+  if (mlock(ptr, size) == 0) return HT_MEM_PREFAULTED | HT_MEM_LOCKED;
+
+  // over RLIMIT_MEMLOCK: still take the faults here, a write is needed since reads map the zero page
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  for (size_t off = 0; off < size; off += page)
+    ((volatile uint8_t *)ptr)[off] = 0;
+  return HT_MEM_PREFAULTED;
+}
+
+/**
+ * ht_mem_zalloc - allocate zero-filled memory
+ * @size: number of bytes
+ * @opts: HT_MEM_OPT_* huge page, NUMA and locking options, 0 for normal pages
+ * @backing: where to store the HT_MEM_* flags describing how @size bytes
+ *           were obtained, pass them back to ht_mem_free()
+ *
+ * Large requests are mapped instead of allocated, so callers must not
+ * write zeroes into the result themselves: that would fault in every page
+ * and defeat the lazy allocation. With huge page options the request is
+ * always mapped; if neither hugetlbfs nor THP can be used it silently
+ * falls back to normal pages, check @backing to see what was obtained.
+ * The same goes for NUMA options: the mapping is bound with mbind() and
+ * keeps the default placement if the kernel refuses the policy.
+ * HT_MEM_OPT_LOCK trades the lazy allocation for predictable latency: all
+ * pages are faulted in (after the NUMA policy is set, so they land on the
+ * right node) and locked if the memlock limit allows it.
+ *
+ * Returns a pointer to zeroed memory or NULL on failure.
+ */
+void *ht_mem_zalloc(size_t size, uint32_t opts, uint32_t *backing) {
+  void *ptr = NULL;
+
+  *backing = 0;
+  if (opts & HT_MEM_OPT_HUGE_MASK) {
+    ptr = ht_mem_zalloc_huge(size, opts, backing);
+  } else if (size < HT_MEM_MMAP_THRESHOLD && !(opts & (HT_MEM_OPT_NUMA_MASK | HT_MEM_OPT_LOCK))) {
+    return calloc(1, size);
+  }
+
+  if (!ptr) {
+    ptr = ht_mem_map(size, 0);
+    if (!ptr) return NULL;
+    *backing = HT_MEM_MMAP;
+  }
+
+  size_t len = *backing & (HT_MEM_HUGETLB | HT_MEM_THP) ? ht_mem_huge_round(size) : size;
+  if (opts & HT_MEM_OPT_NUMA_MASK) *backing |= ht_mem_set_policy(ptr, len, opts);
+  if (opts & HT_MEM_OPT_LOCK) *backing |= ht_mem_prefault(ptr, len);
+  return ptr;
+}
+
+/**
+ * ht_mem_realloc - resize memory returned by ht_mem_zalloc()
+ * @ptr: memory to resize
+ * @old_size: its current size
+ * @new_size: the requested size
+ * @opts: HT_MEM_OPT_* options for a new mapping
+ * @backing: backing flags of @ptr, updated to those of the result
+ *
+ * Heap memory stays on the heap and is resized with realloc, mappings are
+ * replaced by a new ht_mem_zalloc() and a copy. Bytes past @old_size are
+ * not initialized. On failure NULL is returned and @ptr is left intact.
+ */
+void *ht_mem_realloc(void *ptr, size_t old_size, size_t new_size, uint32_t opts, uint32_t *backing) {
+  if (!(*backing & HT_MEM_MMAP) && !(opts & (HT_MEM_OPT_HUGE_MASK | HT_MEM_OPT_NUMA_MASK | HT_MEM_OPT_LOCK)))
+    return realloc(ptr, new_size);
+
+  uint32_t new_backing;
+  void *new_ptr = ht_mem_zalloc(new_size, opts, &new_backing);
+  if (!new_ptr) return NULL;
+
+  memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+  ht_mem_free(ptr, old_size, *backing);
+  *backing = new_backing;
+  return new_ptr;
+}
+
+/**
+ * ht_mem_free - release memory returned by ht_mem_zalloc()
+ * @ptr: memory to release, may be NULL
+ * @size: the size passed to ht_mem_zalloc()
+ * @backing: the flags reported by ht_mem_zalloc()
+ *
+ * Locked pages are unlocked by munmap() itself.
+ */
+void ht_mem_free(void *ptr, size_t size, uint32_t backing) {
+  if (!ptr) return;
+  if (backing & HT_MEM_MMAP) {
+    if (backing & (HT_MEM_HUGETLB | HT_MEM_THP)) size = ht_mem_huge_round(size);
+    munmap(ptr, size);
+    return;
+  }
+  free(ptr);
+}
+
+// human readable name of the backing reported by ht_mem_zalloc()
+const char *ht_mem_backing_name(uint32_t backing) {
+  if (backing & HT_MEM_HUGETLB) return "hugetlb";
+  if (backing & HT_MEM_THP) return "thp";
+  if (backing & HT_MEM_MMAP) return "mmap";
+  return "heap";
+}
+
+// human readable NUMA placement reported by ht_mem_zalloc()
+const char *ht_mem_placement_name(uint32_t backing) {
+  if (backing & HT_MEM_INTERLEAVE) return "interleave";
+  if (backing & HT_MEM_NODE) return "node";
+  return "default";
+}
@@ -0,0 +1,59 @@
+/*
+ * Backing memory for large zero-initialized arrays (bucket arrays, pools)
+ */
+
+#ifndef __HT_MEM_H__
+#define __HT_MEM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Requests at least this big are served by anonymous mmap: the kernel hands
+ * out zero-filled pages lazily, so the allocation is O(1) and pages are only
+ * faulted in when first touched. Smaller ones go to calloc.
+ */
+#define HT_MEM_MMAP_THRESHOLD (1UL << 20)
+
+/*
+ * Huge page size assumed for MAP_HUGETLB and THP alignment. Huge mappings
+ * are rounded up to a multiple of it, so systems whose default hugetlbfs
+ * page size is not 2 MB should only use HT_MEM_OPT_THP.
+ */
+#define HT_MEM_HUGE_PAGE_SIZE (2UL << 20)
+
+// highest NUMA node number + 1 that HT_MEM_OPT_NODE() can express
+#define HT_MEM_MAX_NODES 255
+
+/*
+ * options for ht_mem_zalloc(), bits 0-15; NUMA and locking options force a
+ * mapping since memory policies and mlock() apply to whole pages
+ */
+#define HT_MEM_OPT_HUGETLB (1U << 0)    // try explicit hugetlbfs pages, fall back to HT_MEM_OPT_THP
+#define HT_MEM_OPT_THP (1U << 1)        // 2 MB aligned mapping with madvise(MADV_HUGEPAGE), fall back to plain pages
+#define HT_MEM_OPT_INTERLEAVE (1U << 2) // interleave pages over all online NUMA nodes
+#define HT_MEM_OPT_LOCK (1U << 3)       // fault in all pages up front and mlock() them if RLIMIT_MEMLOCK allows
+#define HT_MEM_OPT_NODE(n) ((((uint32_t)(n) + 1) & 0xff) << 8) // prefer pages on node n
+#define HT_MEM_OPT_NODE_MASK 0xff00U
+#define HT_MEM_OPT_NUMA_MASK (HT_MEM_OPT_INTERLEAVE | HT_MEM_OPT_NODE_MASK)
+#define HT_MEM_OPT_HUGE_MASK (HT_MEM_OPT_HUGETLB | HT_MEM_OPT_THP)
+
+// backing flags reported by ht_mem_zalloc()
+#define HT_MEM_MMAP (1U << 0)       // anonymous mapping, released with munmap
+#define HT_MEM_HUGETLB (1U << 1)    // mapped with MAP_HUGETLB
+#define HT_MEM_THP (1U << 2)        // madvise(MADV_HUGEPAGE) accepted for the mapping
+#define HT_MEM_INTERLEAVE (1U << 3) // MPOL_INTERLEAVE policy applied
+#define HT_MEM_NODE (1U << 4)       // MPOL_PREFERRED policy for the requested node applied
+#define HT_MEM_PREFAULTED (1U << 5) // every page was faulted in by ht_mem_zalloc()
+#define HT_MEM_LOCKED (1U << 6)     // pages are locked in RAM with mlock()
+
+void *ht_mem_zalloc(size_t size, uint32_t opts, uint32_t *backing);
+void *ht_mem_realloc(void *ptr, size_t old_size, size_t new_size, uint32_t opts, uint32_t *backing);
+void ht_mem_free(void *ptr, size_t size, uint32_t backing);
+const char *ht_mem_backing_name(uint32_t backing);
+const char *ht_mem_placement_name(uint32_t backing);
+
+int ht_numa_nodes(void);
+int ht_numa_current_node(void);
+
+#endif
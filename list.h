@@ -758,6 +758,183 @@ static inline void hlist_move_list(struct hlist_head *old,
 	     pos && ({ n = pos->member.next; 1; });			\
 	     pos = hlist_entry_safe(n, typeof(*pos), member))
 
+/*
+ * Bit-locked hlists (hlist_bl).
+ *
+ * Bit 0 of hlist_head.first is used as a per-bucket spinlock, so a table of
+ * plain hlist_heads gets one lock per bucket with no extra memory and no
+ * extra cache line touched. Nodes are always at least 2-byte aligned, so the
+ * bit is free. While a chain is locked its head pointer has the bit set:
+ * such heads must only be read through hlist_bl_first() and the
+ * hlist_bl_for_each_* iterators, and modified only with the lock held.
+ * The other links in the chain never carry the bit.
+ */
+#define LIST_BL_LOCKMASK	1UL
+
+static inline struct hlist_node *hlist_bl_first(struct hlist_head *h)
+{
+	return (struct hlist_node *)
+		((unsigned long)READ_ONCE(h->first) & ~LIST_BL_LOCKMASK);
+}
+
+/* the lock must be held, the lock bit is kept */
+static inline void hlist_bl_set_first(struct hlist_head *h,
+					struct hlist_node *n)
+{
+	WRITE_ONCE(h->first, (struct hlist_node *)
+		   ((unsigned long)n | LIST_BL_LOCKMASK));
+}
+
+static inline bool hlist_bl_empty(struct hlist_head *h)
+{
+	return !((unsigned long)READ_ONCE(h->first) & ~LIST_BL_LOCKMASK);
+}
+
+static inline void hlist_bl_lock(struct hlist_head *h)
+{
+	unsigned long *word = (unsigned long *)&h->first;
+
+	while (__atomic_fetch_or(word, LIST_BL_LOCKMASK, __ATOMIC_ACQUIRE) &
+	       LIST_BL_LOCKMASK) {
+		/* wait on a shared copy of the line until the bit clears */
+		while (__atomic_load_n(word, __ATOMIC_RELAXED) & LIST_BL_LOCKMASK)
+			cpu_relax();
+	}
+}
+
+static inline bool hlist_bl_trylock(struct hlist_head *h)
+{
+	unsigned long *word = (unsigned long *)&h->first;
+
+	return !(__atomic_fetch_or(word, LIST_BL_LOCKMASK, __ATOMIC_ACQUIRE) &
+		 LIST_BL_LOCKMASK);
+}
+
+static inline void hlist_bl_unlock(struct hlist_head *h)
+{
+	__atomic_fetch_and((unsigned long *)&h->first, ~LIST_BL_LOCKMASK,
+			   __ATOMIC_RELEASE);
+}
+
+static inline bool hlist_bl_is_locked(struct hlist_head *h)
+{
+	return (unsigned long)READ_ONCE(h->first) & LIST_BL_LOCKMASK;
+}
+
+/* the lock must be held */
+static inline void hlist_bl_add_head(struct hlist_node *n,
+				     struct hlist_head *h)
+{
+	struct hlist_node *first = hlist_bl_first(h);
+
+	n->next = first;
+	if (first)
+		first->pprev = &n->next;
+	n->pprev = &h->first;
+	hlist_bl_set_first(h, n);
+}
+
+/* the lock of the chain must be held */
+static inline void __hlist_bl_del(struct hlist_node *n)
+{
+	struct hlist_node *next = n->next;
+	struct hlist_node **pprev = n->pprev;
+
+	/* pprev may be the head, so be careful not to lose the lock bit */
+	WRITE_ONCE(*pprev, (struct hlist_node *)
+		   ((unsigned long)next |
+		    ((unsigned long)*pprev & LIST_BL_LOCKMASK)));
+	if (next)
+		next->pprev = pprev;
+}
+
+static inline void hlist_bl_del(struct hlist_node *n)
+{
+	__hlist_bl_del(n);
+	n->next = LIST_POISON1;
+	n->pprev = LIST_POISON2;
+}
+
+static inline void hlist_bl_del_init(struct hlist_node *n)
+{
+	if (!hlist_unhashed(n)) {
+		__hlist_bl_del(n);
+		INIT_HLIST_NODE(n);
+	}
+}
+
+/**
+ * hlist_bl_for_each_entry - iterate over a bit-locked hlist of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#define hlist_bl_for_each_entry(pos, head, member)			\
+	for (pos = hlist_entry_safe(hlist_bl_first(head), typeof(*(pos)), member);\
+	     pos;							\
+	     pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
+/**
+ * hlist_bl_for_each_entry_safe - iterate over a bit-locked hlist safe against removal of list entry
+ * @pos:	the type * to use as a loop cursor.
+ * @n:		another &struct hlist_node to use as temporary storage
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#define hlist_bl_for_each_entry_safe(pos, n, head, member)		\
+	for (pos = hlist_entry_safe(hlist_bl_first(head), typeof(*pos), member);\
+	     pos && ({ n = pos->member.next; 1; });			\
+	     pos = hlist_entry_safe(n, typeof(*pos), member))
+
+/*
+ * RCU variants of the hlist primitives.
+ *
+ * Updaters must be serialized against each other, readers walking the list
+ * with hlist_for_each_entry_rcu() take no lock. A deleted node keeps its
+ * ->next so that a reader standing on it can go on, and must not be freed
+ * or reused before a grace period has elapsed (see qsbr.h).
+ */
+static inline void hlist_add_head_rcu(struct hlist_node *n,
+				      struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+
+	n->next = first;
+	n->pprev = &h->first;
+	rcu_assign_pointer(h->first, n);
+	if (first)
+		first->pprev = &n->next;
+}
+
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+	__hlist_del(n);
+	n->pprev = LIST_POISON2;
+}
+
+static inline void hlist_del_init_rcu(struct hlist_node *n)
+{
+	if (!hlist_unhashed(n)) {
+		__hlist_del(n);
+		WRITE_ONCE(n->pprev, NULL);
+	}
+}
+
+/**
+ * hlist_for_each_entry_rcu - iterate over an rcu-protected hlist of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ *
+ * May run concurrently with hlist_add_head_rcu() and hlist_del_rcu().
+ */
+#define hlist_for_each_entry_rcu(pos, head, member)			\
+	for (pos = hlist_entry_safe(rcu_dereference((head)->first),	\
+				    typeof(*(pos)), member);		\
+	     pos;							\
+	     pos = hlist_entry_safe(rcu_dereference((pos)->member.next),	\
+				    typeof(*(pos)), member))
+
 /**
  * list_del_range - deletes range of entries from list.
  * @begin: first element in the range to delete from the list.
@@ -41,7 +41,7 @@ int __ilog2_u32(int n)
 static __always_inline __attribute__((const))
 int __ilog2_u64(u64 n)
 {
-	return fls(n) - 1;
+	return 63 - __builtin_clzll(n);
 }
 
 
@@ -23,6 +23,7 @@
 #include "jemalloc.h"
 #endif
 #include "assoc_array.h"
+#include "ht_mem.h"
 
 
 #ifdef LEAKCHECK
@@ -126,9 +127,9 @@ static void generate_ipv4(struct in_addr *ip) {
   ip->s_addr = random() % INT32_MAX;
 }
 
-static void generate_hostname(const char **hostname, int index) {
-  char buffer[50];                                      // Buffer for hostname
-  snprintf(buffer, sizeof(buffer), "Device %d", index); // Generate a hostname
+static void generate_hostname(const char **hostname, size_t index) {
+  char buffer[50];                                       // Buffer for hostname
+  snprintf(buffer, sizeof(buffer), "Device %zu", index); // Generate a hostname
   *hostname = strdup(buffer);                           // Duplicate the hostname string and assign to the pointer
 }
 
@@ -217,8 +218,8 @@ int run_example_code(int bits, float density, float print_freq_density) {
   printf("print_devisor: %d\n", print_divisor);
 
   // Calculate the number of entries to add based on the specified density
-  int entries_to_add = (1 << bits) * density;
-  for (int i = 0; i < entries_to_add; i++) {
+  size_t entries_to_add = ((size_t)1 << bits) * density;
+  for (size_t i = 0; i < entries_to_add; i++) {
     node = malloc(sizeof(mac_node_t)); // Allocate memory for the node
     if (!node) {
       // Handle memory allocation failure if needed
@@ -231,7 +232,7 @@ int run_example_code(int bits, float density, float print_freq_density) {
     // Add the node to the associative array using its MAC address as the key
     array_add_replace(arr, node, node->mac, ETH_ALEN);
     if ((i % print_divisor) == 0) {
-      printf("entry %d:\n", i);
+      printf("entry %zu:\n", i);
       print_mac_node(node);
     }
   }
@@ -272,6 +273,10 @@ int run_example_code(int bits, float density, float print_freq_density) {
 
   // Clean up: Free the associative array and its contents
   int coll = array_collision_percent(arr);
+  struct ht_stats stats;
+  ht_get_stats(arr->ht, &stats);
+  printf("buckets: %zu table: %zu bytes backing: %s placement: %s\n", stats.buckets, stats.table_bytes,
+         ht_mem_backing_name(stats.mem), ht_mem_placement_name(stats.mem));
   array_free(arr);
 
 #ifdef LEAKCHECK
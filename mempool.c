@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "ht_mem.h"
+#include "mempool.h"
+#include "mock_mem_functions.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+#define MEMPOOL_ROUND(x) (((x) + MEMPOOL_ALIGN - 1) & ~(size_t)(MEMPOOL_ALIGN - 1))
+#define MEMPOOL_CHUNK_HDR MEMPOOL_ROUND(sizeof(struct mempool_chunk))
+
+/**
+ * mempool_create - create an empty object pool
+ * @obj_size: size of each object
+ * @chunk_objs: objects per chunk, 0 for MEMPOOL_DEFAULT_CHUNK_OBJS
+ * @opts: HT_MEM_OPT_* huge page and NUMA options for the chunks
+ *
+ * No chunk is allocated until the first mempool_alloc().
+ * Returns the pool or NULL on failure.
+ */
+mempool_t *mempool_create(size_t obj_size, size_t chunk_objs, uint32_t opts) {
+  if (obj_size == 0) return NULL;
+  if (chunk_objs == 0) chunk_objs = MEMPOOL_DEFAULT_CHUNK_OBJS;
+
+  obj_size = MEMPOOL_ROUND(obj_size);
+  // chunk size in bytes must not overflow size_t
+  if (chunk_objs > (SIZE_MAX - MEMPOOL_CHUNK_HDR) / obj_size) return NULL;
+
+  mempool_t *pool = malloc(sizeof(mempool_t));
+  if (!pool) return NULL;
+
+  pool->chunks = NULL;
+  pool->cur = pool->end = NULL;
+  pool->free_list = NULL;
+  pool->obj_size = obj_size;
+  pool->chunk_objs = chunk_objs;
+  pool->opts = opts;
+  pool->count = 0;
+  pool->capacity = 0;
+  return pool;
+}
+
+void mempool_destroy(mempool_t *pool) {
+  if (!pool) return;
+  struct mempool_chunk *c = pool->chunks;
+  while (c) {
+    struct mempool_chunk *next = c->next;
+    ht_mem_free(c, c->size, c->mem);
+    c = next;
+  }
+  free(pool);
+}
+
+static int mempool_grow(mempool_t *pool, size_t objs) {
+  if (objs > (SIZE_MAX - MEMPOOL_CHUNK_HDR) / pool->obj_size) return -1;
+  size_t size = MEMPOOL_CHUNK_HDR + objs * pool->obj_size;
+  uint32_t mem;
+  struct mempool_chunk *c = ht_mem_zalloc(size, pool->opts, &mem);
+  if (!c) return -1;
+
+  c->next = pool->chunks;
+  c->size = size;
+  c->mem = mem;
+  pool->chunks = c;
+  pool->cur = (uint8_t *)c + MEMPOOL_CHUNK_HDR;
+  pool->end = (uint8_t *)c + size;
+  pool->capacity += objs;
+  return 0;
+}
+
+/**
+ * mempool_reserve - make sure @objs more objects can be allocated without growing
+ * @pool: object pool
+ * @objs: number of objects
+ *
+ * The missing slots are allocated as one chunk, with HT_MEM_OPT_LOCK in the
+ * pool options it is faulted in and locked right here, so the following
+ * @objs mempool_alloc() calls neither allocate nor fault.
+ * Returns 0 on success or -1 if the chunk could not be allocated.
+ */
+int mempool_reserve(mempool_t *pool, size_t objs) {
+  size_t avail = pool->capacity - pool->count;
+  if (objs <= avail) return 0;
+
+  // the new chunk becomes the bump area, keep the rest of the old one on the free list
+  while (pool->cur != pool->end) {
+    *(void **)pool->cur = pool->free_list;
+    pool->free_list = pool->cur;
+    pool->cur += pool->obj_size;
+  }
+  return mempool_grow(pool, objs - avail);
+}
+
+/**
+ * mempool_alloc - take an object from the pool
+ * @pool: object pool
+ *
+ * Released objects are reused first, then the current chunk is consumed and
+ * only then a new chunk is allocated. The object is not initialized.
+ * Returns the object or NULL if a new chunk could not be allocated.
+ */
+void *mempool_alloc(mempool_t *pool) {
+  void *obj = pool->free_list;
+  if (obj) {
+    pool->free_list = *(void **)obj;
+  } else {
+    if (pool->cur == pool->end && mempool_grow(pool, pool->chunk_objs)) return NULL;
+    obj = pool->cur;
+    pool->cur += pool->obj_size;
+  }
+  pool->count++;
+  return obj;
+}
+
+// give an object back to its pool, NULL is ignored
+void mempool_free(mempool_t *pool, void *obj) {
+  if (!obj) return;
+  *(void **)obj = pool->free_list;
+  pool->free_list = obj;
+  pool->count--;
+}
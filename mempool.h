@@ -0,0 +1,58 @@
+/*
+ * Fixed-size object pool
+ *
+ * Objects are carved from chunks obtained with ht_mem_zalloc(), so a pool
+ * can be backed by huge pages and bound to a NUMA node like the bucket
+ * arrays. Freed objects go to a free list and are reused before a new chunk
+ * is allocated; chunk memory is only given back by mempool_destroy(), which
+ * keeps object addresses type-stable for the lifetime of the pool.
+ */
+
+#ifndef __MEMPOOL_H__
+#define __MEMPOOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MEMPOOL_ALIGN 16
+#define MEMPOOL_DEFAULT_CHUNK_OBJS 1024
+
+struct mempool_chunk {
+  struct mempool_chunk *next; // previously allocated chunk
+  size_t size;                // bytes passed to ht_mem_zalloc()
+  uint32_t mem;               // HT_MEM_* backing of this chunk
+};
+
+/**
+ * struct mempool - pool of equally sized objects
+ * @chunks: most recently allocated chunk, older ones are linked through ->next
+ * @cur: next never used object in @chunks
+ * @end: end of the object area of @chunks
+ * @free_list: released objects, linked through their first word
+ * @obj_size: object size rounded up to MEMPOOL_ALIGN
+ * @chunk_objs: number of objects per chunk
+ * @opts: HT_MEM_OPT_* options used for every chunk
+ * @count: number of objects handed out and not yet released
+ * @capacity: number of object slots in all chunks
+ */
+typedef struct mempool {
+  struct mempool_chunk *chunks;
+  uint8_t *cur;
+  uint8_t *end;
+  void *free_list;
+  size_t obj_size;
+  size_t chunk_objs;
+  uint32_t opts;
+  size_t count;
+  size_t capacity;
+} mempool_t;
+
+mempool_t *mempool_create(size_t obj_size, size_t chunk_objs, uint32_t opts);
+void mempool_destroy(mempool_t *pool);
+
+int mempool_reserve(mempool_t *pool, size_t objs);
+
+void *mempool_alloc(mempool_t *pool);
+void mempool_free(mempool_t *pool, void *obj);
+
+#endif
@@ -6,6 +6,7 @@
 // Function pointers declarations
 extern void *(*custom_malloc)(size_t);
 extern void *(*custom_calloc)(size_t, size_t);
+extern void *(*custom_realloc)(void *, size_t);
 extern void (*custom_free)(void *);
 
 // Function to set custom memory functions
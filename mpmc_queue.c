@@ -0,0 +1,228 @@
+#include <limits.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "mock_mem_functions.h"
+#include "mpmc_queue.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+// futex operations from <linux/futex.h>, called through syscall() like the mbind() in ht_mem.c
+#ifndef FUTEX_WAIT_PRIVATE
+#define FUTEX_WAIT_PRIVATE 128
+#endif
+#ifndef FUTEX_WAKE_PRIVATE
+#define FUTEX_WAKE_PRIVATE 129
+#endif
+
+static void mpmc_futex_wait(uint32_t *addr, uint32_t val) {
+#ifdef SYS_futex
+  // returns at once if *addr != val, spurious wakeups are handled by the callers' loops
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+  (void)addr;
+  (void)val;
+  sched_yield();
+#endif
+}
+
+static void mpmc_futex_wake(uint32_t *addr, int count) {
+#ifdef SYS_futex
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+  (void)addr;
+  (void)count;
+#endif
+}
+
+/*
+ * Wake up to 'count' sleepers after cells changed state. The full fence
+ * pairs with the one in mpmc_wait(): either the sleeper sees the cells or
+ * we see it registered as a waiter.
+ */
+static void mpmc_signal(mpmc_queue_t *q, struct mpmc_event *ev, size_t count) {
+  if (!(q->flags & MPMC_QUEUE_FUTEX)) return;
+  smp_mb();
+  if (!__atomic_load_n(&ev->waiters, __ATOMIC_RELAXED)) return;
+  __atomic_fetch_add(&ev->seq, 1, __ATOMIC_RELEASE);
+  mpmc_futex_wake(&ev->seq, count > INT_MAX ? INT_MAX : (int)count);
+}
+
+/**
+ * mpmc_queue_create - create a bounded MPMC queue
+ * @capacity: number of cells, rounded up to a power of two, at least 2
+ * @flags: MPMC_QUEUE_* flags
+ *
+ * Returns the new queue or NULL on failure.
+ */
+mpmc_queue_t *mpmc_queue_create(size_t capacity, uint32_t flags) {
+  if (capacity < 2) capacity = 2;
+  if (capacity > SIZE_MAX / 2 / sizeof(struct mpmc_cell)) return NULL;
+  size_t cap = 2;
+  while (cap < capacity)
+    cap <<= 1;
+
+  void *mem;
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(mpmc_queue_t))) return NULL;
+  mpmc_queue_t *q = mem;
+  q->cells = malloc(cap * sizeof(struct mpmc_cell));
+  if (!q->cells) {
+    free(q);
+    return NULL;
+  }
+  for (size_t i = 0; i < cap; i++)
+    q->cells[i].seq = i;
+  q->mask = cap - 1;
+  q->flags = flags;
+  q->tail = q->head = 0;
+  q->items = q->space = (struct mpmc_event){0, 0};
+  q->closed = 0;
+  return q;
+}
+
+// free the queue, queued pointers are not touched and nobody may wait on it
+void mpmc_queue_free(mpmc_queue_t *q) {
+  if (!q) return;
+  free(q->cells);
+  free(q);
+}
+
+/*
+ * Claim up to 'n' consecutive cells whose sequence is 'pos + i + ready'
+ * (0 to fill, 1 to drain) by moving '*counter' past them. Returns the
+ * number claimed and their first position in '*first'.
+ */
+static size_t mpmc_claim(mpmc_queue_t *q, size_t *counter, size_t ready, size_t n, size_t *first) {
+  size_t pos = __atomic_load_n(counter, __ATOMIC_RELAXED);
+
+  for (;;) {
+    size_t k = 0;
+    while (k < n && k <= q->mask) {
+      size_t seq = __atomic_load_n(&q->cells[(pos + k) & q->mask].seq, __ATOMIC_ACQUIRE);
+      if (seq != pos + k + ready) break;
+      k++;
+    }
+    if (k == 0) {
+      size_t seq = __atomic_load_n(&q->cells[pos & q->mask].seq, __ATOMIC_ACQUIRE);
+      // behind by a lap: full when filling, empty when draining
+      if ((intptr_t)(seq - (pos + ready)) < 0) return 0;
+      pos = __atomic_load_n(counter, __ATOMIC_RELAXED); // someone else claimed pos
+      continue;
+    }
+    if (__atomic_compare_exchange_n(counter, &pos, pos + k, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      *first = pos;
+      return k;
+    }
+  }
+}
+
+/**
+ * mpmc_queue_enqueue_bulk - add up to @n pointers
+ * @q: queue
+ * @items: pointers to add, they are dequeued in this order
+ * @n: number of them
+ *
+ * Returns the number of pointers added, less than @n if the queue filled up.
+ */
+size_t mpmc_queue_enqueue_bulk(mpmc_queue_t *q, void *const *items, size_t n) {
+  size_t pos, k = mpmc_claim(q, &q->tail, 0, n, &pos);
+
+  for (size_t i = 0; i < k; i++) {
+    struct mpmc_cell *cell = &q->cells[(pos + i) & q->mask];
+    cell->data = items[i];
+    __atomic_store_n(&cell->seq, pos + i + 1, __ATOMIC_RELEASE);
+  }
+  if (k) mpmc_signal(q, &q->items, k);
+  return k;
+}
+
+/**
+ * mpmc_queue_dequeue_bulk - take up to @n pointers
+ * @q: queue
+ * @items: array receiving the pointers
+ * @n: its size
+ *
+ * Returns the number of pointers taken, 0 if the queue is empty.
+ */
+size_t mpmc_queue_dequeue_bulk(mpmc_queue_t *q, void **items, size_t n) {
+  size_t pos, k = mpmc_claim(q, &q->head, 1, n, &pos);
+
+  for (size_t i = 0; i < k; i++) {
+    struct mpmc_cell *cell = &q->cells[(pos + i) & q->mask];
+    items[i] = cell->data;
+    // ready for the producer of the next lap
+    __atomic_store_n(&cell->seq, pos + i + q->mask + 1, __ATOMIC_RELEASE);
+  }
+  if (k) mpmc_signal(q, &q->space, k);
+  return k;
+}
+
+// returns 0 or -1 if the queue is full
+int mpmc_queue_enqueue(mpmc_queue_t *q, void *data) {
+  return mpmc_queue_enqueue_bulk(q, &data, 1) ? 0 : -1;
+}
+
+// returns 0 and stores the pointer in '*data' or returns -1 if the queue is empty
+int mpmc_queue_dequeue(mpmc_queue_t *q, void **data) {
+  return mpmc_queue_dequeue_bulk(q, data, 1) ? 0 : -1;
+}
+
+/*
+ * Sleep until 'ev' is signaled or the queue is closed. The caller retries
+ * its operation after registering as a waiter, so a signal sent between
+ * its failed attempt and the futex call is never lost.
+ */
+static int mpmc_wait(mpmc_queue_t *q, struct mpmc_event *ev, int (*try_op)(mpmc_queue_t *, void **), void **data) {
+  for (;;) {
+    if (try_op(q, data) == 0) return 0;
+    if (__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)) return -1;
+
+    uint32_t seq = __atomic_load_n(&ev->seq, __ATOMIC_ACQUIRE);
+    __atomic_fetch_add(&ev->waiters, 1, __ATOMIC_SEQ_CST);
+    smp_mb();
+    int ret = try_op(q, data);
+    if (ret && !__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)) mpmc_futex_wait(&ev->seq, seq);
+    __atomic_fetch_sub(&ev->waiters, 1, __ATOMIC_RELAXED);
+    if (ret == 0) return 0;
+  }
+}
+
+static int mpmc_try_enqueue(mpmc_queue_t *q, void **data) {
+  return mpmc_queue_enqueue(q, *data);
+}
+
+/*
+ * mpmc_queue_enqueue_wait - add a pointer, sleeping while the queue is full
+ * Returns 0 or -1 if the queue was closed or not created with MPMC_QUEUE_FUTEX.
+ */
+int mpmc_queue_enqueue_wait(mpmc_queue_t *q, void *data) {
+  if (!(q->flags & MPMC_QUEUE_FUTEX) || __atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)) return -1;
+  return mpmc_wait(q, &q->space, mpmc_try_enqueue, &data);
+}
+
+/*
+ * mpmc_queue_dequeue_wait - take a pointer, sleeping while the queue is empty
+ * A closed queue is drained first, -1 is returned once it is closed and
+ * empty or if it was not created with MPMC_QUEUE_FUTEX.
+ */
+int mpmc_queue_dequeue_wait(mpmc_queue_t *q, void **data) {
+  if (!(q->flags & MPMC_QUEUE_FUTEX)) return -1;
+  return mpmc_wait(q, &q->items, mpmc_queue_dequeue, data);
+}
+
+// refuse further blocking enqueues and wake every sleeper, e.g. to stop a worker pool
+void mpmc_queue_close(mpmc_queue_t *q) {
+  __atomic_store_n(&q->closed, 1, __ATOMIC_RELEASE);
+  smp_mb();
+  __atomic_fetch_add(&q->items.seq, 1, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&q->space.seq, 1, __ATOMIC_RELEASE);
+  mpmc_futex_wake(&q->items.seq, INT_MAX);
+  mpmc_futex_wake(&q->space.seq, INT_MAX);
+}
@@ -0,0 +1,72 @@
+/*
+ * Bounded multi-producer/multi-consumer queue of pointers (D. Vyukov)
+ *
+ * Every cell carries a sequence number telling which lap of the ring it is
+ * ready for: producers claim a position with a CAS on the tail once the
+ * cell's sequence equals that position, consumers claim with a CAS on the
+ * head once it equals position + 1. Producers and consumers only meet on
+ * the cells, the two counters live on their own cache lines. Bulk
+ * operations claim a run of ready cells with a single CAS.
+ *
+ * Queues created with MPMC_QUEUE_FUTEX can also be waited on: blocking
+ * calls sleep on a futex event counter, and the non-blocking side only
+ * pays a fence and a load of the waiter count per operation.
+ */
+
+#ifndef __MPMC_QUEUE_H__
+#define __MPMC_QUEUE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ht_lock.h"
+
+// mpmc_queue_create() flags
+#define MPMC_QUEUE_FUTEX (1U << 0) // enable mpmc_queue_enqueue_wait()/mpmc_queue_dequeue_wait()
+
+struct mpmc_cell {
+  size_t seq; // position this cell is ready for: pos to be filled, pos + 1 to be drained
+  void *data;
+};
+
+// futex event counter with the number of threads sleeping on it
+struct mpmc_event {
+  uint32_t seq;
+  uint32_t waiters;
+};
+
+typedef struct mpmc_queue {
+  size_t tail __attribute__((aligned(HT_CACHELINE_SIZE))); // next position to fill
+  size_t head __attribute__((aligned(HT_CACHELINE_SIZE))); // next position to drain
+  struct mpmc_event items __attribute__((aligned(HT_CACHELINE_SIZE))); // signaled when cells are filled
+  struct mpmc_event space;                                            // signaled when cells are drained
+  int closed;
+  struct mpmc_cell *cells __attribute__((aligned(HT_CACHELINE_SIZE)));
+  size_t mask;    // capacity - 1
+  uint32_t flags; // MPMC_QUEUE_* flags
+} mpmc_queue_t;
+
+mpmc_queue_t *mpmc_queue_create(size_t capacity, uint32_t flags);
+void mpmc_queue_free(mpmc_queue_t *q);
+
+int mpmc_queue_enqueue(mpmc_queue_t *q, void *data);
+int mpmc_queue_dequeue(mpmc_queue_t *q, void **data);
+size_t mpmc_queue_enqueue_bulk(mpmc_queue_t *q, void *const *items, size_t n);
+size_t mpmc_queue_dequeue_bulk(mpmc_queue_t *q, void **items, size_t n);
+
+int mpmc_queue_enqueue_wait(mpmc_queue_t *q, void *data);
+int mpmc_queue_dequeue_wait(mpmc_queue_t *q, void **data);
+void mpmc_queue_close(mpmc_queue_t *q);
+
+// number of queued pointers, a snapshot that may be stale right away
+static inline size_t mpmc_queue_count(const mpmc_queue_t *q) {
+  size_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+  size_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+  return tail > head ? tail - head : 0;
+}
+
+static inline size_t mpmc_queue_capacity(const mpmc_queue_t *q) {
+  return q->mask + 1;
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include <sched.h>
+#include <stdlib.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "mock_mem_functions.h"
+#include "qsbr.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+qsbr_t *qsbr_create(void) {
+  void *mem;
+  // the epoch and the registry sit on separate cache lines
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(qsbr_t))) return NULL;
+  qsbr_t *q = mem;
+
+  q->epoch = 1; // 0 marks offline threads
+  q->threads = NULL;
+  q->lock = (ht_spinlock_t)HT_SPINLOCK_INIT;
+  q->cbs = NULL;
+  q->cbs_tail = &q->cbs;
+  q->pending = 0;
+  return q;
+}
+
+// run all pending callbacks and free the domain, no reader may be online
+void qsbr_destroy(qsbr_t *q) {
+  if (!q) return;
+  qsbr_synchronize(q);
+
+  qsbr_thread_t *t = q->threads;
+  while (t) {
+    qsbr_thread_t *next = t->next;
+    free(t);
+    t = next;
+  }
+  free(q);
+}
+
+// register the calling thread as a reader, it starts online
+qsbr_thread_t *qsbr_register(qsbr_t *q) {
+  qsbr_thread_t *t;
+
+  ht_spin_lock(&q->lock);
+  for (t = q->threads; t; t = t->next) {
+    if (!t->in_use) break;
+  }
+  if (!t) {
+    void *mem;
+    if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(qsbr_thread_t))) {
+      ht_spin_unlock(&q->lock);
+      return NULL;
+    }
+    t = mem;
+    t->q = q;
+    t->epoch = 0;
+    t->next = q->threads;
+    // grace period scans walk the registry without the lock
+    rcu_assign_pointer(q->threads, t);
+  }
+  t->in_use = 1;
+  ht_spin_unlock(&q->lock);
+
+  qsbr_online(t);
+  return t;
+}
+
+void qsbr_unregister(qsbr_thread_t *t) {
+  if (!t) return;
+  qsbr_offline(t);
+  ht_spin_lock(&t->q->lock);
+  t->in_use = 0;
+  ht_spin_unlock(&t->q->lock);
+}
+
+void qsbr_online(qsbr_thread_t *t) {
+  smp_store_release(&t->epoch, smp_load_acquire(&t->q->epoch));
+  // the store must be visible before the first read of shared data
+  smp_mb();
+}
+
+void qsbr_offline(qsbr_thread_t *t) {
+  smp_store_release(&t->epoch, 0);
+}
+
+// oldest epoch any online reader may still be in, UINT64_MAX if none is online
+static uint64_t qsbr_min_epoch(qsbr_t *q) {
+  uint64_t min = UINT64_MAX;
+  for (qsbr_thread_t *t = rcu_dereference(q->threads); t; t = t->next) {
+    uint64_t e = smp_load_acquire(&t->epoch);
+    if (e && e < min) min = e;
+  }
+  return min;
+}
+
+/**
+ * qsbr_poll - run the callbacks whose grace period has elapsed
+ * @q: qsbr domain
+ *
+ * Callbacks run in the calling thread, without any qsbr lock held.
+ * Returns the number of callbacks run.
+ */
+size_t qsbr_poll(qsbr_t *q) {
+  uint64_t min = qsbr_min_epoch(q);
+  struct qsbr_cb *done = NULL, **done_tail = &done;
+  size_t n = 0;
+
+  // callbacks are queued in epoch order, take the expired prefix
+  ht_spin_lock(&q->lock);
+  while (q->cbs && q->cbs->epoch <= min) {
+    *done_tail = q->cbs;
+    done_tail = &q->cbs->next;
+    q->cbs = q->cbs->next;
+    q->pending--;
+    n++;
+  }
+  if (!q->cbs) q->cbs_tail = &q->cbs;
+  ht_spin_unlock(&q->lock);
+  *done_tail = NULL;
+
+  while (done) {
+    struct qsbr_cb *next = done->next;
+    // an embedded record may be freed by its own callback, read it first
+    int allocated = done->allocated;
+    done->fn(done->ptr, done->arg);
+    if (allocated) free(done);
+    done = next;
+  }
+  return n;
+}
+
+/**
+ * qsbr_synchronize - wait for a full grace period and run expired callbacks
+ * @q: qsbr domain
+ *
+ * Must not be called by a thread that is an online reader of @q, it would
+ * wait for itself forever.
+ */
+void qsbr_synchronize(qsbr_t *q) {
+  uint64_t target = __atomic_add_fetch(&q->epoch, 1, __ATOMIC_SEQ_CST);
+
+  for (qsbr_thread_t *t = rcu_dereference(q->threads); t; t = t->next) {
+    for (;;) {
+      uint64_t e = smp_load_acquire(&t->epoch);
+      if (!e || e >= target) break;
+      sched_yield();
+    }
+  }
+  qsbr_poll(q);
+}
+
+static void qsbr_enqueue(qsbr_t *q, struct qsbr_cb *cb, void (*fn)(void *ptr, void *arg), void *ptr, void *arg) {
+  cb->fn = fn;
+  cb->ptr = ptr;
+  cb->arg = arg;
+  cb->next = NULL;
+
+  ht_spin_lock(&q->lock);
+  // a new epoch inside the lock keeps the queue sorted; readers that see it have seen the unlink
+  cb->epoch = __atomic_add_fetch(&q->epoch, 1, __ATOMIC_SEQ_CST);
+  *q->cbs_tail = cb;
+  q->cbs_tail = &cb->next;
+  q->pending++;
+  ht_spin_unlock(&q->lock);
+}
+
+/**
+ * qsbr_defer - call @fn(@ptr, @arg) after a grace period
+ * @q: qsbr domain
+ * @fn: reclamation callback, typically frees @ptr
+ * @ptr: object already unlinked from every rcu-protected structure
+ * @arg: passed to @fn
+ *
+ * Callbacks run from a later qsbr_poll() or qsbr_synchronize(). If no
+ * memory is left to queue the callback, the caller waits for a grace
+ * period and @fn runs right away, so online readers must use
+ * qsbr_defer_cb() instead.
+ */
+void qsbr_defer(qsbr_t *q, void (*fn)(void *ptr, void *arg), void *ptr, void *arg) {
+  struct qsbr_cb *cb = malloc(sizeof(struct qsbr_cb));
+  if (!cb) {
+    qsbr_synchronize(q);
+    fn(ptr, arg);
+    return;
+  }
+  cb->allocated = 1;
+  qsbr_enqueue(q, cb, fn, ptr, arg);
+}
+
+/**
+ * qsbr_defer_cb - qsbr_defer() with a record provided by the caller
+ * @q: qsbr domain
+ * @cb: record, typically embedded in @ptr, untouched by qsbr once @fn started
+ * @fn: reclamation callback, may free the memory holding @cb
+ * @ptr: object already unlinked from every rcu-protected structure
+ * @arg: passed to @fn
+ *
+ * Never allocates and never waits, safe to call from an online reader.
+ */
+void qsbr_defer_cb(qsbr_t *q, struct qsbr_cb *cb, void (*fn)(void *ptr, void *arg), void *ptr, void *arg) {
+  cb->allocated = 0;
+  qsbr_enqueue(q, cb, fn, ptr, arg);
+}
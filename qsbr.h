@@ -0,0 +1,71 @@
+/*
+ * Quiescent-state-based reclamation (QSBR) for RCU-style readers
+ *
+ * Readers walk shared structures with the _rcu list primitives and take no
+ * lock and execute no atomic instruction. Every registered reader thread
+ * periodically announces a quiescent state (a point where it holds no
+ * reference to shared objects) with qsbr_quiescent(), which is one load and
+ * one store. Writers unlink an object and hand it to qsbr_defer(); it is
+ * freed once every online reader has passed a quiescent state after the
+ * unlink, i.e. after a grace period.
+ *
+ * A reader thread about to block for a long time should go offline, so
+ * that it does not hold up grace periods.
+ */
+
+#ifndef __QSBR_H__
+#define __QSBR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ht_lock.h"
+
+// per reader thread state, on its own cache line since its owner writes it often
+typedef struct qsbr_thread {
+  uint64_t epoch;           // global epoch seen at the last quiescent state, 0 while offline
+  struct qsbr *q;           // domain the thread is registered with
+  struct qsbr_thread *next; // registry link, records are reused but never freed before qsbr_destroy()
+  int in_use;               // owned by a registered thread
+} __attribute__((aligned(HT_CACHELINE_SIZE))) qsbr_thread_t;
+
+struct qsbr_cb {
+  struct qsbr_cb *next;
+  uint64_t epoch; // grace period target, readers must have seen at least this epoch
+  void (*fn)(void *ptr, void *arg);
+  void *ptr;
+  void *arg;
+  int allocated; // queued by qsbr_defer(), freed once fn ran; records given to qsbr_defer_cb() belong to the caller
+};
+
+typedef struct qsbr {
+  uint64_t epoch __attribute__((aligned(HT_CACHELINE_SIZE))); // global epoch, bumped by writers
+  qsbr_thread_t *threads __attribute__((aligned(HT_CACHELINE_SIZE)));
+  ht_spinlock_t lock;       // registry updates and the callback list
+  struct qsbr_cb *cbs;      // deferred callbacks, oldest first
+  struct qsbr_cb **cbs_tail;
+  size_t pending;           // number of deferred callbacks
+} qsbr_t;
+
+qsbr_t *qsbr_create(void);
+void qsbr_destroy(qsbr_t *q);
+
+qsbr_thread_t *qsbr_register(qsbr_t *q);
+void qsbr_unregister(qsbr_thread_t *t);
+void qsbr_online(qsbr_thread_t *t);
+void qsbr_offline(qsbr_thread_t *t);
+
+void qsbr_defer(qsbr_t *q, void (*fn)(void *ptr, void *arg), void *ptr, void *arg);
+void qsbr_defer_cb(qsbr_t *q, struct qsbr_cb *cb, void (*fn)(void *ptr, void *arg), void *ptr, void *arg);
+size_t qsbr_poll(qsbr_t *q);
+void qsbr_synchronize(qsbr_t *q);
+
+/*
+ * qsbr_quiescent - announce that the calling reader holds no reference to
+ * rcu-protected objects; pointers obtained before must not be used after.
+ */
+static inline void qsbr_quiescent(qsbr_thread_t *t) {
+  smp_store_release(&t->epoch, smp_load_acquire(&t->q->epoch));
+}
+
+#endif
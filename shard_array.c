@@ -0,0 +1,163 @@
+#include <errno.h>
+#include <string.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "ht_mem.h"
+#include "mock_mem_functions.h"
+#include "shard_array.h"
+
+// redefine mem functions with custom version
+#define calloc custom_calloc
+#define free custom_free
+
+/**
+ * shard_array_create - create a sharded associative array
+ * @shard_bits: log2 of the number of shards, at most SHARD_ARRAY_MAX_BITS
+ * @bits: log2 of the bucket count of every shard
+ * @flags: SHARD_ARRAY_NUMA, ARRAY_UNORDERED and HT_* creation options
+ * @free_entry: same as for ARRAY_POOL arrays, must not free the entry itself
+ * @fill_entry: same as for array_create()
+ *
+ * Every shard allocates its entries from its own pool (ARRAY_POOL).
+ * Returns the new array or NULL on failure.
+ */
+shard_array_t *
+shard_array_create(uint32_t shard_bits, uint32_t bits, uint32_t flags, void (*free_entry)(void *),
+                   int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size)) {
+  if (shard_bits > SHARD_ARRAY_MAX_BITS || (flags & (ARRAY_STABLE | ARRAY_POOL))) return NULL;
+
+  shard_array_t *sa = calloc(1, sizeof(shard_array_t));
+  if (!sa) return NULL;
+  sa->shard_bits = shard_bits;
+  sa->count = 1U << shard_bits;
+
+  void *shards;
+  if (posix_memalign(&shards, HT_CACHELINE_SIZE, sa->count * sizeof(struct array_shard))) {
+    free(sa);
+    return NULL;
+  }
+  memset(shards, 0, sa->count * sizeof(struct array_shard));
+  sa->shards = shards;
+
+  int nodes = flags & SHARD_ARRAY_NUMA ? ht_numa_nodes() : 0;
+  uint32_t arr_flags = (flags & ~SHARD_ARRAY_NUMA) | ARRAY_POOL;
+  for (uint32_t i = 0; i < sa->count; i++) {
+    struct array_shard *s = &sa->shards[i];
+    s->arr = array_create_ex(bits, nodes ? arr_flags | HT_NODE(i % nodes) : arr_flags, free_entry, fill_entry);
+    if (!s->arr) {
+      shard_array_free(sa);
+      return NULL;
+    }
+    ht_lock_init(&s->lock, HT_LOCK_SPIN);
+  }
+  return sa;
+}
+
+// free all shards and entries, must not race with any other call
+int shard_array_free(shard_array_t *sa) {
+  if (!sa) return -1;
+  for (uint32_t i = 0; i < sa->count; i++) {
+    array_free(sa->shards[i].arr);
+  }
+  free(sa->shards);
+  free(sa);
+  return 0;
+}
+
+static inline struct array_shard *shard_lock(shard_array_t *sa, void *key, uint8_t key_size) {
+  struct array_shard *s = &sa->shards[shard_array_index(sa, key, key_size)];
+  ht_spin_lock(&s->lock.spin);
+  return s;
+}
+
+static inline void shard_unlock(struct array_shard *s) {
+  ht_spin_unlock(&s->lock.spin);
+}
+
+int shard_array_add(shard_array_t *sa, void *data, void *key, uint8_t key_size) {
+  if (!sa) return -1;
+  struct array_shard *s = shard_lock(sa, key, key_size);
+  int ret = array_add(s->arr, data, key, key_size);
+  if (!ret) s->stats.adds++;
+  shard_unlock(s);
+  return ret;
+}
+
+int shard_array_add_replace(shard_array_t *sa, void *data, void *key, uint8_t key_size) {
+  if (!sa) return -1;
+  struct array_shard *s = shard_lock(sa, key, key_size);
+  if (array_del(s->arr, key, key_size) == 0) s->stats.dels++;
+  int ret = array_add(s->arr, data, key, key_size);
+  if (!ret) s->stats.adds++;
+  shard_unlock(s);
+  return ret;
+}
+
+// returns 0 if an entry was deleted, 1 if the key was not found
+int shard_array_del(shard_array_t *sa, void *key, uint8_t key_size) {
+  if (!sa) return EINVAL;
+  struct array_shard *s = shard_lock(sa, key, key_size);
+  int ret = array_del(s->arr, key, key_size);
+  if (!ret) s->stats.dels++;
+  shard_unlock(s);
+  return ret;
+}
+
+/**
+ * shard_array_lookup - run a callback on the entry of a key
+ * @sa: sharded array
+ * @key: the key
+ * @key_size: its size
+ * @fn: called with the entry while its shard is locked, may be NULL;
+ *      must not call back into @sa
+ * @arg: passed to @fn
+ *
+ * Returns -1 if the key was not found, otherwise the return value of @fn
+ * (0 if @fn is NULL).
+ */
+int shard_array_lookup(shard_array_t *sa, void *key, uint8_t key_size,
+                       int (*fn)(assoc_array_entry_t *entry, void *arg), void *arg) {
+  if (!sa) return -1;
+  struct array_shard *s = shard_lock(sa, key, key_size);
+  assoc_array_entry_t *e = array_get_by_key(s->arr, key, key_size);
+  int ret = -1;
+  s->stats.lookups++;
+  if (e) {
+    s->stats.hits++;
+    ret = fn ? fn(e, arg) : 0;
+  }
+  shard_unlock(s);
+  return ret;
+}
+
+static int shard_copy_data(assoc_array_entry_t *entry, void *arg) {
+  *(void **)arg = entry->data;
+  return 0;
+}
+
+// store the data of 'key' in '*data', returns 0 or -1 if the key was not found
+int shard_array_get_data(shard_array_t *sa, void *key, uint8_t key_size, void **data) {
+  return shard_array_lookup(sa, key, key_size, shard_copy_data, data);
+}
+
+// total number of entries, each shard is read under its lock
+size_t shard_array_size(shard_array_t *sa) {
+  size_t size = 0;
+  for (uint32_t i = 0; i < sa->count; i++) {
+    struct array_shard *s = &sa->shards[i];
+    ht_spin_lock(&s->lock.spin);
+    size += s->arr->size;
+    ht_spin_unlock(&s->lock.spin);
+  }
+  return size;
+}
+
+// copy the counters of shard 'idx'
+void shard_array_get_stats(shard_array_t *sa, uint32_t idx, struct shard_stats *stats) {
+  struct array_shard *s = &sa->shards[idx];
+  ht_spin_lock(&s->lock.spin);
+  *stats = s->stats;
+  ht_spin_unlock(&s->lock.spin);
+}
@@ -0,0 +1,69 @@
+/*
+ * Sharded associative array
+ *
+ * 2^shard_bits independent assoc_array_t instances, each with its own lock,
+ * entry pool and counters, on separate cache lines. A key goes to the shard
+ * selected by the high bits of its 64-bit hash while the buckets inside a
+ * shard are selected by the low bits, so the two choices stay independent.
+ * Writers of different shards never share a lock or a cache line; workers
+ * pinned to a core can also own a shard outright and use it unlocked through
+ * shard_array_shard().
+ */
+
+#ifndef __SHARD_ARRAY_H__
+#define __SHARD_ARRAY_H__
+
+#include "assoc_array.h"
+#include "ht_lock.h"
+
+#define SHARD_ARRAY_MAX_BITS 16
+
+// shard_array_create() flags, bits 24-31; ARRAY_UNORDERED and HT_* creation options may be or-ed in
+#define SHARD_ARRAY_NUMA (1U << 24) // place shard i on NUMA node i % ht_numa_nodes()
+
+struct shard_stats {
+  uint64_t adds;    // successful adds
+  uint64_t dels;    // successful deletes
+  uint64_t lookups; // lookups
+  uint64_t hits;    // lookups that found the key
+};
+
+struct array_shard {
+  struct ht_lock lock; // spinlock guarding arr and stats
+  assoc_array_t *arr;
+  struct shard_stats stats;
+} __attribute__((aligned(HT_CACHELINE_SIZE)));
+
+typedef struct shard_array {
+  struct array_shard *shards;
+  uint32_t shard_bits; // log2 of the number of shards
+  uint32_t count;      // number of shards
+} shard_array_t;
+
+shard_array_t *
+shard_array_create(uint32_t shard_bits, uint32_t bits, uint32_t flags, void (*free_entry)(void *),
+                   int (*fill_entry)(assoc_array_entry_t *entry, void *data, void *key, uint8_t key_size));
+int shard_array_free(shard_array_t *sa);
+
+int shard_array_add(shard_array_t *sa, void *data, void *key, uint8_t key_size);
+int shard_array_add_replace(shard_array_t *sa, void *data, void *key, uint8_t key_size);
+int shard_array_del(shard_array_t *sa, void *key, uint8_t key_size);
+int shard_array_lookup(shard_array_t *sa, void *key, uint8_t key_size,
+                       int (*fn)(assoc_array_entry_t *entry, void *arg), void *arg);
+int shard_array_get_data(shard_array_t *sa, void *key, uint8_t key_size, void **data);
+
+size_t shard_array_size(shard_array_t *sa);
+void shard_array_get_stats(shard_array_t *sa, uint32_t idx, struct shard_stats *stats);
+
+// shard index of a key
+static inline uint32_t shard_array_index(const shard_array_t *sa, void *key, uint8_t key_size) {
+  if (!sa->shard_bits) return 0;
+  return (uint32_t)(hash64_str((char *)key, key_size) >> (64 - sa->shard_bits));
+}
+
+// the array of shard 'idx', for a thread that owns the shard and needs no lock
+static inline assoc_array_t *shard_array_shard(shard_array_t *sa, uint32_t idx) {
+  return sa->shards[idx].arr;
+}
+
+#endif
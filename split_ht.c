@@ -0,0 +1,327 @@
+#include <string.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "split_ht.h"
+#include "ht_mem.h"
+#include "log2.h"
+#include "mock_mem_functions.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define calloc custom_calloc
+#define free custom_free
+
+#define SPLIT_SEGMENT_SIZE ((size_t)1 << SPLIT_SEGMENT_BITS)
+#define SPLIT_DIR_BYTES (sizeof(struct split_node **) << SPLIT_DIR_BITS)
+
+static inline struct split_node *split_ptr(uintptr_t v) {
+  return (struct split_node *)(v & ~SPLIT_MARK);
+}
+
+static inline bool split_cas(uintptr_t *p, uintptr_t expected, uintptr_t desired) {
+  return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline u64 split_reverse(u64 x) {
+  x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+  x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+  x = ((x >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((x & 0x0f0f0f0f0f0f0f0fULL) << 4);
+  return __builtin_bswap64(x);
+}
+
+static inline u64 split_so_regular(u64 hash) {
+  return split_reverse(hash) | 1;
+}
+
+static inline u64 split_so_dummy(size_t bkt) {
+  return split_reverse(bkt);
+}
+
+// order of a node against the target (so_key, key); dummies are unique per so_key
+static int split_cmp(const struct split_node *n, u64 so_key, const void *key, uint8_t key_size) {
+  if (n->so_key != so_key) return n->so_key < so_key ? -1 : 1;
+  if (!(so_key & 1)) return 0;
+  const split_entry_t *e = (const split_entry_t *)n;
+  if (e->key_size != key_size) return e->key_size < key_size ? -1 : 1;
+  return memcmp(e->key, key, key_size);
+}
+
+static void split_free_entry(void *ptr, void *arg) {
+  split_entry_t *e = ptr;
+  split_ht_t *t = arg;
+  if (t->free_data) t->free_data(e->data);
+  free(e);
+}
+
+/*
+ * Called by the one thread whose CAS unlinked the node, an online reader:
+ * the entry carries its own qsbr record so that retiring can neither fail
+ * nor fall back to waiting for a grace period, which would wait for the
+ * caller itself.
+ */
+static void split_retire(split_ht_t *t, struct split_node *n) {
+  split_entry_t *e = (split_entry_t *)n;
+  qsbr_defer_cb(t->qsbr, &e->rcu, split_free_entry, e, t);
+}
+
+/*
+ * Find the first node >= (so_key, key) after 'start', unlinking deleted
+ * nodes on the way. On return *prev is the link that pointed to *cur.
+ * Returns true if *cur is the target.
+ */
+static bool split_find(split_ht_t *t, struct split_node *start, u64 so_key, const void *key, uint8_t key_size,
+                       uintptr_t **prev_out, struct split_node **cur_out) {
+retry:;
+  uintptr_t *prev = &start->next;
+  struct split_node *cur = split_ptr(__atomic_load_n(prev, __ATOMIC_ACQUIRE));
+
+  while (cur) {
+    uintptr_t next = __atomic_load_n(&cur->next, __ATOMIC_ACQUIRE);
+    if (next & SPLIT_MARK) {
+      // fails if prev itself got deleted or changed, start over then
+      if (!split_cas(prev, (uintptr_t)cur, next & ~SPLIT_MARK)) goto retry;
+      split_retire(t, cur);
+      cur = split_ptr(next);
+      continue;
+    }
+    int c = split_cmp(cur, so_key, key, key_size);
+    if (c >= 0) {
+      *prev_out = prev;
+      *cur_out = cur;
+      return c == 0;
+    }
+    prev = &cur->next;
+    cur = split_ptr(next);
+  }
+  *prev_out = prev;
+  *cur_out = NULL;
+  return false;
+}
+
+// link 'node' after 'start', returns NULL or the node already holding the same key
+static struct split_node *split_insert(split_ht_t *t, struct split_node *start, struct split_node *node,
+                                       const void *key, uint8_t key_size) {
+  uintptr_t *prev;
+  struct split_node *cur;
+
+  for (;;) {
+    if (split_find(t, start, node->so_key, key, key_size, &prev, &cur)) return cur;
+    node->next = (uintptr_t)cur;
+    if (split_cas(prev, (uintptr_t)cur, (uintptr_t)node)) return NULL;
+  }
+}
+
+static struct split_node **split_segment(split_ht_t *t, size_t seg_idx) {
+  struct split_node **seg = __atomic_load_n(&t->dir[seg_idx], __ATOMIC_ACQUIRE);
+  if (seg) return seg;
+
+  seg = calloc(SPLIT_SEGMENT_SIZE, sizeof(struct split_node *));
+  if (!seg) return NULL;
+  struct split_node **expected = NULL;
+  if (!__atomic_compare_exchange_n(&t->dir[seg_idx], &expected, seg, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(seg); // another thread installed it first
+    seg = expected;
+  }
+  return seg;
+}
+
+static struct split_node *split_bucket(split_ht_t *t, size_t bkt);
+
+/*
+ * Insert the dummy of 'bkt' behind the dummy of its parent (bkt without its
+ * highest bit), which holds all of its entries until the split. Racing
+ * initializers agree on one dummy since the list rejects duplicates.
+ * On memory shortage the parent dummy is returned: starting from there is
+ * slower but still correct.
+ */
+static struct split_node *split_init_bucket(split_ht_t *t, size_t bkt) {
+  size_t parent = bkt & ~((size_t)1 << ilog2(bkt));
+  struct split_node *pnode = split_bucket(t, parent);
+
+  struct split_node **seg = split_segment(t, bkt >> SPLIT_SEGMENT_BITS);
+  struct split_node *dummy = malloc(sizeof(struct split_node));
+  if (!seg || !dummy) {
+    free(dummy);
+    return pnode;
+  }
+  dummy->so_key = split_so_dummy(bkt);
+
+  struct split_node *existing = split_insert(t, pnode, dummy, NULL, 0);
+  if (existing) {
+    free(dummy); // never published
+    dummy = existing;
+  }
+  __atomic_store_n(&seg[bkt & (SPLIT_SEGMENT_SIZE - 1)], dummy, __ATOMIC_RELEASE);
+  return dummy;
+}
+
+// dummy of an initialized bucket, NULL if the bucket was not used yet
+static inline struct split_node *split_dummy(split_ht_t *t, size_t bkt) {
+  if (bkt == 0) return &t->head;
+  struct split_node **seg = __atomic_load_n(&t->dir[bkt >> SPLIT_SEGMENT_BITS], __ATOMIC_ACQUIRE);
+  return seg ? __atomic_load_n(&seg[bkt & (SPLIT_SEGMENT_SIZE - 1)], __ATOMIC_ACQUIRE) : NULL;
+}
+
+static struct split_node *split_bucket(split_ht_t *t, size_t bkt) {
+  struct split_node *dummy = split_dummy(t, bkt);
+  return dummy ? dummy : split_init_bucket(t, bkt);
+}
+
+static inline struct split_node *split_start(split_ht_t *t, u64 hash) {
+  return split_bucket(t, hash & (split_ht_size(t) - 1));
+}
+
+/*
+ * Read-only split_start(): an uninitialized bucket's entries still sit
+ * behind the dummy of its nearest initialized ancestor, so start there
+ * instead of inserting the missing dummy.
+ */
+static inline struct split_node *split_lookup_start(split_ht_t *t, u64 hash) {
+  size_t bkt = hash & (split_ht_size(t) - 1);
+  struct split_node *dummy;
+
+  while (!(dummy = split_dummy(t, bkt)))
+    bkt &= ~((size_t)1 << ilog2(bkt));
+  return dummy;
+}
+
+/**
+ * split_ht_create - create a split-ordered hash table
+ * @size: initial bucket count, rounded up to a power of two, 0 for 2
+ * @max_load: average entries per bucket that make the table double, 0 for SPLIT_DEFAULT_LOAD
+ * @q: qsbr domain all threads using the table are registered with
+ * @free_data: called on the data of deleted entries after a grace period, may be NULL
+ *
+ * Returns the new table or NULL on failure.
+ */
+split_ht_t *split_ht_create(size_t size, uint32_t max_load, qsbr_t *q, void (*free_data)(void *)) {
+  if (!q || size > SPLIT_MAX_BUCKETS) return NULL;
+  if (size < 2) size = 2;
+  if (size & (size - 1)) size = (size_t)1 << (ilog2(size) + 1);
+
+  split_ht_t *t = malloc(sizeof(split_ht_t));
+  if (!t) return NULL;
+
+  // lazily zeroed, only the segment pointers that get used are touched
+  t->dir = ht_mem_zalloc(SPLIT_DIR_BYTES, 0, &t->dir_mem);
+  if (!t->dir) {
+    free(t);
+    return NULL;
+  }
+  t->head.next = 0;
+  t->head.so_key = 0;
+  t->max_load = max_load ? max_load : SPLIT_DEFAULT_LOAD;
+  t->size = size;
+  t->count = 0;
+  t->qsbr = q;
+  t->free_data = free_data;
+  return t;
+}
+
+// free the table with all entries; no thread may use it and none of q's readers may be online
+void split_ht_free(split_ht_t *t) {
+  if (!t) return;
+  qsbr_synchronize(t->qsbr); // entries retired earlier reference t
+
+  struct split_node *n = split_ptr(t->head.next);
+  while (n) {
+    struct split_node *next = split_ptr(n->next);
+    if (n->so_key & 1)
+      split_free_entry(n, t);
+    else
+      free(n);
+    n = next;
+  }
+  for (size_t i = 0; i < ((size_t)1 << SPLIT_DIR_BITS); i++)
+    free(t->dir[i]);
+  ht_mem_free(t->dir, SPLIT_DIR_BYTES, t->dir_mem);
+  free(t);
+}
+
+/**
+ * split_ht_add - insert a key
+ * @t: table
+ * @data: data to store, owned by the table once added
+ * @key: the key, copied into the entry
+ * @key_size: its size
+ *
+ * Returns 0 on success, 1 if the key is already present (@data stays with
+ * the caller) or -1 if memory ran out.
+ */
+int split_ht_add(split_ht_t *t, void *data, const void *key, uint8_t key_size) {
+  if (!t) return -1;
+  u64 hash = hash64_str((char *)key, key_size);
+
+  split_entry_t *e = malloc(sizeof(split_entry_t) + key_size);
+  if (!e) return -1;
+  e->node.so_key = split_so_regular(hash);
+  e->data = data;
+  e->key_size = key_size;
+  memcpy(e->key, key, key_size);
+
+  if (split_insert(t, split_start(t, hash), &e->node, key, key_size)) {
+    free(e);
+    return 1;
+  }
+
+  // lock-free resize: double the bucket count, new buckets are split on first use
+  size_t count = __atomic_add_fetch(&t->count, 1, __ATOMIC_RELAXED);
+  size_t size = split_ht_size(t);
+  if (count / size >= t->max_load && size < SPLIT_MAX_BUCKETS)
+    __atomic_compare_exchange_n(&t->size, &size, size * 2, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  return 0;
+}
+
+// returns 0 if the key was deleted, 1 if it was not found
+int split_ht_del(split_ht_t *t, const void *key, uint8_t key_size) {
+  if (!t) return 1;
+  u64 hash = hash64_str((char *)key, key_size);
+  u64 so_key = split_so_regular(hash);
+  struct split_node *start = split_start(t, hash);
+  uintptr_t *prev;
+  struct split_node *cur;
+
+  for (;;) {
+    if (!split_find(t, start, so_key, key, key_size, &prev, &cur)) return 1;
+    uintptr_t next = __atomic_load_n(&cur->next, __ATOMIC_ACQUIRE);
+    // the mark decides which deleter wins
+    if ((next & SPLIT_MARK) || !split_cas(&cur->next, next, next | SPLIT_MARK)) continue;
+
+    __atomic_sub_fetch(&t->count, 1, __ATOMIC_RELAXED);
+    if (split_cas(prev, (uintptr_t)cur, next))
+      split_retire(t, cur);
+    else
+      split_find(t, start, so_key, key, key_size, &prev, &cur); // lost a race, let find unlink it
+    return 0;
+  }
+}
+
+/**
+ * split_ht_get - look up a key
+ * @t: table
+ * @key: the key
+ * @key_size: its size
+ *
+ * Only loads, never writes shared memory: a bucket not initialized yet is
+ * searched from its nearest initialized parent, the dummy is left for the
+ * next insert or delete to add. The returned data stays valid
+ * until the caller's next qsbr_quiescent().
+ * Returns the data or NULL if the key is not present.
+ */
+void *split_ht_get(split_ht_t *t, const void *key, uint8_t key_size) {
+  if (!t) return NULL;
+  u64 hash = hash64_str((char *)key, key_size);
+  u64 so_key = split_so_regular(hash);
+  struct split_node *cur = split_ptr(__atomic_load_n(&split_lookup_start(t, hash)->next, __ATOMIC_ACQUIRE));
+
+  while (cur) {
+    uintptr_t next = __atomic_load_n(&cur->next, __ATOMIC_ACQUIRE);
+    int c = split_cmp(cur, so_key, key, key_size);
+    if (c > 0) break;
+    if (c == 0) return next & SPLIT_MARK ? NULL : ((split_entry_t *)cur)->data;
+    cur = split_ptr(next);
+  }
+  return NULL;
+}
@@ -0,0 +1,71 @@
+/*
+ * Lock-free split-ordered list hash table (Shalev & Shavit)
+ *
+ * All entries live in one lock-free sorted linked list (Harris/Michael,
+ * deletion marks in the low bit of 'next'). They are sorted by the bit
+ * reversed hash, so the entries of bucket b are followed by those of
+ * bucket b + size after a doubling: resizing never moves an entry, it only
+ * adds a dummy node per new bucket, lazily, when the bucket is first used.
+ * The bucket directory is a table of lazily allocated segments.
+ *
+ * Inserts and deletes are lock-free, lookups only load. Unlinked entries
+ * are reclaimed through QSBR, so every thread using a table must be an
+ * online reader of its qsbr_t and pass quiescent states regularly.
+ */
+
+#ifndef __SPLIT_HT_H__
+#define __SPLIT_HT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+#include "qsbr.h"
+
+#define SPLIT_SEGMENT_BITS 10 // buckets per directory segment (log2)
+#define SPLIT_DIR_BITS 16     // directory segments (log2)
+#define SPLIT_MAX_BUCKETS ((size_t)1 << (SPLIT_SEGMENT_BITS + SPLIT_DIR_BITS))
+#define SPLIT_DEFAULT_LOAD 2 // average entries per bucket before the bucket count doubles
+
+#define SPLIT_MARK 1UL // low bit of split_node.next: node is logically deleted
+
+struct split_node {
+  uintptr_t next; // next node in split order, SPLIT_MARK once deleted
+  u64 so_key;     // bit reversed hash, low bit set for entries and clear for bucket dummies
+};
+
+typedef struct split_entry {
+  struct split_node node;
+  struct qsbr_cb rcu; // reclamation record, deleting never allocates
+  void *data;
+  uint8_t key_size;
+  uint8_t key[]; // the key is stored inline
+} split_entry_t;
+
+typedef struct split_ht {
+  struct split_node head; // dummy of bucket 0, start of the list
+  struct split_node ***dir; // segment table, 1 << SPLIT_DIR_BITS lazily allocated segments
+  uint32_t dir_mem;         // HT_MEM_* backing of dir
+  uint32_t max_load;        // entries per bucket that trigger a doubling
+  size_t size;              // bucket count, a power of two, only grows
+  size_t count;             // number of entries
+  qsbr_t *qsbr;             // reclamation domain of all users
+  void (*free_data)(void *);
+} split_ht_t;
+
+split_ht_t *split_ht_create(size_t size, uint32_t max_load, qsbr_t *q, void (*free_data)(void *));
+void split_ht_free(split_ht_t *t);
+
+int split_ht_add(split_ht_t *t, void *data, const void *key, uint8_t key_size);
+int split_ht_del(split_ht_t *t, const void *key, uint8_t key_size);
+void *split_ht_get(split_ht_t *t, const void *key, uint8_t key_size);
+
+static inline size_t split_ht_count(const split_ht_t *t) {
+  return __atomic_load_n(&t->count, __ATOMIC_RELAXED);
+}
+
+static inline size_t split_ht_size(const split_ht_t *t) {
+  return __atomic_load_n(&t->size, __ATOMIC_RELAXED);
+}
+
+#endif
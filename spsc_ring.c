@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "mock_mem_functions.h"
+#include "spsc_ring.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+/**
+ * spsc_ring_create - create an SPSC ring
+ * @capacity: number of slots, rounded up to a power of two, at least 2
+ *
+ * Returns the new ring or NULL on failure.
+ */
+spsc_ring_t *spsc_ring_create(size_t capacity) {
+  if (capacity < 2) capacity = 2;
+  if (capacity > SIZE_MAX / 2 / sizeof(void *)) return NULL;
+  size_t cap = 2;
+  while (cap < capacity)
+    cap <<= 1;
+
+  void *mem;
+  // producer and consumer counters on separate cache lines
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(spsc_ring_t))) return NULL;
+  spsc_ring_t *r = mem;
+  r->slots = malloc(cap * sizeof(void *));
+  if (!r->slots) {
+    free(r);
+    return NULL;
+  }
+  r->mask = cap - 1;
+  r->tail = r->head_cache = 0;
+  r->head = r->tail_cache = 0;
+  return r;
+}
+
+// free the ring, queued pointers are not touched
+void spsc_ring_free(spsc_ring_t *r) {
+  if (!r) return;
+  free(r->slots);
+  free(r);
+}
+
+/**
+ * spsc_ring_enqueue_bulk - add up to @n pointers, producer only
+ * @r: ring
+ * @items: pointers to add, in order
+ * @n: number of them
+ *
+ * The whole batch is published with a single release store of the tail.
+ * Returns the number of pointers added, less than @n if the ring filled up.
+ */
+size_t spsc_ring_enqueue_bulk(spsc_ring_t *r, void *const *items, size_t n) {
+  size_t tail = r->tail, cap = r->mask + 1;
+  size_t room = cap - (tail - r->head_cache);
+  if (room < n) {
+    r->head_cache = smp_load_acquire(&r->head);
+    room = cap - (tail - r->head_cache);
+  }
+  if (n > room) n = room;
+  if (!n) return 0;
+
+  // at most two contiguous runs
+  size_t idx = tail & r->mask, first = cap - idx < n ? cap - idx : n;
+  memcpy(&r->slots[idx], items, first * sizeof(void *));
+  memcpy(r->slots, items + first, (n - first) * sizeof(void *));
+  smp_store_release(&r->tail, tail + n);
+  return n;
+}
+
+/**
+ * spsc_ring_dequeue_bulk - take up to @n pointers, consumer only
+ * @r: ring
+ * @items: array receiving the pointers, in order
+ * @n: its size
+ *
+ * Returns the number of pointers taken, 0 if the ring is empty.
+ */
+size_t spsc_ring_dequeue_bulk(spsc_ring_t *r, void **items, size_t n) {
+  size_t head = r->head, cap = r->mask + 1;
+  size_t avail = r->tail_cache - head;
+  if (avail < n) {
+    r->tail_cache = smp_load_acquire(&r->tail);
+    avail = r->tail_cache - head;
+  }
+  if (n > avail) n = avail;
+  if (!n) return 0;
+
+  size_t idx = head & r->mask, first = cap - idx < n ? cap - idx : n;
+  memcpy(items, &r->slots[idx], first * sizeof(void *));
+  memcpy(items + first, r->slots, (n - first) * sizeof(void *));
+  smp_store_release(&r->head, head + n);
+  return n;
+}
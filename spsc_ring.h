@@ -0,0 +1,77 @@
+/*
+ * Lock-free single-producer/single-consumer bounded ring of pointers
+ *
+ * Head and tail are free-running counters on cache lines of their own, so
+ * the producer and the consumer never write the same line. Each side also
+ * keeps a private copy of the other side's counter and only reloads the
+ * shared one when the copy says the ring is full (producer) or empty
+ * (consumer), which makes the common case free of cross-core traffic.
+ * Exactly one thread may enqueue and exactly one may dequeue at a time.
+ */
+
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ht_lock.h"
+
+typedef struct spsc_ring {
+  // producer side
+  size_t tail __attribute__((aligned(HT_CACHELINE_SIZE))); // next slot to fill
+  size_t head_cache;                                       // producer's last view of head
+  // consumer side
+  size_t head __attribute__((aligned(HT_CACHELINE_SIZE))); // next slot to drain
+  size_t tail_cache;                                       // consumer's last view of tail
+  // read-only after creation
+  void **slots __attribute__((aligned(HT_CACHELINE_SIZE)));
+  size_t mask; // capacity - 1
+} spsc_ring_t;
+
+spsc_ring_t *spsc_ring_create(size_t capacity);
+void spsc_ring_free(spsc_ring_t *r);
+
+/*
+ * spsc_ring_enqueue - add one pointer, producer only
+ * Returns 0 or -1 if the ring is full.
+ */
+static inline int spsc_ring_enqueue(spsc_ring_t *r, void *data) {
+  size_t tail = r->tail;
+  if (tail - r->head_cache > r->mask) {
+    r->head_cache = smp_load_acquire(&r->head);
+    if (tail - r->head_cache > r->mask) return -1;
+  }
+  r->slots[tail & r->mask] = data;
+  smp_store_release(&r->tail, tail + 1); // publishes the slot
+  return 0;
+}
+
+/*
+ * spsc_ring_dequeue - take one pointer, consumer only
+ * Returns 0 and stores the pointer in '*data' or returns -1 if the ring is empty.
+ */
+static inline int spsc_ring_dequeue(spsc_ring_t *r, void **data) {
+  size_t head = r->head;
+  if (head == r->tail_cache) {
+    r->tail_cache = smp_load_acquire(&r->tail);
+    if (head == r->tail_cache) return -1;
+  }
+  *data = r->slots[head & r->mask];
+  smp_store_release(&r->head, head + 1); // hands the slot back
+  return 0;
+}
+
+size_t spsc_ring_enqueue_bulk(spsc_ring_t *r, void *const *items, size_t n);
+size_t spsc_ring_dequeue_bulk(spsc_ring_t *r, void **items, size_t n);
+
+// number of queued pointers, exact only when called by the producer or the consumer while the other side is idle
+static inline size_t spsc_ring_count(const spsc_ring_t *r) {
+  return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+}
+
+static inline size_t spsc_ring_capacity(const spsc_ring_t *r) {
+  return r->mask + 1;
+}
+
+#endif
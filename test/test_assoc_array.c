@@ -1,6 +1,7 @@
 #include <string.h>
 
 #include "assoc_array.h"
+#include "ht_mem.h"
 #include "unity.h"
 
 #include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
@@ -302,6 +303,255 @@ void test_array_create_get_first_get_last_with_multiple_entries_free(void) {
   test_array_free_non_empty();
 }
 
+void test_array_create_unordered_add_del_free(void) {
+  arr = array_create_ex(10, ARRAY_UNORDERED, free_entry, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  TEST_ASSERT_EQUAL_UINT32(ARRAY_ENTRY_SIZE_UNORDERED, arr->entry_size);
+  TEST_ASSERT_TRUE(arr->entry_size < sizeof(assoc_array_entry_t));
+
+  char key[30];
+  for (int i = 0; i < 20; ++i) {
+    snprintf(key, sizeof(key), "key%d", i);
+    char *dynamic_data = malloc(16);
+    snprintf(dynamic_data, 16, "data%d", i);
+    TEST_ASSERT_EQUAL_INT(0, array_add(arr, dynamic_data, key, strlen(key) + 1));
+  }
+  TEST_ASSERT_EQUAL_UINT32(20, arr->size);
+
+  // insertion order is not tracked
+  TEST_ASSERT_NULL(array_get_first(arr));
+  TEST_ASSERT_NULL(array_get_last(arr));
+  TEST_ASSERT_EQUAL_INT(-1, array_del_first(arr));
+  TEST_ASSERT_EQUAL_INT(-1, array_del_last(arr));
+
+  assoc_array_entry_t *entry = array_get_by_key(arr, "key7", sizeof("key7"));
+  TEST_ASSERT_NOT_NULL(entry);
+  TEST_ASSERT_EQUAL_STRING("data7", entry->data);
+
+  TEST_ASSERT_EQUAL_INT(0, array_del(arr, "key7", sizeof("key7")));
+  TEST_ASSERT_NULL(array_get_by_key(arr, "key7", sizeof("key7")));
+  TEST_ASSERT_EQUAL_UINT32(19, arr->size);
+
+  // cleanup
+  test_array_free_non_empty();
+}
+
+void test_array_get_by_key_prefix(void) {
+  // a single bucket, every key collides with every other one
+  arr = array_create(0, free_entry, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  TEST_ASSERT_EQUAL_INT(0, array_add(arr, strdup("long"), "key_long", 8));
+  TEST_ASSERT_EQUAL_INT(0, array_add(arr, strdup("short"), "key", 3));
+
+  // equal bytes up to the shorter size are not a match, sizes must agree too
+  assoc_array_entry_t *entry = array_get_by_key(arr, "key", 3);
+  TEST_ASSERT_NOT_NULL(entry);
+  TEST_ASSERT_EQUAL_STRING("short", entry->data);
+  entry = array_get_by_key(arr, "key_long", 8);
+  TEST_ASSERT_NOT_NULL(entry);
+  TEST_ASSERT_EQUAL_STRING("long", entry->data);
+  TEST_ASSERT_NULL(array_get_by_key(arr, "key_", 4));
+  TEST_ASSERT_NULL(array_get_by_key(arr, "key_long_x", 10));
+
+  // cleanup
+  test_array_free_non_empty();
+}
+
+void test_array_hashed(void) {
+  arr = array_create(10, free_entry, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  u64 hash = hash64_str("key1", sizeof("key1"));
+
+  // a caller provided hash lands where the plain functions hash the key to
+  TEST_ASSERT_EQUAL_INT(0, array_add_hashed(arr, hash, strdup("data1"), "key1", sizeof("key1")));
+  TEST_ASSERT_EQUAL_STRING("data1", array_get_by_key(arr, "key1", sizeof("key1"))->data);
+  TEST_ASSERT_EQUAL_INT(0, array_add(arr, strdup("data2"), "key2", sizeof("key2")));
+  assoc_array_entry_t *entry = array_get_by_key_hashed(arr, hash64_str("key2", sizeof("key2")), "key2", sizeof("key2"));
+  TEST_ASSERT_NOT_NULL(entry);
+  TEST_ASSERT_EQUAL_STRING("data2", entry->data);
+
+  TEST_ASSERT_EQUAL_INT(0, array_add_replace_hashed(arr, hash, strdup("data3"), "key1", sizeof("key1")));
+  TEST_ASSERT_EQUAL_UINT32(2, arr->size);
+  TEST_ASSERT_EQUAL_STRING("data3", array_get_by_key_hashed(arr, hash, "key1", sizeof("key1"))->data);
+
+  TEST_ASSERT_EQUAL_INT(0, array_del_hashed(arr, hash, "key1", sizeof("key1")));
+  TEST_ASSERT_EQUAL_INT(1, array_del_hashed(arr, hash, "key1", sizeof("key1")));
+  TEST_ASSERT_NULL(array_get_by_key(arr, "key1", sizeof("key1")));
+
+  // cleanup
+  test_array_free_non_empty();
+}
+
+void test_array_create_size_add_get_free(void) {
+  const uint32_t size = 777;
+  TEST_ASSERT_NULL(array_create_size(0, 0, free_entry, NULL));
+
+  arr = array_create_size(size, 0, free_entry, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  TEST_ASSERT_EQUAL_UINT32(size, arr->ht->size);
+
+  char key[30];
+  for (int i = 0; i < 2000; ++i) {
+    snprintf(key, sizeof(key), "key%d", i);
+    char *dynamic_data = malloc(16);
+    snprintf(dynamic_data, 16, "data%d", i);
+    TEST_ASSERT_EQUAL_INT(0, array_add(arr, dynamic_data, key, strlen(key) + 1));
+  }
+  for (int i = 0; i < 2000; ++i) {
+    char expected[16];
+    snprintf(key, sizeof(key), "key%d", i);
+    snprintf(expected, sizeof(expected), "data%d", i);
+    assoc_array_entry_t *entry = array_get_by_key(arr, key, strlen(key) + 1);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_STRING(expected, entry->data);
+  }
+  TEST_ASSERT_EQUAL_INT(0, array_del(arr, "key5", sizeof("key5")));
+  TEST_ASSERT_NULL(array_get_by_key(arr, "key5", sizeof("key5")));
+
+  // cleanup
+  test_array_free_non_empty();
+}
+
+static void free_pooled_entry(void *entry) {
+  assoc_array_entry_t *assoc_entry = (assoc_array_entry_t *)entry;
+  free(assoc_entry->data);
+  free(assoc_entry->key);
+}
+
+static void add_numbered(assoc_array_t *a, int from, int to) {
+  char key[30];
+  for (int i = from; i < to; ++i) {
+    snprintf(key, sizeof(key), "key%d", i);
+    char *dynamic_data = malloc(16);
+    snprintf(dynamic_data, 16, "data%d", i);
+    TEST_ASSERT_EQUAL_INT(0, array_add(a, dynamic_data, key, strlen(key) + 1));
+  }
+}
+
+void test_array_create_pool_add_del_free(void) {
+  arr = array_create_ex(8, ARRAY_POOL | HT_NODE(0), free_pooled_entry, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  TEST_ASSERT_NOT_NULL(arr->pool);
+  TEST_ASSERT_EQUAL_UINT32(0, arr->pool->opts & HT_MEM_OPT_INTERLEAVE);
+
+  add_numbered(arr, 0, 3000);
+  TEST_ASSERT_EQUAL_size_t(3000, arr->pool->count);
+  TEST_ASSERT_EQUAL_STRING("data0", array_get_first(arr)->data);
+  TEST_ASSERT_EQUAL_STRING("data2999", array_get_last(arr)->data);
+
+  // released entries are reused before the pool grows
+  size_t capacity = arr->pool->capacity;
+  TEST_ASSERT_EQUAL_INT(0, array_del(arr, "key7", sizeof("key7")));
+  TEST_ASSERT_EQUAL_INT(0, array_del_first(arr));
+  TEST_ASSERT_EQUAL_size_t(2998, arr->pool->count);
+  add_numbered(arr, 3000, 3002);
+  TEST_ASSERT_EQUAL_size_t(capacity, arr->pool->capacity);
+  TEST_ASSERT_NULL(array_get_by_key(arr, "key7", sizeof("key7")));
+  TEST_ASSERT_EQUAL_STRING("data3001", array_get_by_key(arr, "key3001", sizeof("key3001"))->data);
+
+  TEST_ASSERT_EQUAL_INT(0, array_free(arr));
+  arr = NULL;
+
+  // default free_entry of a pooled array leaves the entry to the pool
+  arr = array_create_ex(4, ARRAY_POOL | ARRAY_UNORDERED, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  TEST_ASSERT_EQUAL_size_t(MEMPOOL_ALIGN * 3, arr->pool->obj_size);
+  add_numbered(arr, 0, 100);
+  TEST_ASSERT_EQUAL_INT(0, array_del(arr, "key1", sizeof("key1")));
+  TEST_ASSERT_EQUAL_INT(0, array_free(arr));
+  arr = NULL;
+}
+
+void test_array_replicate(void) {
+  assoc_array_t *src = array_create_size(500, 0, free_entry, NULL);
+  TEST_ASSERT_NOT_NULL(src);
+  add_numbered(src, 0, 1000);
+
+  array_replicas_t *r = array_replicate(src);
+  TEST_ASSERT_NOT_NULL(r);
+  TEST_ASSERT_EQUAL_INT(ht_numa_nodes(), r->nodes);
+
+  char *data = malloc(16);
+  strcpy(data, "extra");
+  TEST_ASSERT_EQUAL_INT(0, array_replicas_add(r, data, "extra", sizeof("extra")));
+  TEST_ASSERT_EQUAL_INT(0, array_replicas_del(r, "key10", sizeof("key10")));
+
+  for (int n = 0; n < r->nodes; n++) {
+    assoc_array_t *replica = r->replica[n];
+    TEST_ASSERT_EQUAL_size_t(src->size, replica->size);
+    TEST_ASSERT_EQUAL_size_t(src->ht->size, replica->ht->size);
+    // insertion order is kept and key and data are shared with the source
+    TEST_ASSERT_EQUAL_PTR(array_get_first(src)->data, array_get_first(replica)->data);
+    TEST_ASSERT_EQUAL_STRING("extra", array_get_last(replica)->data);
+    assoc_array_entry_t *e = array_get_by_key(replica, "key500", sizeof("key500"));
+    TEST_ASSERT_NOT_NULL(e);
+    TEST_ASSERT_EQUAL_PTR(array_get_by_key(src, "key500", sizeof("key500"))->key, e->key);
+    TEST_ASSERT_NULL(array_get_by_key(replica, "key10", sizeof("key10")));
+  }
+  assoc_array_t *local = array_replica_local(r);
+  TEST_ASSERT_NOT_NULL(array_get_by_key(local, "key999", sizeof("key999")));
+
+  array_replicas_free(r);
+  TEST_ASSERT_EQUAL_INT(0, array_free(src));
+}
+
+static int free_calls;
+
+static void counting_free(void *ptr) {
+  free_calls++;
+  free(ptr);
+}
+
+void test_array_create_stable(void) {
+  const size_t capacity = 5000;
+  static char datas[5000][8];
+  char key[30];
+
+  TEST_ASSERT_NULL(array_create_stable(0, 16, 0, NULL, NULL));
+  TEST_ASSERT_NULL(array_create_stable(capacity, 0, 0, NULL, NULL));
+
+  arr = array_create_stable(capacity, 16, 0, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  TEST_ASSERT_TRUE(arr->ht->mem & HT_MEM_PREFAULTED);
+  TEST_ASSERT_TRUE(arr->pool->chunks->mem & HT_MEM_PREFAULTED);
+  TEST_ASSERT_EQUAL_size_t(capacity, arr->pool->capacity);
+  printf("stable array locked: %s\n", arr->ht->mem & HT_MEM_LOCKED ? "yes" : "no (RLIMIT_MEMLOCK)");
+
+  // no allocator call while the array stays within capacity
+  free_calls = 0;
+  set_memory_functions(mock_malloc, calloc, realloc, counting_free);
+  for (size_t round = 0; round < 2; round++) {
+    for (size_t i = 0; i < capacity; i++) {
+      snprintf(key, sizeof(key), "key%zu", i);
+      TEST_ASSERT_EQUAL_INT(0, array_add(arr, datas[i], key, strlen(key) + 1));
+    }
+    TEST_ASSERT_EQUAL_STRING("key0", array_get_first(arr)->key);
+    for (size_t i = 0; i < capacity; i++) {
+      snprintf(key, sizeof(key), "key%zu", i);
+      assoc_array_entry_t *e = array_get_by_key(arr, key, strlen(key) + 1);
+      TEST_ASSERT_NOT_NULL(e);
+      TEST_ASSERT_EQUAL_PTR(datas[i], e->data);
+      TEST_ASSERT_EQUAL_INT(0, array_del(arr, key, strlen(key) + 1));
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(0, free_calls);
+  TEST_ASSERT_EQUAL_size_t(capacity, arr->pool->capacity);
+  // keys longer than max_key_size are refused up front
+  TEST_ASSERT_EQUAL_INT(-1, array_add(arr, datas[0], "a key that is far too long", sizeof("a key that is far too long")));
+  set_memory_functions(malloc, calloc, realloc, free);
+
+  // past capacity the pool grows
+  for (size_t i = 0; i <= capacity; i++) {
+    snprintf(key, sizeof(key), "key%zu", i);
+    TEST_ASSERT_EQUAL_INT(0, array_add(arr, datas[i % capacity], key, strlen(key) + 1));
+  }
+  TEST_ASSERT_TRUE(arr->pool->capacity > capacity);
+  TEST_ASSERT_EQUAL_INT(0, array_free(arr));
+  arr = NULL;
+
+  TEST_ASSERT_EQUAL_INT(-1, array_reserve(NULL, 10));
+}
+
 int main(void) {
   UNITY_BEGIN();
 
@@ -354,6 +604,13 @@ int main(void) {
 
   RUN_TEST(test_array_create_fill_half_capacity_del_free);
   RUN_TEST(test_array_create_get_first_get_last_with_multiple_entries_free);
+  RUN_TEST(test_array_create_unordered_add_del_free);
+  RUN_TEST(test_array_get_by_key_prefix);
+  RUN_TEST(test_array_hashed);
+  RUN_TEST(test_array_create_size_add_get_free);
+  RUN_TEST(test_array_create_pool_add_del_free);
+  RUN_TEST(test_array_replicate);
+  RUN_TEST(test_array_create_stable);
 
   return UNITY_END();
 }
@@ -0,0 +1,268 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "conc_array.h"
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+
+#include "unity.h"
+
+#define THREADS 4
+#define KEYS_PER_THREAD 20000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+struct worker {
+  pthread_t tid;
+  conc_array_t *c;
+  int id;
+  int errors;
+};
+
+static int make_key(char *buf, size_t len, int thread, int i) {
+  return snprintf(buf, len, "t%d-key%d", thread, i) + 1;
+}
+
+static int check_data(assoc_array_entry_t *entry, void *arg) {
+  return strcmp(entry->data, arg) != 0;
+}
+
+// every thread works on its own keys: add all, look them up, delete every other one
+static void *worker_run(void *arg) {
+  struct worker *w = arg;
+  char key[32];
+
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    char *data = strdup(key);
+    if (conc_array_add(w->c, data, key, len)) w->errors++;
+  }
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    if (conc_array_lookup(w->c, key, len, check_data, key) != 0) w->errors++;
+  }
+  for (int i = 0; i < KEYS_PER_THREAD; i += 2) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    if (conc_array_del(w->c, key, len) != 0) w->errors++;
+  }
+  return NULL;
+}
+
+// 'resize_bits' != 0 grows the table from the main thread while the workers run
+static void run_workers(uint32_t bits, uint32_t flags, uint32_t stripes, uint32_t resize_bits) {
+  conc_array_t *c = conc_array_create(bits, stripes, flags, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(c);
+  TEST_ASSERT_EQUAL_UINT32(0, c->stripes.mask & (c->stripes.mask + 1));
+  TEST_ASSERT_TRUE(c->stripes.mask < c->arr->ht->size);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)c->stripes.locks % HT_CACHELINE_SIZE);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)&c->list_lock % HT_CACHELINE_SIZE);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)&c->resize_lock % HT_CACHELINE_SIZE);
+
+  struct worker w[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    w[t] = (struct worker){.c = c, .id = t};
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&w[t].tid, NULL, worker_run, &w[t]));
+  }
+  if (resize_bits) {
+    TEST_ASSERT_EQUAL_INT(0, conc_array_resize(c, resize_bits));
+    TEST_ASSERT_TRUE(c->buckets >= (size_t)1 << resize_bits);
+  }
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(w[t].tid, NULL);
+    TEST_ASSERT_EQUAL_INT(0, w[t].errors);
+  }
+
+  TEST_ASSERT_EQUAL_size_t(THREADS * KEYS_PER_THREAD / 2, conc_array_size(c));
+  char key[32];
+  for (int t = 0; t < THREADS; t++) {
+    for (int i = 0; i < KEYS_PER_THREAD; i++) {
+      int len = make_key(key, sizeof(key), t, i);
+      TEST_ASSERT_EQUAL_INT(i % 2 ? 0 : -1, conc_array_lookup(c, key, len, NULL, NULL));
+    }
+  }
+  if (flags & CONC_ARRAY_GROW) TEST_ASSERT_TRUE(c->buckets >= THREADS * KEYS_PER_THREAD / (4 * CONC_ARRAY_MAX_LOAD));
+  TEST_ASSERT_EQUAL_INT(0, conc_array_free(c));
+}
+
+void test_conc_array_create_failed(void) {
+  TEST_ASSERT_NULL(conc_array_create(8, 0, ARRAY_POOL, NULL, NULL));
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(conc_array_create(8, 0, 0, NULL, NULL));
+  set_memory_functions(malloc, calloc, realloc, free);
+  TEST_ASSERT_EQUAL_INT(-1, conc_array_free(NULL));
+}
+
+void test_conc_array_spin_threads(void) {
+  run_workers(12, 0, 16, 0);
+}
+
+void test_conc_array_rwlock_threads(void) {
+  run_workers(12, CONC_ARRAY_RWLOCK | ARRAY_UNORDERED, 100, 0);
+}
+
+void test_conc_array_grow_threads(void) {
+  // a fixed size array caps the stripes to its buckets, a growing one starts with a bucket per stripe
+  conc_array_t *c = conc_array_create(2, 64, 0, NULL, NULL);
+  TEST_ASSERT_EQUAL_UINT32(3, c->stripes.mask);
+  TEST_ASSERT_EQUAL_INT(0, conc_array_free(c));
+  c = conc_array_create(2, 48, CONC_ARRAY_GROW, NULL, NULL);
+  TEST_ASSERT_EQUAL_UINT64(64, c->buckets);
+  TEST_ASSERT_EQUAL_UINT32(63, c->stripes.mask);
+  TEST_ASSERT_EQUAL_INT(0, conc_array_free(c));
+
+  // 4 stripes over 4 buckets, the table doubles many times under load
+  run_workers(2, CONC_ARRAY_GROW, 4, 0);
+  run_workers(2, CONC_ARRAY_GROW | CONC_ARRAY_RWLOCK | ARRAY_UNORDERED, 0, 0);
+}
+
+void test_conc_array_resize_threads(void) {
+  run_workers(4, 0, 8, 15);
+}
+
+void test_conc_array_replace(void) {
+  conc_array_t *c = conc_array_create(4, 1, 0, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(c);
+  TEST_ASSERT_EQUAL_INT(0, conc_array_add(c, strdup("one"), "key", sizeof("key")));
+  TEST_ASSERT_EQUAL_INT(0, conc_array_add_replace(c, strdup("two"), "key", sizeof("key")));
+  TEST_ASSERT_EQUAL_size_t(1, conc_array_size(c));
+  TEST_ASSERT_EQUAL_INT(0, conc_array_lookup(c, "key", sizeof("key"), check_data, "two"));
+  TEST_ASSERT_EQUAL_INT(1, conc_array_del(c, "nokey", sizeof("nokey")));
+  TEST_ASSERT_EQUAL_INT(0, conc_array_del(c, "key", sizeof("key")));
+  TEST_ASSERT_EQUAL_INT(0, conc_array_free(c));
+}
+
+static void *del_first_run(void *arg) {
+  conc_array_t *c = arg;
+  while (conc_array_del_first(c) == 0)
+    ;
+  return NULL;
+}
+
+void test_conc_array_del_first_threads(void) {
+  conc_array_t *c = conc_array_create(10, 8, 0, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(c);
+  char key[32];
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    int len = make_key(key, sizeof(key), 0, i);
+    conc_array_add(c, strdup(key), key, len);
+  }
+  TEST_ASSERT_EQUAL_INT(0, conc_array_del_last(c));
+  TEST_ASSERT_EQUAL_INT(-1, conc_array_lookup(c, "t0-key19999", sizeof("t0-key19999"), NULL, NULL));
+
+  // threads drain the list from the head concurrently
+  pthread_t tid[THREADS];
+  for (int t = 0; t < THREADS; t++)
+    pthread_create(&tid[t], NULL, del_first_run, c);
+  for (int t = 0; t < THREADS; t++)
+    pthread_join(tid[t], NULL);
+
+  TEST_ASSERT_EQUAL_size_t(0, conc_array_size(c));
+  TEST_ASSERT_TRUE(k_list_empty(&c->arr->list));
+  TEST_ASSERT_EQUAL_INT(-1, conc_array_del_first(c));
+  TEST_ASSERT_EQUAL_INT(0, conc_array_free(c));
+}
+
+#define SEQ_KEYS 512
+
+struct seq_worker {
+  pthread_t tid;
+  conc_array_t *c;
+  int id;
+  volatile int *stop;
+  long reads;
+  int errors;
+};
+
+static uintptr_t seq_values[SEQ_KEYS];
+
+// writers own the keys with index % 2 == id and keep replacing and deleting them
+static void *seq_writer_run(void *arg) {
+  struct seq_worker *w = arg;
+  char key[32];
+  for (int round = 0; round < 202; round++) {
+    for (int i = w->id; i < SEQ_KEYS; i += 2) {
+      int len = make_key(key, sizeof(key), 0, i);
+      if (round % 4 == 3)
+        conc_array_del(w->c, key, len);
+      else
+        conc_array_add_replace(w->c, &seq_values[i], key, len);
+    }
+  }
+  return NULL;
+}
+
+// optimistic readers: any data found must be the value of the key looked up
+static void *seq_reader_run(void *arg) {
+  struct seq_worker *w = arg;
+  char key[32];
+  unsigned i = 0;
+  while (!__atomic_load_n(w->stop, __ATOMIC_RELAXED)) {
+    unsigned idx = i++ % SEQ_KEYS;
+    int len = make_key(key, sizeof(key), 0, idx);
+    void *data;
+    if (conc_array_get_data(w->c, key, len, &data) == 0 && data != &seq_values[idx]) w->errors++;
+    w->reads++;
+  }
+  return NULL;
+}
+
+void test_conc_array_seq_threads(void) {
+  TEST_ASSERT_NULL(conc_array_create_seq(8, 0, 0, 0, NULL, NULL));
+  conc_array_t *c = conc_array_create_seq(8, 16, 16, 0, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(c);
+  TEST_ASSERT_EQUAL_UINT32(HT_LOCK_SEQ, c->stripes.type);
+  TEST_ASSERT_EQUAL_INT(-1, conc_array_add(c, NULL, "a key longer than 16", sizeof("a key longer than 16")));
+  TEST_ASSERT_EQUAL_INT(-1, conc_array_resize(c, 10));
+
+  volatile int stop = 0;
+  struct seq_worker writers[2], readers[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    readers[t] = (struct seq_worker){.c = c, .stop = &stop};
+    pthread_create(&readers[t].tid, NULL, seq_reader_run, &readers[t]);
+  }
+  for (int t = 0; t < 2; t++) {
+    writers[t] = (struct seq_worker){.c = c, .id = t};
+    pthread_create(&writers[t].tid, NULL, seq_writer_run, &writers[t]);
+  }
+  for (int t = 0; t < 2; t++)
+    pthread_join(writers[t].tid, NULL);
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(readers[t].tid, NULL);
+    TEST_ASSERT_EQUAL_INT(0, readers[t].errors);
+    TEST_ASSERT_TRUE(readers[t].reads > 0);
+  }
+
+  // after the last round (a replace) every key is present, entries were recycled through the pool
+  TEST_ASSERT_EQUAL_size_t(SEQ_KEYS, conc_array_size(c));
+  TEST_ASSERT_EQUAL_size_t(SEQ_KEYS, c->arr->pool->count);
+  TEST_ASSERT_TRUE(c->arr->pool->capacity < 4 * SEQ_KEYS);
+  void *data;
+  char key[32];
+  int len = make_key(key, sizeof(key), 0, 7);
+  TEST_ASSERT_EQUAL_INT(0, conc_array_get_data(c, key, len, &data));
+  TEST_ASSERT_EQUAL_PTR(&seq_values[7], data);
+  TEST_ASSERT_EQUAL_INT(0, conc_array_del_first(c));
+  TEST_ASSERT_EQUAL_INT(0, conc_array_free(c));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_conc_array_create_failed);
+  RUN_TEST(test_conc_array_spin_threads);
+  RUN_TEST(test_conc_array_rwlock_threads);
+  RUN_TEST(test_conc_array_grow_threads);
+  RUN_TEST(test_conc_array_resize_threads);
+  RUN_TEST(test_conc_array_replace);
+  RUN_TEST(test_conc_array_del_first_threads);
+  RUN_TEST(test_conc_array_seq_threads);
+
+  return UNITY_END();
+}
@@ -41,8 +41,224 @@ void test_deque_create(void) {
     deq_free(deq); // Освобождение ресурсов деки
 }
 
+void test_deq_ring(void) {
+    deq_ring_t *r = deq_ring_create(0);
+    TEST_ASSERT_NOT_NULL(r);
+    TEST_ASSERT_EQUAL_size_t(DEQ_RING_MIN_CAPACITY - 1, r->mask);
+    TEST_ASSERT_NULL(deq_ring_pop_head(r));
+    TEST_ASSERT_NULL(deq_ring_get_tail(r));
+
+    // pushes at both ends wrap around and force several doublings
+    static int data[1000];
+    for (int i = 0; i < 500; i++) {
+        TEST_ASSERT_EQUAL_INT(0, deq_ring_push_tail(r, &data[500 + i]));
+        TEST_ASSERT_EQUAL_INT(0, deq_ring_push_head(r, &data[499 - i]));
+    }
+    TEST_ASSERT_EQUAL_size_t(1000, r->size);
+    TEST_ASSERT_EQUAL_size_t(1023, r->mask);
+    TEST_ASSERT_EQUAL_PTR(&data[0], deq_ring_get_head(r));
+    TEST_ASSERT_EQUAL_PTR(&data[999], deq_ring_get_tail(r));
+
+    size_t i;
+    void *p;
+    deq_ring_for_each(r, i, p) {
+        TEST_ASSERT_EQUAL_PTR(&data[i], p);
+    }
+
+    for (int i = 0; i < 400; i++) {
+        TEST_ASSERT_EQUAL_PTR(&data[i], deq_ring_pop_head(r));
+        TEST_ASSERT_EQUAL_PTR(&data[999 - i], deq_ring_pop_tail(r));
+    }
+    TEST_ASSERT_EQUAL_size_t(200, r->size);
+    TEST_ASSERT_EQUAL_PTR(&data[400], deq_ring_get(r, 0));
+    TEST_ASSERT_EQUAL_PTR(&data[599], deq_ring_get(r, 199));
+
+    // growing a wrapped ring keeps the order
+    deq_ring_t *w = deq_ring_create(8);
+    for (int i = 0; i < 6; i++) deq_ring_push_tail(w, &data[i]);
+    for (int i = 0; i < 4; i++) deq_ring_pop_head(w);
+    for (int i = 6; i < 20; i++) deq_ring_push_tail(w, &data[i]);
+    deq_ring_for_each(w, i, p) {
+        TEST_ASSERT_EQUAL_PTR(&data[4 + i], p);
+    }
+    TEST_ASSERT_EQUAL_size_t(16, w->size);
+
+    deq_ring_free(w);
+    deq_ring_free(r);
+}
+
+void test_deq_chunked(void) {
+    TEST_ASSERT_NULL(deq_chunked_create(0));
+    deq_chunked_t *d = deq_chunked_create(sizeof(int));
+    TEST_ASSERT_NOT_NULL(d);
+    TEST_ASSERT_EQUAL_INT(-1, deq_chunked_pop_head(d, NULL));
+    TEST_ASSERT_NULL(deq_chunked_get_head(d));
+
+    // elements keep their address while the deque grows at both ends
+    const int num = 5000;
+    int *first = deq_chunked_push_tail(d, &(int){0});
+    TEST_ASSERT_NOT_NULL(first);
+    for (int i = 1; i < num; i++) {
+        int v = i, neg = -i;
+        TEST_ASSERT_NOT_NULL(deq_chunked_push_tail(d, &v));
+        TEST_ASSERT_NOT_NULL(deq_chunked_push_head(d, &neg));
+    }
+    TEST_ASSERT_EQUAL_INT(0, *first);
+    TEST_ASSERT_EQUAL_size_t(2 * num - 1, d->size);
+    TEST_ASSERT_EQUAL_INT(-(num - 1), *(int *)deq_chunked_get_head(d));
+    TEST_ASSERT_EQUAL_INT(num - 1, *(int *)deq_chunked_get_tail(d));
+
+    // chunk by chunk traversal sees every element in order
+    size_t idx = 0, spans = 0;
+    int expect = -(num - 1);
+    while (idx < d->size) {
+        size_t n;
+        int *run = deq_chunked_span(d, idx, &n);
+        TEST_ASSERT_TRUE(n > 0 && n <= DEQ_CHUNK_ELEMS);
+        for (size_t k = 0; k < n; k++)
+            TEST_ASSERT_EQUAL_INT(expect++, run[k]);
+        idx += n;
+        spans++;
+    }
+    TEST_ASSERT_EQUAL_size_t(d->nchunks, spans);
+
+    int v;
+    for (int i = num - 1; i > 0; i--) {
+        TEST_ASSERT_EQUAL_INT(0, deq_chunked_pop_head(d, &v));
+        TEST_ASSERT_EQUAL_INT(-i, v);
+        TEST_ASSERT_EQUAL_INT(0, deq_chunked_pop_tail(d, &v));
+        TEST_ASSERT_EQUAL_INT(i, v);
+    }
+    TEST_ASSERT_EQUAL_size_t(1, d->size);
+    TEST_ASSERT_EQUAL_INT(0, *(int *)deq_chunked_get(d, 0));
+    TEST_ASSERT_EQUAL_size_t(1, d->nchunks);
+    // emptied chunks were recycled, at most DEQ_CHUNK_SPARE are kept
+    TEST_ASSERT_EQUAL_size_t(DEQ_CHUNK_SPARE, d->nspare);
+
+    TEST_ASSERT_EQUAL_INT(0, deq_chunked_pop_tail(d, NULL));
+    TEST_ASSERT_TRUE(deq_chunked_isempty(d));
+    TEST_ASSERT_EQUAL_size_t(0, d->nchunks);
+
+    // a queue that is refilled reuses the spare chunks
+    for (int i = 0; i < 3 * (int)DEQ_CHUNK_ELEMS; i++)
+        deq_chunked_push_tail(d, &i);
+    TEST_ASSERT_EQUAL_size_t(DEQ_CHUNK_SPARE - 3, d->nspare);
+
+    deq_chunked_free(d);
+}
+
+struct job {
+    int id;
+    struct k_list_head node;
+};
+
+void test_deq_intrusive(void) {
+    deq_t deq;
+    deq_init(&deq);
+    TEST_ASSERT_NULL(deq_pop_head_node(&deq));
+    TEST_ASSERT_NULL(deq_get_tail_node(&deq));
+
+    struct job jobs[10];
+    for (int i = 0; i < 10; i++) {
+        jobs[i].id = i;
+        if (i % 2)
+            deq_push_tail_node(&deq, &jobs[i].node);
+        else
+            deq_push_head_node(&deq, &jobs[i].node);
+    }
+    TEST_ASSERT_EQUAL_INT(10, deq.size);
+
+    // heads were pushed in reverse: 8 6 4 2 0 1 3 5 7 9
+    const int order[] = {8, 6, 4, 2, 0, 1, 3, 5, 7, 9};
+    struct job *pos;
+    int n = 0;
+    deq_for_each_entry(pos, &deq, node) {
+        TEST_ASSERT_EQUAL_INT(order[n++], pos->id);
+    }
+
+    // unlink from the middle, the node can be pushed again
+    deq_del_node(&deq, &jobs[0].node);
+    TEST_ASSERT_EQUAL_INT(9, deq.size);
+    deq_push_tail_node(&deq, &jobs[0].node);
+
+    TEST_ASSERT_EQUAL_PTR(&jobs[8], deq_pop_head_entry(&deq, struct job, node));
+    TEST_ASSERT_EQUAL_PTR(&jobs[0], deq_pop_tail_entry(&deq, struct job, node));
+    TEST_ASSERT_EQUAL_PTR(&jobs[6].node, deq_get_head_node(&deq));
+    TEST_ASSERT_EQUAL_PTR(&jobs[9].node, deq_get_tail_node(&deq));
+
+    struct job *tmp;
+    deq_for_each_entry_safe(pos, tmp, &deq, node) {
+        deq_del_node(&deq, &pos->node);
+    }
+    TEST_ASSERT_TRUE(deq_isempty(&deq));
+    TEST_ASSERT_NULL(deq_pop_tail_entry(&deq, struct job, node));
+}
+
+void test_deq_splice_batch(void) {
+    deq_t a, b;
+    deq_init(&a);
+    deq_init(&b);
+    struct job jobs[10];
+    for (int i = 0; i < 10; i++) {
+        jobs[i].id = i;
+        deq_push_tail_node(i < 6 ? &a : &b, &jobs[i].node);
+    }
+
+    // b is appended to a in one step and left empty
+    deq_splice_tail(&a, &b);
+    TEST_ASSERT_EQUAL_INT(10, a.size);
+    TEST_ASSERT_TRUE(deq_isempty(&b));
+    TEST_ASSERT_TRUE(k_list_empty(&b.list));
+    deq_splice_head(&b, &a);
+    TEST_ASSERT_EQUAL_INT(10, b.size);
+    deq_splice_tail(&b, &a); // empty source is a no-op
+    TEST_ASSERT_EQUAL_INT(10, b.size);
+
+    struct k_list_head *nodes[4];
+    TEST_ASSERT_EQUAL_INT(4, deq_pop_head_nodes(&b, nodes, 4));
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL_PTR(&jobs[i].node, nodes[i]);
+    TEST_ASSERT_EQUAL_INT(3, deq_pop_tail_nodes(&b, nodes, 3));
+    TEST_ASSERT_EQUAL_PTR(&jobs[9].node, nodes[0]);
+    TEST_ASSERT_EQUAL_PTR(&jobs[7].node, nodes[2]);
+    TEST_ASSERT_EQUAL_INT(3, b.size);
+    TEST_ASSERT_EQUAL_PTR(&jobs[4].node, deq_get_head_node(&b));
+    TEST_ASSERT_EQUAL_PTR(&jobs[6].node, deq_get_tail_node(&b));
+    TEST_ASSERT_EQUAL_INT(3, deq_pop_head_nodes(&b, nodes, 4));
+    TEST_ASSERT_TRUE(deq_isempty(&b));
+    TEST_ASSERT_TRUE(k_list_empty(&b.list));
+    TEST_ASSERT_EQUAL_INT(0, deq_pop_tail_nodes(&b, nodes, 4));
+
+    // deq_entry_t deques hand out the data and free the entries
+    deq_t *src = deque_create();
+    deq_t *dst = deque_create();
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(dst);
+    for (intptr_t i = 0; i < 5; i++)
+        deq_push_tail(src, (void *)i);
+    deq_push_tail(dst, (void *)100);
+    deq_splice_tail(dst, src);
+    TEST_ASSERT_EQUAL_INT(6, dst->size);
+
+    void *data[8];
+    TEST_ASSERT_EQUAL_INT(2, deq_pop_tail_batch(dst, data, 2));
+    TEST_ASSERT_EQUAL_PTR((void *)4, data[0]);
+    TEST_ASSERT_EQUAL_PTR((void *)3, data[1]);
+    TEST_ASSERT_EQUAL_INT(4, deq_pop_head_batch(dst, data, 8));
+    TEST_ASSERT_EQUAL_PTR((void *)100, data[0]);
+    TEST_ASSERT_EQUAL_PTR((void *)2, data[3]);
+    TEST_ASSERT_TRUE(deq_isempty(dst));
+    TEST_ASSERT_EQUAL_INT(0, deq_pop_head_batch(dst, data, 8));
+    deq_free(src);
+    deq_free(dst);
+}
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_deque_create);
+    RUN_TEST(test_deq_ring);
+    RUN_TEST(test_deq_chunked);
+    RUN_TEST(test_deq_intrusive);
+    RUN_TEST(test_deq_splice_batch);
     return UNITY_END();
 }
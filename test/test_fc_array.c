@@ -0,0 +1,137 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fc_array.h"
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+
+#include "unity.h"
+
+#define THREADS 4
+#define KEYS_PER_THREAD 20000
+#define HOT_KEYS 8
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+struct worker {
+  pthread_t tid;
+  fc_array_t *fc;
+  int id;
+  int errors;
+};
+
+static int make_key(char *buf, size_t len, int thread, int i) {
+  return snprintf(buf, len, "t%d-key%d", thread, i) + 1;
+}
+
+static int check_data(assoc_array_entry_t *entry, void *arg) {
+  return strcmp(entry->data, arg) != 0;
+}
+
+void test_fc_array_create_failed(void) {
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(fc_array_create(8, 0, NULL, NULL));
+  set_memory_functions(malloc, calloc, realloc, free);
+  TEST_ASSERT_EQUAL_INT(-1, fc_array_free(NULL));
+  TEST_ASSERT_EQUAL_INT(-1, fc_array_add(NULL, NULL, "key", sizeof("key")));
+}
+
+void test_fc_array_single(void) {
+  fc_array_t *fc = fc_array_create(4, 0, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(fc);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)&fc->slots % HT_CACHELINE_SIZE);
+  fc_slot_t *s = fc_array_register(fc);
+  TEST_ASSERT_NOT_NULL(s);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)s % HT_CACHELINE_SIZE);
+
+  TEST_ASSERT_EQUAL_INT(0, fc_array_add(s, strdup("one"), "key", sizeof("key")));
+  TEST_ASSERT_EQUAL_INT(0, fc_array_add(s, strdup("1"), "first", sizeof("first")));
+  TEST_ASSERT_EQUAL_INT(0, fc_array_add_replace(s, strdup("two"), "key", sizeof("key")));
+  TEST_ASSERT_EQUAL_size_t(2, fc_array_size(fc));
+  TEST_ASSERT_EQUAL_INT(0, fc_array_lookup(s, "key", sizeof("key"), check_data, "two"));
+  void *data;
+  TEST_ASSERT_EQUAL_INT(0, fc_array_get_data(s, "first", sizeof("first"), &data));
+  TEST_ASSERT_EQUAL_STRING("1", data);
+  TEST_ASSERT_EQUAL_INT(-1, fc_array_lookup(s, "nokey", sizeof("nokey"), NULL, NULL));
+  TEST_ASSERT_EQUAL_INT(1, fc_array_del(s, "nokey", sizeof("nokey")));
+
+  // insertion order: "first" is older than the replaced "key"
+  TEST_ASSERT_EQUAL_INT(0, fc_array_del_first(s));
+  TEST_ASSERT_EQUAL_INT(-1, fc_array_get_data(s, "first", sizeof("first"), &data));
+  TEST_ASSERT_EQUAL_INT(0, fc_array_del_last(s));
+  TEST_ASSERT_EQUAL_INT(-1, fc_array_del_last(s));
+  TEST_ASSERT_EQUAL_size_t(0, fc_array_size(fc));
+
+  // every request was combined by the caller itself
+  TEST_ASSERT_EQUAL_size_t(fc->combines, fc->combined);
+
+  fc_array_unregister(s);
+  TEST_ASSERT_EQUAL_PTR(s, fc_array_register(fc));
+  TEST_ASSERT_EQUAL_INT(0, fc_array_free(fc));
+}
+
+// own keys are added, checked and half deleted, a few shared hot keys are replaced all the time
+static void *worker_run(void *arg) {
+  struct worker *w = arg;
+  fc_slot_t *s = fc_array_register(w->fc);
+  char key[32];
+
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    if (fc_array_add(s, strdup(key), key, len)) w->errors++;
+    len = make_key(key, sizeof(key), -1, i % HOT_KEYS);
+    if (fc_array_add_replace(s, strdup(key), key, len)) w->errors++;
+  }
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    if (fc_array_lookup(s, key, len, check_data, key) != 0) w->errors++;
+    if (i % 2 == 0 && fc_array_del(s, key, len) != 0) w->errors++;
+  }
+  fc_array_unregister(s);
+  return NULL;
+}
+
+void test_fc_array_threads(void) {
+  fc_array_t *fc = fc_array_create(10, ARRAY_POOL, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(fc);
+
+  struct worker w[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    w[t] = (struct worker){.fc = fc, .id = t};
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&w[t].tid, NULL, worker_run, &w[t]));
+  }
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(w[t].tid, NULL);
+    TEST_ASSERT_EQUAL_INT(0, w[t].errors);
+  }
+
+  TEST_ASSERT_EQUAL_size_t(THREADS * KEYS_PER_THREAD / 2 + HOT_KEYS, fc_array_size(fc));
+  TEST_ASSERT_EQUAL_size_t((size_t)THREADS * KEYS_PER_THREAD * 3 + THREADS * KEYS_PER_THREAD / 2, fc->combined);
+  TEST_ASSERT_TRUE(fc->combines <= fc->combined);
+
+  fc_slot_t *s = fc_array_register(fc);
+  char key[32];
+  for (int t = 0; t < THREADS; t++) {
+    for (int i = 0; i < KEYS_PER_THREAD; i++) {
+      int len = make_key(key, sizeof(key), t, i);
+      TEST_ASSERT_EQUAL_INT(i % 2 ? 0 : -1, fc_array_lookup(s, key, len, NULL, NULL));
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(0, fc_array_free(fc));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_fc_array_create_failed);
+  RUN_TEST(test_fc_array_single);
+  RUN_TEST(test_fc_array_threads);
+
+  return UNITY_END();
+}
@@ -1,7 +1,11 @@
+#include <pthread.h>
 #include <string.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "hashtable.h"
+#include "ht_mem.h"
 #include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
 
 #include "unity.h"
@@ -13,6 +17,10 @@ void tearDown(void) {}
 void *mock_malloc(size_t size) {
   return NULL; // Simulate memory allocation failure
 }
+
+void *mock_calloc(size_t nmemb, size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
 typedef struct string_entry {
   struct hlist_node node; // hashtable list node structure
   char *str;              // str ptr
@@ -90,8 +98,295 @@ void test_create_hashtable(void) {
   }
 }
 
+void test_create_hashtable_size(void) {
+  const uint32_t size = 1000; // not a power of two
+  const int num_entries = 5000;
+  char str_buffer[40];
+
+  TEST_ASSERT_NULL(ht_create_size(0, 0));
+
+  // power of two sizes behave like ht_create()
+  hashtable_t *ht = ht_create_size(1024, 0);
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_EQUAL_UINT32(10, ht->bits);
+  TEST_ASSERT_EQUAL_UINT32(0, ht->flags & HT_FASTRANGE);
+  HT_FREE(ht, string_entry_t, node, free_entry);
+
+  ht = ht_create_size(size, 0);
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_EQUAL_UINT32(size, ht->size);
+  TEST_ASSERT_TRUE(ht->flags & HT_FASTRANGE);
+
+  for (int i = 0; i < num_entries; i++) {
+    snprintf(str_buffer, sizeof(str_buffer), "string%d", i);
+    string_entry_t *entry = malloc(sizeof(string_entry_t));
+    entry->str = strdup(str_buffer);
+    hashtable_add(ht, &entry->node, hash_32(i, 32));
+  }
+
+  size_t entries_count;
+  COUNT_ENTRIES_IN_HASHTABLE(ht, string_entry_t, node, entries_count);
+  TEST_ASSERT_EQUAL_UINT32(num_entries, entries_count);
+
+  // every entry is found through its bucket, and the whole range of buckets is used
+  uint32_t used_buckets = 0;
+  for (uint32_t bkt = 0; bkt < size; bkt++) {
+    used_buckets += !hlist_empty(&ht->table[bkt]);
+  }
+  TEST_ASSERT_TRUE(used_buckets > size * 9 / 10);
+
+  for (int i = 0; i < num_entries; i++) {
+    snprintf(str_buffer, sizeof(str_buffer), "string%d", i);
+    string_entry_t *cur, *found = NULL;
+    hashtable_for_each_possible(ht, cur, node, hash_32(i, 32)) {
+      if (strcmp(cur->str, str_buffer) == 0) {
+        found = cur;
+        break;
+      }
+    }
+    TEST_ASSERT_NOT_NULL(found);
+  }
+
+  HT_FREE(ht, string_entry_t, node, free_entry);
+}
+
+void test_calc_bkt_range(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, calc_bkt_range(0, 1000));
+  TEST_ASSERT_EQUAL_UINT32(999, calc_bkt_range(UINT32_MAX, 1000));
+  TEST_ASSERT_EQUAL_UINT32(500, calc_bkt_range(1U << 31, 1000));
+}
+
+void test_create_hashtable_overflow(void) {
+  // bucket array byte size would overflow size_t
+  TEST_ASSERT_NULL(ht_create(sizeof(size_t) * 8 - 2));
+  TEST_ASSERT_NULL(ht_create_size(SIZE_MAX / sizeof(struct hlist_head) + 1, 0));
+}
+
+void test_ilog2_64bit(void) {
+  // runtime values, not folded by the constant branch of ilog2()
+  volatile u64 v[] = {1, 2, 3, UINT32_MAX, (u64)1 << 32, ((u64)1 << 33) + 1, UINT64_MAX};
+  const int expected[] = {0, 1, 1, 31, 32, 33, 63};
+  for (size_t i = 0; i < ARRAY_SIZE(expected); i++)
+    TEST_ASSERT_EQUAL_INT(expected[i], ilog2(v[i]));
+
+  // a power of two size above 2^32 takes the ht_create_ex() path; the 64 GiB table may not be granted here
+  hashtable_t *ht = ht_create_size((size_t)1 << 33, 0);
+  if (ht) {
+    TEST_ASSERT_EQUAL_UINT32(33, ht->bits);
+    TEST_ASSERT_EQUAL_UINT64((size_t)1 << 33, ht->size);
+    ht_destroy(ht);
+  }
+}
+
+void test_ht_bkt_64bit(void) {
+  // bucket selection only, no bucket array behind these tables
+  hashtable_t pow2 = {.table = NULL, .bits = 33, .flags = 0, .size = (size_t)1 << 33};
+  TEST_ASSERT_EQUAL_UINT64(((size_t)1 << 33) - 1, ht_bkt(&pow2, UINT64_MAX));
+  TEST_ASSERT_EQUAL_UINT64((size_t)1 << 32, ht_bkt(&pow2, (u64)1 << 32));
+
+  hashtable_t wide = {.table = NULL, .bits = 0, .flags = HT_FASTRANGE | HT_FASTRANGE64, .size = 3 * ((size_t)1 << 32)};
+  TEST_ASSERT_EQUAL_UINT64(0, ht_bkt(&wide, 0));
+  TEST_ASSERT_EQUAL_UINT64(wide.size - 1, ht_bkt(&wide, UINT64_MAX));
+  TEST_ASSERT_EQUAL_UINT64(wide.size / 2, ht_bkt(&wide, (u64)1 << 63));
+  TEST_ASSERT_EQUAL_UINT64(wide.size / 3, calc_bkt_range64((u64)1 << 63, (u64)2 << 32));
+
+  // up to 2^32 buckets both hash halves are used
+  hashtable_t narrow = {.table = NULL, .bits = 0, .flags = HT_FASTRANGE, .size = 1000};
+  TEST_ASSERT_EQUAL_UINT64(999, ht_bkt(&narrow, UINT32_MAX));
+  TEST_ASSERT_EQUAL_UINT64(999, ht_bkt(&narrow, (u64)UINT32_MAX << 32));
+}
+
 #define TEST_STRING "just_test_string"
 
+void test_create_hashtable_zeroed(void) {
+  // small bucket arrays come from calloc
+  set_memory_functions(malloc, mock_calloc, realloc, free);
+  TEST_ASSERT_NULL(ht_create(4));
+  set_memory_functions(malloc, calloc, realloc, free);
+
+  hashtable_t *ht = ht_create(4);
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_EQUAL_UINT32(0, ht->mem & HT_MEM_MMAP);
+  TEST_ASSERT_TRUE(__hash_empty(ht->table, ht->size));
+  HT_FREE(ht, string_entry_t, node, free_entry);
+
+  // large ones are lazily zeroed anonymous mappings
+  uint32_t bits = 20;
+  TEST_ASSERT_TRUE(((size_t)1 << bits) * sizeof(struct hlist_head) >= HT_MEM_MMAP_THRESHOLD);
+  ht = ht_create(bits);
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_TRUE(ht->mem & HT_MEM_MMAP);
+  TEST_ASSERT_TRUE(__hash_empty(ht->table, ht->size));
+
+  add_string_to_hashtable(ht, TEST_STRING);
+  TEST_ASSERT_NOT_NULL(find_string_in_hashtable(ht, TEST_STRING));
+  TEST_ASSERT_EQUAL_INT(0, delete_string_from_hashtable(ht, TEST_STRING));
+  HT_FREE(ht, string_entry_t, node, free_entry);
+}
+
+void test_create_hashtable_hugepages(void) {
+  uint32_t opts[] = {HT_HUGETLB, HT_THP};
+
+  for (size_t i = 0; i < ARRAY_SIZE(opts); i++) {
+    hashtable_t *ht = ht_create_ex(12, opts[i]);
+    TEST_ASSERT_NOT_NULL(ht);
+
+    // huge page requests are always mapped, whatever backing could be obtained
+    struct ht_stats stats;
+    ht_get_stats(ht, &stats);
+    TEST_ASSERT_EQUAL_UINT64(1 << 12, stats.buckets);
+    TEST_ASSERT_EQUAL_UINT64((1 << 12) * sizeof(struct hlist_head), stats.table_bytes);
+    TEST_ASSERT_TRUE(stats.mem & HT_MEM_MMAP);
+    if (opts[i] == HT_THP) TEST_ASSERT_EQUAL_UINT32(0, stats.mem & HT_MEM_HUGETLB);
+    printf("requested %s, got %s\n", opts[i] == HT_HUGETLB ? "hugetlb" : "thp", ht_mem_backing_name(stats.mem));
+
+    TEST_ASSERT_TRUE(__hash_empty(ht->table, ht->size));
+    add_string_to_hashtable(ht, TEST_STRING);
+    TEST_ASSERT_NOT_NULL(find_string_in_hashtable(ht, TEST_STRING));
+    HT_FREE(ht, string_entry_t, node, free_entry);
+  }
+
+  hashtable_t *ht = ht_create_size(1000, HT_THP);
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_TRUE(ht->flags & HT_FASTRANGE);
+  TEST_ASSERT_TRUE(ht->mem & HT_MEM_MMAP);
+  HT_FREE(ht, string_entry_t, node, free_entry);
+}
+
+void test_create_hashtable_numa(void) {
+  int nodes = ht_numa_nodes();
+  TEST_ASSERT_TRUE(nodes >= 1);
+  TEST_ASSERT_TRUE(ht_numa_current_node() < nodes);
+#ifdef SYS_getcpu
+  // the cached cpu -> node map agrees with the kernel
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) TEST_ASSERT_EQUAL_INT((int)node, ht_numa_current_node());
+#endif
+
+  // NUMA options force a mapping even for a small bucket array
+  hashtable_t *ht = ht_create_ex(4, HT_INTERLEAVE);
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_TRUE(ht->mem & HT_MEM_MMAP);
+  TEST_ASSERT_EQUAL_UINT32(0, ht->mem & HT_MEM_NODE);
+  printf("interleave over %d node(s): %s\n", nodes, ht_mem_placement_name(ht->mem));
+  add_string_to_hashtable(ht, TEST_STRING);
+  TEST_ASSERT_NOT_NULL(find_string_in_hashtable(ht, TEST_STRING));
+  HT_FREE(ht, string_entry_t, node, free_entry);
+
+  ht = ht_create_size(1000, HT_THP | HT_NODE(nodes - 1));
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_TRUE(ht->mem & HT_MEM_MMAP);
+  TEST_ASSERT_EQUAL_UINT32(0, ht->mem & HT_MEM_INTERLEAVE);
+  printf("node %d: %s\n", nodes - 1, ht_mem_placement_name(ht->mem));
+  TEST_ASSERT_TRUE(__hash_empty(ht->table, ht->size));
+  HT_FREE(ht, string_entry_t, node, free_entry);
+}
+
+void test_create_hashtable_locked(void) {
+  hashtable_t *ht = ht_create_ex(4, HT_LOCKED);
+  TEST_ASSERT_NOT_NULL(ht);
+  TEST_ASSERT_TRUE(ht->mem & HT_MEM_MMAP);
+  TEST_ASSERT_TRUE(ht->mem & HT_MEM_PREFAULTED);
+  TEST_ASSERT_TRUE(__hash_empty(ht->table, ht->size));
+  add_string_to_hashtable(ht, TEST_STRING);
+  TEST_ASSERT_NOT_NULL(find_string_in_hashtable(ht, TEST_STRING));
+  HT_FREE(ht, string_entry_t, node, free_entry);
+}
+
+#define BL_THREADS 4
+#define BL_ENTRIES 20000
+
+typedef struct num_entry {
+  struct hlist_node node;
+  u32 num;
+} num_entry_t;
+
+struct bl_worker {
+  pthread_t tid;
+  hashtable_t *ht;
+  num_entry_t *entries;
+};
+
+// add all entries, then delete the odd ones, all under bucket bit locks
+static void *bl_worker_run(void *arg) {
+  struct bl_worker *w = arg;
+  for (u32 i = 0; i < BL_ENTRIES; i++) {
+    hashtable_bl_add(w->ht, &w->entries[i].node, hash_32(w->entries[i].num, 32));
+  }
+  for (u32 i = 1; i < BL_ENTRIES; i += 2) {
+    hashtable_bl_del(w->ht, &w->entries[i].node, hash_32(w->entries[i].num, 32));
+  }
+  return NULL;
+}
+
+void test_hashtable_bl_lock(void) {
+  hashtable_t *ht = ht_create(4);
+  TEST_ASSERT_NOT_NULL(ht);
+  num_entry_t a = {.num = 1}, b = {.num = 2};
+  struct hlist_head *head = &ht->table[0];
+
+  // the lock bit survives adds and deletes of the first node
+  hlist_bl_lock(head);
+  TEST_ASSERT_TRUE(hlist_bl_is_locked(head));
+  TEST_ASSERT_FALSE(hlist_bl_trylock(head));
+  hlist_bl_add_head(&a.node, head);
+  hlist_bl_add_head(&b.node, head);
+  TEST_ASSERT_TRUE(hlist_bl_is_locked(head));
+  TEST_ASSERT_EQUAL_PTR(&b.node, hlist_bl_first(head));
+  hlist_bl_del(&b.node);
+  TEST_ASSERT_TRUE(hlist_bl_is_locked(head));
+  TEST_ASSERT_EQUAL_PTR(&a.node, hlist_bl_first(head));
+  hlist_bl_del_init(&a.node);
+  TEST_ASSERT_TRUE(hlist_bl_empty(head));
+  hlist_bl_unlock(head);
+  TEST_ASSERT_NULL(head->first);
+  TEST_ASSERT_TRUE(hlist_bl_trylock(head));
+  hlist_bl_unlock(head);
+
+  ht_destroy(ht);
+}
+
+void test_hashtable_bl_threads(void) {
+  hashtable_t *ht = ht_create(8);
+  TEST_ASSERT_NOT_NULL(ht);
+
+  struct bl_worker w[BL_THREADS];
+  for (int t = 0; t < BL_THREADS; t++) {
+    w[t].ht = ht;
+    w[t].entries = malloc(BL_ENTRIES * sizeof(num_entry_t));
+    for (u32 i = 0; i < BL_ENTRIES; i++) {
+      w[t].entries[i].num = t * BL_ENTRIES + i;
+    }
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&w[t].tid, NULL, bl_worker_run, &w[t]));
+  }
+  for (int t = 0; t < BL_THREADS; t++) {
+    pthread_join(w[t].tid, NULL);
+  }
+
+  // all locks are released, plain iteration works again
+  size_t bkt, count = 0;
+  num_entry_t *obj;
+  hashtable_for_each(ht, bkt, obj, node) {
+    TEST_ASSERT_EQUAL_UINT32(0, obj->num % 2);
+    count++;
+  }
+  TEST_ASSERT_EQUAL_size_t(BL_THREADS * BL_ENTRIES / 2, count);
+
+  u32 num = BL_ENTRIES + 2;
+  struct hlist_head *head = hashtable_bl_lock(ht, hash_32(num, 32));
+  bool found = false;
+  hashtable_bl_for_each_possible(ht, obj, node, hash_32(num, 32)) {
+    if (obj->num == num) found = true;
+  }
+  hashtable_bl_unlock(head);
+  TEST_ASSERT_TRUE(found);
+
+  ht_destroy(ht);
+  for (int t = 0; t < BL_THREADS; t++) {
+    free(w[t].entries);
+  }
+}
+
 void test_add_to_ht(void) {
   hashtable_t *ht = ht_create(10);
   TEST_ASSERT_NOT_NULL(ht);
@@ -250,6 +545,17 @@ int main(void) {
 
   RUN_TEST(test_create_hashtable_failed);
   RUN_TEST(test_create_hashtable);
+  RUN_TEST(test_create_hashtable_size);
+  RUN_TEST(test_calc_bkt_range);
+  RUN_TEST(test_create_hashtable_overflow);
+  RUN_TEST(test_ilog2_64bit);
+  RUN_TEST(test_ht_bkt_64bit);
+  RUN_TEST(test_create_hashtable_zeroed);
+  RUN_TEST(test_create_hashtable_hugepages);
+  RUN_TEST(test_create_hashtable_numa);
+  RUN_TEST(test_create_hashtable_locked);
+  RUN_TEST(test_hashtable_bl_lock);
+  RUN_TEST(test_hashtable_bl_threads);
   RUN_TEST(test_add_to_ht);
   RUN_TEST(test_delete_string_from_hashtable);
   RUN_TEST(test_add_and_delete_entries);
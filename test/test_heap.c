@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "heap.h"
+#include "ht_lock.h"
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+
+#include "unity.h"
+
+#define NODES 5000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+struct timer {
+  int id;
+  struct dheap_node dnode;
+  struct pheap_node pnode;
+};
+
+static struct timer timers[NODES];
+
+static uint64_t next_key(uint64_t *state) {
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *state >> 44; // small range, plenty of duplicate keys
+}
+
+void test_heap_create_failed(void) {
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(dheap_create(16));
+  set_memory_functions(malloc, calloc, realloc, free);
+}
+
+// pops must come out in key order and queued nodes must know their slot
+static void check_dheap_drain(dheap_t *h, size_t expect) {
+  for (size_t i = 0; i < h->size; i++)
+    TEST_ASSERT_EQUAL_size_t(i, h->slots[i].node->idx);
+  uint64_t last = 0;
+  size_t n = 0;
+  struct dheap_node *node;
+  while ((node = dheap_pop(h))) {
+    TEST_ASSERT_TRUE(node->key >= last);
+    TEST_ASSERT_FALSE(dheap_queued(node));
+    last = node->key;
+    n++;
+  }
+  TEST_ASSERT_EQUAL_size_t(expect, n);
+}
+
+void test_dheap(void) {
+  dheap_t *h = dheap_create(0);
+  TEST_ASSERT_NOT_NULL(h);
+  TEST_ASSERT_NULL(dheap_peek(h));
+  TEST_ASSERT_NULL(dheap_pop(h));
+  // the children of slot 0 start a cache line
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)&h->slots[1] % HT_CACHELINE_SIZE);
+
+  uint64_t state = 1;
+  for (int i = 0; i < NODES; i++) {
+    timers[i].id = i;
+    dheap_node_init(&timers[i].dnode);
+    TEST_ASSERT_EQUAL_INT(0, dheap_push(h, &timers[i].dnode, next_key(&state) + 10));
+  }
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)&h->slots[DHEAP_ARITY * 7 + 1] % HT_CACHELINE_SIZE);
+
+  // decrease, increase and remove in the middle of the heap
+  dheap_update(h, &timers[100].dnode, 1);
+  TEST_ASSERT_EQUAL_PTR(&timers[100].dnode, dheap_peek(h));
+  dheap_update(h, &timers[100].dnode, UINT64_MAX);
+  TEST_ASSERT_NOT_EQUAL(&timers[100].dnode, dheap_peek(h));
+  dheap_update(h, &timers[200].dnode, 0);
+  for (int i = 0; i < NODES; i += 3) {
+    if (i == 200) continue;
+    dheap_del(h, &timers[i].dnode);
+    TEST_ASSERT_FALSE(dheap_queued(&timers[i].dnode));
+  }
+  TEST_ASSERT_EQUAL_PTR(&timers[200].dnode, dheap_pop(h));
+  check_dheap_drain(h, NODES - (NODES + 2) / 3 - 1);
+  TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, timers[100].dnode.key);
+
+  // bulk build, also onto a heap that is not empty
+  struct dheap_node *nodes[NODES];
+  for (int i = 0; i < NODES; i++) {
+    timers[i].dnode.key = next_key(&state);
+    nodes[i] = &timers[i].dnode;
+  }
+  TEST_ASSERT_EQUAL_INT(0, dheap_push(h, &timers[0].dnode, 5));
+  TEST_ASSERT_EQUAL_INT(0, dheap_heapify(h, nodes + 1, NODES - 1));
+  TEST_ASSERT_EQUAL_size_t(NODES, h->size);
+  check_dheap_drain(h, NODES);
+  TEST_ASSERT_EQUAL_INT(0, dheap_heapify(h, nodes, 1));
+  TEST_ASSERT_EQUAL_size_t(0, timers[0].dnode.idx);
+  dheap_del(h, &timers[0].dnode);
+  TEST_ASSERT_EQUAL_size_t(0, h->size);
+  dheap_free(h);
+}
+
+static void check_pheap_drain(pheap_t *h, size_t expect) {
+  TEST_ASSERT_EQUAL_size_t(expect, h->size);
+  uint64_t last = 0;
+  size_t n = 0;
+  struct pheap_node *node;
+  while ((node = pheap_pop(h))) {
+    TEST_ASSERT_TRUE(node->key >= last);
+    last = node->key;
+    n++;
+  }
+  TEST_ASSERT_EQUAL_size_t(expect, n);
+  TEST_ASSERT_EQUAL_size_t(0, h->size);
+}
+
+void test_pheap(void) {
+  pheap_t h;
+  pheap_init(&h);
+  TEST_ASSERT_NULL(pheap_peek(&h));
+  TEST_ASSERT_NULL(pheap_pop(&h));
+
+  uint64_t state = 7;
+  for (int i = 0; i < NODES - 1; i++)
+    pheap_push(&h, &timers[i].pnode, next_key(&state) + 10);
+  // pair up the root list once so updates hit nodes deep in the tree
+  pheap_push(&h, &timers[NODES - 1].pnode, 0);
+  TEST_ASSERT_EQUAL_PTR(&timers[NODES - 1].pnode, pheap_pop(&h));
+
+  pheap_update(&h, &timers[100].pnode, 1);
+  TEST_ASSERT_EQUAL_PTR(&timers[100].pnode, pheap_peek(&h));
+  pheap_update(&h, &timers[100].pnode, UINT64_MAX);
+  pheap_update(&h, &timers[200].pnode, 0);
+  for (int i = 0; i < NODES - 1; i += 3) {
+    if (i != 200) pheap_del(&h, &timers[i].pnode);
+  }
+  TEST_ASSERT_EQUAL_PTR(&timers[200].pnode, pheap_pop(&h));
+  check_pheap_drain(&h, NODES - 1 - (NODES - 1 + 2) / 3 - 1);
+
+  struct pheap_node *nodes[NODES];
+  for (int i = 0; i < NODES; i++) {
+    timers[i].pnode.key = next_key(&state);
+    nodes[i] = &timers[i].pnode;
+  }
+  pheap_push(&h, nodes[0], 3);
+  pheap_heapify(&h, nodes + 1, NODES - 1);
+  pheap_del(&h, nodes[NODES / 2]);
+  check_pheap_drain(&h, NODES - 1);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_heap_create_failed);
+  RUN_TEST(test_dheap);
+  RUN_TEST(test_pheap);
+
+  return UNITY_END();
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ht_compact.h"
+#include "ht_mem.h"
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+
+#include "unity.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+typedef struct item {
+  u32 id;
+  u32 value;
+} item_t;
+
+static u32 item_hash(u32 id) {
+  return hash_32(id, 32);
+}
+
+static u32 add_item(cht_t *t, u32 id, u32 value) {
+  u32 idx = cht_add(t, item_hash(id));
+  if (idx != CHT_NIL) {
+    item_t *it = cht_elem(t, idx);
+    it->id = id;
+    it->value = value;
+  }
+  return idx;
+}
+
+static u32 find_item(cht_t *t, u32 id) {
+  u32 hash = item_hash(id);
+  u32 idx;
+  cht_for_each_possible(t, idx, hash) {
+    item_t *it = cht_elem(t, idx);
+    if (cht_node(t, idx)->hash == hash && it->id == id) return idx;
+  }
+  return CHT_NIL;
+}
+
+static size_t count_items(cht_t *t) {
+  size_t count = 0;
+  u32 bkt, idx;
+  cht_for_each(t, bkt, idx) {
+    count++;
+  }
+  return count;
+}
+
+void test_cht_create_failed(void) {
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(cht_create(10, sizeof(item_t), 0));
+  set_memory_functions(malloc, calloc, realloc, free);
+
+  // bucket heads are 32-bit indices
+  TEST_ASSERT_NULL(cht_create(32, sizeof(item_t), 0));
+}
+
+void test_cht_node_size(void) {
+  cht_t *t = cht_create(4, sizeof(item_t), 0);
+  TEST_ASSERT_NOT_NULL(t);
+  // 8 bytes of links instead of a 16-byte hlist_node
+  TEST_ASSERT_EQUAL_UINT32(sizeof(struct cht_node) + sizeof(item_t), t->node_size);
+  cht_free(t);
+}
+
+void test_cht_add_find_del(void) {
+  const u32 num = 1000;
+  // small initial capacity to force several pool reallocations
+  cht_t *t = cht_create(8, sizeof(item_t), 4);
+  TEST_ASSERT_NOT_NULL(t);
+
+  for (u32 i = 0; i < num; i++) {
+    TEST_ASSERT_NOT_EQUAL(CHT_NIL, add_item(t, i, i * 10));
+  }
+  TEST_ASSERT_EQUAL_UINT32(num, t->count);
+  TEST_ASSERT_EQUAL_size_t(num, count_items(t));
+
+  for (u32 i = 0; i < num; i++) {
+    u32 idx = find_item(t, i);
+    TEST_ASSERT_NOT_EQUAL(CHT_NIL, idx);
+    TEST_ASSERT_EQUAL_UINT32(i * 10, ((item_t *)cht_elem(t, idx))->value);
+  }
+  TEST_ASSERT_EQUAL_UINT32(CHT_NIL, find_item(t, num));
+
+  // delete every other item
+  for (u32 i = 0; i < num; i += 2) {
+    TEST_ASSERT_EQUAL_INT(0, cht_del(t, find_item(t, i)));
+  }
+  TEST_ASSERT_EQUAL_UINT32(num / 2, t->count);
+  for (u32 i = 0; i < num; i++) {
+    TEST_ASSERT_EQUAL(i % 2 == 0, find_item(t, i) == CHT_NIL);
+  }
+
+  // released slots are reused before the pool grows
+  u32 used = t->used;
+  for (u32 i = 0; i < num; i += 2) {
+    add_item(t, i, i * 10);
+  }
+  TEST_ASSERT_EQUAL_UINT32(used, t->used);
+  TEST_ASSERT_EQUAL_UINT32(num, t->count);
+
+  cht_free(t);
+}
+
+void test_cht_compact(void) {
+  const u32 num = 500;
+  cht_t *t = cht_create(6, sizeof(item_t), 0);
+  TEST_ASSERT_NOT_NULL(t);
+
+  for (u32 i = 0; i < num; i++) {
+    add_item(t, i, i + 1);
+  }
+  for (u32 i = 0; i < num; i++) {
+    if (i % 3) cht_del(t, find_item(t, i));
+  }
+
+  u32 count = t->count;
+  TEST_ASSERT_EQUAL_INT(0, cht_compact(t));
+  TEST_ASSERT_EQUAL_UINT32(count, t->used);
+  TEST_ASSERT_EQUAL_UINT32(count, t->capacity);
+  TEST_ASSERT_EQUAL_UINT32(CHT_NIL, t->free_list);
+  TEST_ASSERT_EQUAL_size_t(count, count_items(t));
+
+  for (u32 i = 0; i < num; i++) {
+    u32 idx = find_item(t, i);
+    if (i % 3) {
+      TEST_ASSERT_EQUAL_UINT32(CHT_NIL, idx);
+    } else {
+      TEST_ASSERT_NOT_EQUAL(CHT_NIL, idx);
+      TEST_ASSERT_EQUAL_UINT32(i + 1, ((item_t *)cht_elem(t, idx))->value);
+    }
+  }
+
+  cht_free(t);
+}
+
+void test_cht_save_load(void) {
+  const u32 num = 300;
+  cht_t *t = cht_create(7, sizeof(item_t), 0);
+  TEST_ASSERT_NOT_NULL(t);
+  for (u32 i = 0; i < num; i++) {
+    add_item(t, i, i * 3);
+  }
+  cht_del(t, find_item(t, 5));
+
+  FILE *f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_INT(0, cht_save(t, f));
+  rewind(f);
+  cht_t *loaded = cht_load(f);
+  fclose(f);
+  TEST_ASSERT_NOT_NULL(loaded);
+
+  TEST_ASSERT_EQUAL_UINT32(t->count, loaded->count);
+  TEST_ASSERT_EQUAL_UINT32(t->bits, loaded->bits);
+  for (u32 i = 0; i < num; i++) {
+    u32 idx = find_item(loaded, i);
+    if (i == 5) {
+      TEST_ASSERT_EQUAL_UINT32(CHT_NIL, idx);
+    } else {
+      TEST_ASSERT_NOT_EQUAL(CHT_NIL, idx);
+      TEST_ASSERT_EQUAL_UINT32(i * 3, ((item_t *)cht_elem(loaded, idx))->value);
+    }
+  }
+
+  // the loaded table keeps working, including the saved free list
+  TEST_ASSERT_NOT_EQUAL(CHT_NIL, add_item(loaded, num, 0));
+  TEST_ASSERT_EQUAL_UINT32(t->used, loaded->used);
+
+  cht_free(loaded);
+  cht_free(t);
+}
+
+// save 't', let 'patch' damage the image, and load it back
+static cht_t *load_patched(cht_t *t, void (*patch)(u8 *img, size_t len, const cht_t *t)) {
+  FILE *f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_INT(0, cht_save(t, f));
+  size_t len = ftell(f);
+  u8 *img = malloc(len);
+  TEST_ASSERT_NOT_NULL(img);
+  rewind(f);
+  TEST_ASSERT_EQUAL_size_t(len, fread(img, 1, len, f));
+  fclose(f);
+
+  patch(img, len, t);
+  f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_size_t(len, fwrite(img, 1, len, f));
+  rewind(f);
+  cht_t *loaded = cht_load(f);
+  fclose(f);
+  free(img);
+  return loaded;
+}
+
+// image layout: 6 u32 header (magic bits elem_size used free_list count), bucket heads, pool
+#define IMG_HDR (6 * sizeof(u32))
+
+static u32 *img_u32(u8 *img, size_t off) {
+  return (u32 *)(img + off);
+}
+
+static void patch_none(u8 *img, size_t len, const cht_t *t) {}
+
+static void patch_head(u8 *img, size_t len, const cht_t *t) {
+  *img_u32(img, IMG_HDR + 3 * sizeof(u32)) = t->used; // one past the pool
+}
+
+static void patch_next(u8 *img, size_t len, const cht_t *t) {
+  size_t pool = IMG_HDR + ((size_t)1 << t->bits) * sizeof(u32);
+  *img_u32(img, pool + 7 * t->node_size) = 0x7fffffff;
+}
+
+static void patch_cycle(u8 *img, size_t len, const cht_t *t) {
+  // point a bucket's first node back at itself
+  u32 head = *img_u32(img, IMG_HDR);
+  size_t pool = IMG_HDR + ((size_t)1 << t->bits) * sizeof(u32);
+  *img_u32(img, pool + (size_t)head * t->node_size) = head;
+}
+
+static void patch_free_list(u8 *img, size_t len, const cht_t *t) {
+  *img_u32(img, 4 * sizeof(u32)) = t->used + 5;
+}
+
+static void patch_count(u8 *img, size_t len, const cht_t *t) {
+  *img_u32(img, 5 * sizeof(u32)) = t->count + 1;
+}
+
+static void patch_hash(u8 *img, size_t len, const cht_t *t) {
+  // a node hashing to another bucket than the one it is linked in
+  u32 head = *img_u32(img, IMG_HDR);
+  size_t pool = IMG_HDR + ((size_t)1 << t->bits) * sizeof(u32);
+  *img_u32(img, pool + (size_t)head * t->node_size + sizeof(u32)) += 1;
+}
+
+static void patch_truncate(u8 *img, size_t len, const cht_t *t) {
+  *img_u32(img, 3 * sizeof(u32)) = t->used + 100; // more nodes than the file holds
+}
+
+static void patch_elem_size(u8 *img, size_t len, const cht_t *t) {
+  *img_u32(img, 2 * sizeof(u32)) = 0xFFFFFFF8; // node size wraps to 0 in 32 bits
+}
+
+void test_cht_load_corrupt(void) {
+  cht_t *t = cht_create(4, sizeof(item_t), 0);
+  TEST_ASSERT_NOT_NULL(t);
+  for (u32 i = 0; i < 100; i++)
+    add_item(t, i, i);
+  cht_del(t, find_item(t, 10));
+  cht_del(t, find_item(t, 20));
+  TEST_ASSERT_NOT_EQUAL(CHT_NIL, t->table[0]);
+
+  cht_t *loaded = load_patched(t, patch_none);
+  TEST_ASSERT_NOT_NULL(loaded);
+  cht_free(loaded);
+
+  TEST_ASSERT_NULL(load_patched(t, patch_head));
+  TEST_ASSERT_NULL(load_patched(t, patch_next));
+  TEST_ASSERT_NULL(load_patched(t, patch_cycle));
+  TEST_ASSERT_NULL(load_patched(t, patch_free_list));
+  TEST_ASSERT_NULL(load_patched(t, patch_count));
+  TEST_ASSERT_NULL(load_patched(t, patch_hash));
+  TEST_ASSERT_NULL(load_patched(t, patch_truncate));
+  cht_free(t);
+
+  // an empty table has no links to check, the header alone must be rejected
+  TEST_ASSERT_NULL(cht_create(4, 0xFFFFFFF8, 0));
+  t = cht_create(4, sizeof(item_t), 0);
+  TEST_ASSERT_NOT_NULL(t);
+  TEST_ASSERT_NULL(load_patched(t, patch_elem_size));
+  cht_free(t);
+}
+
+void test_cht_hugepages(void) {
+  const u32 num = 10000;
+  cht_t *t = cht_create_ex(10, sizeof(item_t), 0, HT_THP);
+  TEST_ASSERT_NOT_NULL(t);
+  TEST_ASSERT_TRUE(t->table_mem & HT_MEM_MMAP);
+  TEST_ASSERT_TRUE(t->pool_mem & HT_MEM_MMAP);
+
+  // pool growth keeps the huge page backing
+  for (u32 i = 0; i < num; i++) {
+    TEST_ASSERT_NOT_EQUAL(CHT_NIL, add_item(t, i, i));
+  }
+  TEST_ASSERT_TRUE(t->pool_mem & HT_MEM_MMAP);
+  for (u32 i = 0; i < num; i++) {
+    TEST_ASSERT_NOT_EQUAL(CHT_NIL, find_item(t, i));
+  }
+
+  TEST_ASSERT_EQUAL_INT(0, cht_compact(t));
+  TEST_ASSERT_TRUE(t->pool_mem & HT_MEM_MMAP);
+  TEST_ASSERT_EQUAL_size_t(num, count_items(t));
+
+  cht_free(t);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_cht_create_failed);
+  RUN_TEST(test_cht_node_size);
+  RUN_TEST(test_cht_add_find_del);
+  RUN_TEST(test_cht_compact);
+  RUN_TEST(test_cht_save_load);
+  RUN_TEST(test_cht_load_corrupt);
+  RUN_TEST(test_cht_hugepages);
+
+  return UNITY_END();
+}
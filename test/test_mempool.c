@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "ht_mem.h"
+#include "mempool.h"
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+
+#include "unity.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+void test_mempool_create_failed(void) {
+  TEST_ASSERT_NULL(mempool_create(0, 0, 0));
+  TEST_ASSERT_NULL(mempool_create(64, SIZE_MAX / 8, 0));
+
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(mempool_create(64, 0, 0));
+  set_memory_functions(malloc, calloc, realloc, free);
+}
+
+void test_mempool_alloc_free(void) {
+  const size_t num = 1000;
+  void *objs[1000];
+  mempool_t *pool = mempool_create(20, 64, 0);
+  TEST_ASSERT_NOT_NULL(pool);
+  TEST_ASSERT_EQUAL_size_t(32, pool->obj_size);
+  TEST_ASSERT_EQUAL_size_t(0, pool->capacity);
+
+  for (size_t i = 0; i < num; i++) {
+    objs[i] = mempool_alloc(pool);
+    TEST_ASSERT_NOT_NULL(objs[i]);
+    TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)objs[i] % MEMPOOL_ALIGN);
+    memset(objs[i], (int)i, 20);
+  }
+  TEST_ASSERT_EQUAL_size_t(num, pool->count);
+  TEST_ASSERT_EQUAL_size_t(1024, pool->capacity);
+  for (size_t i = 0; i < num; i++) {
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)i, ((uint8_t *)objs[i])[19]);
+  }
+
+  // released objects come back before the pool grows
+  for (size_t i = 0; i < num; i += 2) {
+    mempool_free(pool, objs[i]);
+  }
+  mempool_free(pool, NULL);
+  TEST_ASSERT_EQUAL_size_t(num / 2, pool->count);
+  for (size_t i = 0; i < num; i += 2) {
+    objs[i] = mempool_alloc(pool);
+  }
+  TEST_ASSERT_EQUAL_size_t(1024, pool->capacity);
+  TEST_ASSERT_EQUAL_size_t(num, pool->count);
+
+  mempool_destroy(pool);
+  mempool_destroy(NULL);
+}
+
+void test_mempool_reserve(void) {
+  mempool_t *pool = mempool_create(48, 16, HT_MEM_OPT_LOCK);
+  TEST_ASSERT_NOT_NULL(pool);
+  void *first = mempool_alloc(pool);
+  TEST_ASSERT_EQUAL_size_t(16, pool->capacity);
+
+  // 15 slots left in the first chunk, only the shortfall is added
+  TEST_ASSERT_EQUAL_INT(0, mempool_reserve(pool, 100));
+  TEST_ASSERT_EQUAL_size_t(101, pool->capacity);
+  TEST_ASSERT_TRUE(pool->chunks->mem & HT_MEM_PREFAULTED);
+  TEST_ASSERT_EQUAL_INT(0, mempool_reserve(pool, 100));
+  TEST_ASSERT_EQUAL_size_t(101, pool->capacity);
+
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_NOT_NULL(mempool_alloc(pool));
+  }
+  TEST_ASSERT_EQUAL_size_t(101, pool->capacity);
+  TEST_ASSERT_EQUAL_size_t(101, pool->count);
+
+  mempool_free(pool, first);
+  mempool_destroy(pool);
+}
+
+void test_mempool_numa(void) {
+  mempool_t *pool = mempool_create(64, 0, HT_MEM_OPT_THP | HT_MEM_OPT_NODE(0));
+  TEST_ASSERT_NOT_NULL(pool);
+  void *obj = mempool_alloc(pool);
+  TEST_ASSERT_NOT_NULL(obj);
+  // NUMA and huge page options always give a mapped chunk
+  TEST_ASSERT_TRUE(pool->chunks->mem & HT_MEM_MMAP);
+  printf("pool chunk: %s, %s\n", ht_mem_backing_name(pool->chunks->mem), ht_mem_placement_name(pool->chunks->mem));
+  mempool_free(pool, obj);
+  mempool_destroy(pool);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_mempool_create_failed);
+  RUN_TEST(test_mempool_alloc_free);
+  RUN_TEST(test_mempool_reserve);
+  RUN_TEST(test_mempool_numa);
+
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+#include "mpmc_queue.h"
+
+#include "unity.h"
+
+#define PRODUCERS 3
+#define CONSUMERS 3
+#define ITEMS_PER_PRODUCER 100000
+#define BATCH 16
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+void test_mpmc_queue_create_failed(void) {
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(mpmc_queue_create(16, 0));
+  set_memory_functions(malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(mpmc_queue_create(SIZE_MAX, 0));
+}
+
+void test_mpmc_queue_single(void) {
+  mpmc_queue_t *q = mpmc_queue_create(3, 0);
+  TEST_ASSERT_NOT_NULL(q);
+  TEST_ASSERT_EQUAL_size_t(4, mpmc_queue_capacity(q));
+
+  void *p = NULL;
+  TEST_ASSERT_EQUAL_INT(-1, mpmc_queue_dequeue(q, &p));
+  // blocking calls need MPMC_QUEUE_FUTEX
+  TEST_ASSERT_EQUAL_INT(-1, mpmc_queue_dequeue_wait(q, &p));
+
+  for (uintptr_t i = 0; i < 4; i++)
+    TEST_ASSERT_EQUAL_INT(0, mpmc_queue_enqueue(q, (void *)i));
+  TEST_ASSERT_EQUAL_INT(-1, mpmc_queue_enqueue(q, NULL));
+  TEST_ASSERT_EQUAL_size_t(4, mpmc_queue_count(q));
+  TEST_ASSERT_EQUAL_INT(0, mpmc_queue_dequeue(q, &p));
+  TEST_ASSERT_EQUAL_PTR((void *)0, p);
+
+  // bulk calls stop at full/empty and wrap around
+  void *in[4] = {(void *)4, (void *)5, (void *)6, (void *)7}, *out[8];
+  TEST_ASSERT_EQUAL_size_t(1, mpmc_queue_enqueue_bulk(q, in, 4));
+  TEST_ASSERT_EQUAL_size_t(4, mpmc_queue_dequeue_bulk(q, out, 8));
+  for (uintptr_t i = 0; i < 4; i++)
+    TEST_ASSERT_EQUAL_PTR((void *)(i + 1), out[i]);
+  TEST_ASSERT_EQUAL_size_t(3, mpmc_queue_enqueue_bulk(q, in + 1, 3));
+  TEST_ASSERT_EQUAL_size_t(3, mpmc_queue_dequeue_bulk(q, out, 8));
+  TEST_ASSERT_EQUAL_PTR((void *)7, out[2]);
+  TEST_ASSERT_EQUAL_size_t(0, mpmc_queue_count(q));
+
+  mpmc_queue_free(q);
+}
+
+struct thread {
+  pthread_t tid;
+  mpmc_queue_t *q;
+  int id;
+  uint64_t sum;
+  size_t count;
+};
+
+// items are id * ITEMS_PER_PRODUCER + i + 1, never NULL
+static void *producer_run(void *arg) {
+  struct thread *t = arg;
+  void *batch[BATCH];
+
+  for (uintptr_t i = 0; i < ITEMS_PER_PRODUCER;) {
+    uintptr_t item = (uintptr_t)t->id * ITEMS_PER_PRODUCER + i + 1;
+    if (i % 2) {
+      if (mpmc_queue_enqueue_wait(t->q, (void *)item)) break;
+      t->sum += item;
+      i++;
+      continue;
+    }
+    size_t n = 0;
+    while (n < BATCH && i + n < ITEMS_PER_PRODUCER) {
+      batch[n] = (void *)(item + n);
+      n++;
+    }
+    n = mpmc_queue_enqueue_bulk(t->q, batch, n);
+    if (!n) sched_yield();
+    for (size_t k = 0; k < n; k++)
+      t->sum += (uintptr_t)batch[k];
+    i += n;
+  }
+  return NULL;
+}
+
+static void *consumer_run(void *arg) {
+  struct thread *t = arg;
+  void *batch[BATCH];
+
+  for (;;) {
+    size_t n = mpmc_queue_dequeue_bulk(t->q, batch, t->id % 2 ? BATCH : 1);
+    if (!n) {
+      // sleep for the next item, -1 once closed and drained
+      if (mpmc_queue_dequeue_wait(t->q, batch)) break;
+      n = 1;
+    }
+    for (size_t k = 0; k < n; k++)
+      t->sum += (uintptr_t)batch[k];
+    t->count += n;
+  }
+  return NULL;
+}
+
+void test_mpmc_queue_threads(void) {
+  mpmc_queue_t *q = mpmc_queue_create(64, MPMC_QUEUE_FUTEX);
+  TEST_ASSERT_NOT_NULL(q);
+
+  struct thread prod[PRODUCERS], cons[CONSUMERS];
+  for (int i = 0; i < CONSUMERS; i++) {
+    cons[i] = (struct thread){.q = q, .id = i};
+    pthread_create(&cons[i].tid, NULL, consumer_run, &cons[i]);
+  }
+  for (int i = 0; i < PRODUCERS; i++) {
+    prod[i] = (struct thread){.q = q, .id = i};
+    pthread_create(&prod[i].tid, NULL, producer_run, &prod[i]);
+  }
+
+  uint64_t produced = 0, consumed = 0;
+  size_t count = 0;
+  for (int i = 0; i < PRODUCERS; i++) {
+    pthread_join(prod[i].tid, NULL);
+    produced += prod[i].sum;
+  }
+  mpmc_queue_close(q);
+  TEST_ASSERT_EQUAL_INT(-1, mpmc_queue_enqueue_wait(q, (void *)1));
+  for (int i = 0; i < CONSUMERS; i++) {
+    pthread_join(cons[i].tid, NULL);
+    consumed += cons[i].sum;
+    count += cons[i].count;
+  }
+
+  // every item was taken exactly once
+  uint64_t n = (uint64_t)PRODUCERS * ITEMS_PER_PRODUCER;
+  TEST_ASSERT_EQUAL_size_t(n, count);
+  TEST_ASSERT_EQUAL_UINT64(n * (n + 1) / 2, produced);
+  TEST_ASSERT_EQUAL_UINT64(produced, consumed);
+  TEST_ASSERT_EQUAL_size_t(0, mpmc_queue_count(q));
+  mpmc_queue_free(q);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_mpmc_queue_create_failed);
+  RUN_TEST(test_mpmc_queue_single);
+  RUN_TEST(test_mpmc_queue_threads);
+
+  return UNITY_END();
+}
@@ -0,0 +1,137 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "assoc_array.h"
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+#include "qsbr.h"
+
+#include "unity.h"
+
+#define READERS 4
+#define KEYS 1000
+#define ROUNDS 50
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void count_cb(void *ptr, void *arg) {
+  (*(int *)ptr)++;
+}
+
+void test_qsbr_grace_period(void) {
+  qsbr_t *q = qsbr_create();
+  TEST_ASSERT_NOT_NULL(q);
+  qsbr_thread_t *r1 = qsbr_register(q);
+  qsbr_thread_t *r2 = qsbr_register(q);
+  TEST_ASSERT_NOT_NULL(r1);
+  TEST_ASSERT_NOT_NULL(r2);
+
+  int freed = 0;
+  qsbr_defer(q, count_cb, &freed, NULL);
+  TEST_ASSERT_EQUAL_size_t(1, q->pending);
+
+  // both readers may still hold the object
+  TEST_ASSERT_EQUAL_size_t(0, qsbr_poll(q));
+  qsbr_quiescent(r1);
+  TEST_ASSERT_EQUAL_size_t(0, qsbr_poll(q));
+  TEST_ASSERT_EQUAL_INT(0, freed);
+
+  // an offline reader does not hold up the grace period
+  qsbr_offline(r2);
+  TEST_ASSERT_EQUAL_size_t(1, qsbr_poll(q));
+  TEST_ASSERT_EQUAL_INT(1, freed);
+  TEST_ASSERT_EQUAL_size_t(0, q->pending);
+
+  qsbr_online(r2);
+  qsbr_defer(q, count_cb, &freed, NULL);
+  qsbr_quiescent(r1);
+  qsbr_quiescent(r2);
+  TEST_ASSERT_EQUAL_size_t(1, qsbr_poll(q));
+  TEST_ASSERT_EQUAL_INT(2, freed);
+
+  // records of unregistered threads are reused
+  qsbr_unregister(r2);
+  TEST_ASSERT_EQUAL_PTR(r2, qsbr_register(q));
+
+  qsbr_unregister(r1);
+  qsbr_unregister(r2);
+  qsbr_defer(q, count_cb, &freed, NULL);
+  qsbr_destroy(q);
+  TEST_ASSERT_EQUAL_INT(3, freed);
+}
+
+struct reader {
+  pthread_t tid;
+  qsbr_t *q;
+  assoc_array_t *arr;
+  volatile int *stop;
+  long lookups;
+  int errors;
+};
+
+// lock-free lookups: every entry found must still hold the data of its key
+static void *reader_run(void *arg) {
+  struct reader *r = arg;
+  qsbr_thread_t *t = qsbr_register(r->q);
+  char key[32];
+  unsigned i = 0;
+
+  while (!__atomic_load_n(r->stop, __ATOMIC_RELAXED)) {
+    int len = snprintf(key, sizeof(key), "key%u", i++ % KEYS) + 1;
+    assoc_array_entry_t *e = array_get_by_key_rcu(r->arr, key, len);
+    if (e && strcmp(e->data, key) != 0) r->errors++;
+    r->lookups++;
+    if (i % 64 == 0) qsbr_quiescent(t);
+  }
+  qsbr_unregister(t);
+  return NULL;
+}
+
+void test_array_rcu_readers(void) {
+  qsbr_t *q = qsbr_create();
+  assoc_array_t *arr = array_create(10, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(arr);
+  TEST_ASSERT_EQUAL_INT(0, array_set_qsbr(arr, q));
+
+  volatile int stop = 0;
+  struct reader r[READERS];
+  for (int i = 0; i < READERS; i++) {
+    r[i] = (struct reader){.q = q, .arr = arr, .stop = &stop};
+    pthread_create(&r[i].tid, NULL, reader_run, &r[i]);
+  }
+
+  // a single writer keeps replacing, deleting and re-adding all keys
+  char key[32];
+  for (int round = 0; round < ROUNDS; round++) {
+    for (int i = 0; i < KEYS; i++) {
+      int len = snprintf(key, sizeof(key), "key%d", i) + 1;
+      if (round % 3 == 2)
+        array_del(arr, key, len);
+      else
+        array_add_replace(arr, strdup(key), key, len);
+    }
+    array_del_first(arr);
+    qsbr_poll(q);
+  }
+
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+  for (int i = 0; i < READERS; i++) {
+    pthread_join(r[i].tid, NULL);
+    TEST_ASSERT_EQUAL_INT(0, r[i].errors);
+    TEST_ASSERT_TRUE(r[i].lookups > 0);
+  }
+
+  TEST_ASSERT_EQUAL_INT(-1, array_set_qsbr(arr, NULL));
+  TEST_ASSERT_EQUAL_INT(0, array_free(arr));
+  TEST_ASSERT_EQUAL_size_t(0, q->pending);
+  qsbr_destroy(q);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_qsbr_grace_period);
+  RUN_TEST(test_array_rcu_readers);
+
+  return UNITY_END();
+}
@@ -0,0 +1,136 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ht_mem.h"
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+#include "shard_array.h"
+
+#include "unity.h"
+
+#define THREADS 4
+#define KEYS_PER_THREAD 20000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if calloc returns NULL
+void *mock_calloc(size_t num, size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+struct worker {
+  pthread_t tid;
+  shard_array_t *sa;
+  int id;
+  int errors;
+};
+
+static int make_key(char *buf, size_t len, int thread, int i) {
+  return snprintf(buf, len, "mac-%d-%d", thread, i) + 1;
+}
+
+static void *worker_run(void *arg) {
+  struct worker *w = arg;
+  char key[32];
+  void *data;
+
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    if (shard_array_add(w->sa, strdup(key), key, len)) w->errors++;
+  }
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    if (shard_array_get_data(w->sa, key, len, &data) || strcmp(data, key)) w->errors++;
+  }
+  for (int i = 0; i < KEYS_PER_THREAD; i += 2) {
+    int len = make_key(key, sizeof(key), w->id, i);
+    if (shard_array_del(w->sa, key, len)) w->errors++;
+  }
+  return NULL;
+}
+
+void test_shard_array_create_failed(void) {
+  TEST_ASSERT_NULL(shard_array_create(SHARD_ARRAY_MAX_BITS + 1, 8, 0, NULL, NULL));
+  TEST_ASSERT_NULL(shard_array_create(2, 8, ARRAY_POOL, NULL, NULL));
+  set_memory_functions(malloc, mock_calloc, realloc, free);
+  TEST_ASSERT_NULL(shard_array_create(2, 8, 0, NULL, NULL));
+  set_memory_functions(malloc, calloc, realloc, free);
+  TEST_ASSERT_EQUAL_INT(-1, shard_array_free(NULL));
+}
+
+void test_shard_array_threads(void) {
+  shard_array_t *sa = shard_array_create(3, 10, 0, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(sa);
+  TEST_ASSERT_EQUAL_UINT32(8, sa->count);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)sa->shards % HT_CACHELINE_SIZE);
+
+  struct worker w[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    w[t] = (struct worker){.sa = sa, .id = t};
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&w[t].tid, NULL, worker_run, &w[t]));
+  }
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(w[t].tid, NULL);
+    TEST_ASSERT_EQUAL_INT(0, w[t].errors);
+  }
+  TEST_ASSERT_EQUAL_size_t(THREADS * KEYS_PER_THREAD / 2, shard_array_size(sa));
+
+  // keys are spread over all shards and every shard keeps its own counters
+  uint64_t adds = 0, dels = 0, hits = 0;
+  for (uint32_t i = 0; i < sa->count; i++) {
+    struct shard_stats st;
+    shard_array_get_stats(sa, i, &st);
+    TEST_ASSERT_TRUE(st.adds > THREADS * KEYS_PER_THREAD / sa->count / 2);
+    TEST_ASSERT_EQUAL_size_t(st.adds - st.dels, shard_array_shard(sa, i)->size);
+    TEST_ASSERT_NOT_NULL(shard_array_shard(sa, i)->pool);
+    adds += st.adds;
+    dels += st.dels;
+    hits += st.hits;
+  }
+  TEST_ASSERT_EQUAL_UINT64(THREADS * KEYS_PER_THREAD, adds);
+  TEST_ASSERT_EQUAL_UINT64(THREADS * KEYS_PER_THREAD / 2, dels);
+  TEST_ASSERT_EQUAL_UINT64(THREADS * KEYS_PER_THREAD, hits);
+
+  // the owner of a shard finds its keys there without the lock
+  char key[32];
+  int len = make_key(key, sizeof(key), 0, 1);
+  assoc_array_t *own = shard_array_shard(sa, shard_array_index(sa, key, len));
+  TEST_ASSERT_NOT_NULL(array_get_by_key(own, key, len));
+
+  TEST_ASSERT_EQUAL_INT(0, shard_array_free(sa));
+}
+
+void test_shard_array_replace_numa(void) {
+  shard_array_t *sa = shard_array_create(0, 4, SHARD_ARRAY_NUMA | ARRAY_UNORDERED, NULL, NULL);
+  TEST_ASSERT_NOT_NULL(sa);
+  TEST_ASSERT_EQUAL_UINT32(0, shard_array_index(sa, "key", sizeof("key")));
+  TEST_ASSERT_TRUE(shard_array_shard(sa, 0)->ht->mem & HT_MEM_MMAP);
+
+  void *data;
+  TEST_ASSERT_EQUAL_INT(0, shard_array_add(sa, strdup("one"), "key", sizeof("key")));
+  TEST_ASSERT_EQUAL_INT(0, shard_array_add_replace(sa, strdup("two"), "key", sizeof("key")));
+  TEST_ASSERT_EQUAL_INT(0, shard_array_get_data(sa, "key", sizeof("key"), &data));
+  TEST_ASSERT_EQUAL_STRING("two", data);
+  TEST_ASSERT_EQUAL_INT(-1, shard_array_lookup(sa, "nokey", sizeof("nokey"), NULL, NULL));
+  TEST_ASSERT_EQUAL_INT(1, shard_array_del(sa, "nokey", sizeof("nokey")));
+  TEST_ASSERT_EQUAL_size_t(1, shard_array_size(sa));
+
+  struct shard_stats st;
+  shard_array_get_stats(sa, 0, &st);
+  TEST_ASSERT_EQUAL_UINT64(2, st.adds);
+  TEST_ASSERT_EQUAL_UINT64(1, st.dels);
+  TEST_ASSERT_EQUAL_UINT64(2, st.lookups);
+  TEST_ASSERT_EQUAL_UINT64(1, st.hits);
+  TEST_ASSERT_EQUAL_INT(0, shard_array_free(sa));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_shard_array_create_failed);
+  RUN_TEST(test_shard_array_threads);
+  RUN_TEST(test_shard_array_replace_numa);
+
+  return UNITY_END();
+}
@@ -0,0 +1,211 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+#include "split_ht.h"
+
+#include "unity.h"
+
+#define THREADS 4
+#define KEYS 2000
+#define ROUNDS 20
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+static int key_of(char *key, size_t size, int i) {
+  return snprintf(key, size, "key%d", i) + 1;
+}
+
+void test_split_ht_create_failed(void) {
+  qsbr_t *q = qsbr_create();
+  TEST_ASSERT_NULL(split_ht_create(0, 0, NULL, NULL));
+  TEST_ASSERT_NULL(split_ht_create(SPLIT_MAX_BUCKETS + 1, 0, q, NULL));
+
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(split_ht_create(0, 0, q, NULL));
+  set_memory_functions(malloc, calloc, realloc, free);
+  qsbr_destroy(q);
+}
+
+void test_split_ht_add_get_del(void) {
+  qsbr_t *q = qsbr_create();
+  qsbr_thread_t *self = qsbr_register(q);
+  split_ht_t *t = split_ht_create(3, 0, q, free);
+  TEST_ASSERT_NOT_NULL(t);
+  TEST_ASSERT_EQUAL_size_t(4, split_ht_size(t));
+
+  char key[32];
+  for (int i = 0; i < KEYS; i++) {
+    int len = key_of(key, sizeof(key), i);
+    TEST_ASSERT_EQUAL_INT(0, split_ht_add(t, strdup(key), key, len));
+  }
+  TEST_ASSERT_EQUAL_INT(1, split_ht_add(t, NULL, "key7", 5));
+  TEST_ASSERT_EQUAL_size_t(KEYS, split_ht_count(t));
+  // the table doubled along the way without moving entries
+  TEST_ASSERT_TRUE(split_ht_size(t) >= KEYS / SPLIT_DEFAULT_LOAD);
+
+  for (int i = 0; i < KEYS; i++) {
+    int len = key_of(key, sizeof(key), i);
+    char *data = split_ht_get(t, key, len);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_EQUAL_STRING(key, data);
+  }
+  TEST_ASSERT_NULL(split_ht_get(t, "nokey", 6));
+  TEST_ASSERT_NULL(split_ht_get(t, "key1", 4)); // key sizes must match too
+
+  for (int i = 0; i < KEYS; i += 2) {
+    int len = key_of(key, sizeof(key), i);
+    TEST_ASSERT_EQUAL_INT(0, split_ht_del(t, key, len));
+    TEST_ASSERT_EQUAL_INT(1, split_ht_del(t, key, len));
+  }
+  TEST_ASSERT_EQUAL_size_t(KEYS / 2, split_ht_count(t));
+  for (int i = 0; i < KEYS; i++) {
+    int len = key_of(key, sizeof(key), i);
+    TEST_ASSERT_EQUAL(i % 2 == 0, split_ht_get(t, key, len) == NULL);
+  }
+
+  // deleted entries are freed after a grace period
+  TEST_ASSERT_EQUAL_size_t(KEYS / 2, q->pending);
+  qsbr_quiescent(self);
+  TEST_ASSERT_EQUAL_size_t(KEYS / 2, qsbr_poll(q));
+
+  qsbr_unregister(self);
+  split_ht_free(t);
+  qsbr_destroy(q);
+}
+
+void test_split_ht_del_no_memory(void) {
+  qsbr_t *q = qsbr_create();
+  qsbr_thread_t *self = qsbr_register(q);
+  split_ht_t *t = split_ht_create(0, 0, q, free);
+  TEST_ASSERT_EQUAL_INT(0, split_ht_add(t, strdup("key"), "key", 4));
+
+  // an online reader deleting without memory must neither fail nor wait for itself
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_EQUAL_INT(0, split_ht_del(t, "key", 4));
+  set_memory_functions(malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(split_ht_get(t, "key", 4));
+  TEST_ASSERT_EQUAL_size_t(1, q->pending);
+
+  qsbr_quiescent(self);
+  TEST_ASSERT_EQUAL_size_t(1, qsbr_poll(q));
+  qsbr_unregister(self);
+  split_ht_free(t);
+  qsbr_destroy(q);
+}
+
+void test_split_ht_order(void) {
+  qsbr_t *q = qsbr_create();
+  split_ht_t *t = split_ht_create(2, 1, q, NULL);
+  TEST_ASSERT_NOT_NULL(t);
+
+  static int data[KEYS];
+  char key[32];
+  for (int i = 0; i < KEYS; i++) {
+    int len = key_of(key, sizeof(key), i);
+    split_ht_add(t, &data[i], key, len);
+  }
+
+  // one list in split order, every initialized bucket has its dummy in it
+  size_t entries = 0, dummies = 0;
+  u64 last = 0;
+  for (struct split_node *n = (struct split_node *)t->head.next; n; n = (struct split_node *)n->next) {
+    TEST_ASSERT_TRUE(n->so_key >= last);
+    last = n->so_key;
+    if (n->so_key & 1)
+      entries++;
+    else
+      dummies++;
+  }
+  TEST_ASSERT_EQUAL_size_t(KEYS, entries);
+  TEST_ASSERT_TRUE(dummies > 0 && dummies < split_ht_size(t));
+
+  // lookups find every key without initializing the buckets they hit
+  for (int i = 0; i < KEYS; i++) {
+    int len = key_of(key, sizeof(key), i);
+    TEST_ASSERT_EQUAL_PTR(&data[i], split_ht_get(t, key, len));
+  }
+  size_t after = 0;
+  for (struct split_node *n = (struct split_node *)t->head.next; n; n = (struct split_node *)n->next)
+    after += !(n->so_key & 1);
+  TEST_ASSERT_EQUAL_size_t(dummies, after);
+
+  split_ht_free(t);
+  qsbr_destroy(q);
+}
+
+struct worker {
+  pthread_t tid;
+  split_ht_t *t;
+  int id;
+  int errors;
+};
+
+// every thread owns the keys i % THREADS == id and reads all others
+static void *worker_run(void *arg) {
+  struct worker *w = arg;
+  qsbr_thread_t *self = qsbr_register(w->t->qsbr);
+  char key[32];
+
+  for (int round = 0; round < ROUNDS; round++) {
+    for (int i = w->id; i < KEYS; i += THREADS) {
+      int len = key_of(key, sizeof(key), i);
+      if (round % 2 == 0) {
+        if (split_ht_add(w->t, strdup(key), key, len) != 0) w->errors++;
+      } else {
+        if (split_ht_del(w->t, key, len) != 0) w->errors++;
+      }
+      char *data = split_ht_get(w->t, key, len);
+      if ((data != NULL) != (round % 2 == 0)) w->errors++;
+
+      len = key_of(key, sizeof(key), (i + 1) % KEYS);
+      data = split_ht_get(w->t, key, len);
+      if (data && strcmp(data, key) != 0) w->errors++;
+      if (i % 64 == 0) qsbr_quiescent(self);
+    }
+    qsbr_poll(w->t->qsbr);
+  }
+  qsbr_unregister(self);
+  return NULL;
+}
+
+void test_split_ht_threads(void) {
+  qsbr_t *q = qsbr_create();
+  split_ht_t *t = split_ht_create(0, 0, q, free);
+  TEST_ASSERT_NOT_NULL(t);
+
+  struct worker w[THREADS];
+  for (int i = 0; i < THREADS; i++) {
+    w[i] = (struct worker){.t = t, .id = i};
+    pthread_create(&w[i].tid, NULL, worker_run, &w[i]);
+  }
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(w[i].tid, NULL);
+    TEST_ASSERT_EQUAL_INT(0, w[i].errors);
+  }
+
+  // an even number of rounds leaves the table empty
+  TEST_ASSERT_EQUAL_size_t(0, split_ht_count(t));
+  split_ht_free(t);
+  TEST_ASSERT_EQUAL_size_t(0, q->pending);
+  qsbr_destroy(q);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_split_ht_create_failed);
+  RUN_TEST(test_split_ht_add_get_del);
+  RUN_TEST(test_split_ht_del_no_memory);
+  RUN_TEST(test_split_ht_order);
+  RUN_TEST(test_split_ht_threads);
+
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+#include "spsc_ring.h"
+
+#include "unity.h"
+
+#define ITEMS 1000000
+#define BATCH 32
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+void test_spsc_ring_create_failed(void) {
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(spsc_ring_create(16));
+  set_memory_functions(malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(spsc_ring_create(SIZE_MAX));
+}
+
+void test_spsc_ring_single(void) {
+  spsc_ring_t *r = spsc_ring_create(5);
+  TEST_ASSERT_NOT_NULL(r);
+  TEST_ASSERT_EQUAL_size_t(8, spsc_ring_capacity(r));
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)&r->head % HT_CACHELINE_SIZE);
+  TEST_ASSERT_TRUE((char *)&r->head - (char *)&r->tail >= HT_CACHELINE_SIZE);
+
+  void *p = NULL;
+  TEST_ASSERT_EQUAL_INT(-1, spsc_ring_dequeue(r, &p));
+  for (uintptr_t i = 0; i < 8; i++)
+    TEST_ASSERT_EQUAL_INT(0, spsc_ring_enqueue(r, (void *)i));
+  TEST_ASSERT_EQUAL_INT(-1, spsc_ring_enqueue(r, NULL));
+  TEST_ASSERT_EQUAL_size_t(8, spsc_ring_count(r));
+
+  for (uintptr_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL_INT(0, spsc_ring_dequeue(r, &p));
+    TEST_ASSERT_EQUAL_PTR((void *)i, p);
+  }
+
+  // bulk operations wrap around and stop at full/empty
+  void *in[8] = {(void *)8, (void *)9, (void *)10, (void *)11, (void *)12, (void *)13}, *out[16];
+  TEST_ASSERT_EQUAL_size_t(5, spsc_ring_enqueue_bulk(r, in, 6));
+  TEST_ASSERT_EQUAL_size_t(8, spsc_ring_dequeue_bulk(r, out, 16));
+  for (uintptr_t i = 0; i < 8; i++)
+    TEST_ASSERT_EQUAL_PTR((void *)(i + 5), out[i]);
+  TEST_ASSERT_EQUAL_size_t(0, spsc_ring_dequeue_bulk(r, out, 16));
+
+  spsc_ring_free(r);
+}
+
+static void *producer_run(void *arg) {
+  spsc_ring_t *r = arg;
+  void *batch[BATCH];
+  uintptr_t next = 1;
+
+  // alternate single and bulk enqueues
+  while (next <= ITEMS) {
+    if (next % 3) {
+      if (spsc_ring_enqueue(r, (void *)next) == 0)
+        next++;
+      else
+        sched_yield(); // full, let the consumer run on small machines
+      continue;
+    }
+    size_t n = 0;
+    while (n < BATCH && next + n <= ITEMS) {
+      batch[n] = (void *)(next + n);
+      n++;
+    }
+    n = spsc_ring_enqueue_bulk(r, batch, n);
+    if (!n) sched_yield();
+    next += n;
+  }
+  return NULL;
+}
+
+void test_spsc_ring_threads(void) {
+  spsc_ring_t *r = spsc_ring_create(256);
+  TEST_ASSERT_NOT_NULL(r);
+  pthread_t tid;
+  pthread_create(&tid, NULL, producer_run, r);
+
+  // the consumer must see every pointer exactly once and in order
+  uintptr_t expect = 1;
+  int errors = 0;
+  void *batch[BATCH];
+  while (expect <= ITEMS) {
+    size_t n = spsc_ring_dequeue_bulk(r, batch, expect % 2 ? BATCH : 1);
+    if (!n) sched_yield();
+    for (size_t i = 0; i < n; i++) {
+      if (batch[i] != (void *)expect) errors++;
+      expect++;
+    }
+  }
+  pthread_join(tid, NULL);
+  TEST_ASSERT_EQUAL_INT(0, errors);
+  TEST_ASSERT_EQUAL_size_t(0, spsc_ring_count(r));
+  spsc_ring_free(r);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_spsc_ring_create_failed);
+  RUN_TEST(test_spsc_ring_single);
+  RUN_TEST(test_spsc_ring_threads);
+
+  return UNITY_END();
+}
@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+#include "timer_wheel.h"
+
+#include "unity.h"
+
+#define ENTRIES 20000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+struct entry {
+  struct tw_timer timer;
+  uint64_t due; // tick the entry must expire at, 0 if it must not
+  int fired;
+  int period; // re-armed from the callback this many more times
+};
+
+static struct entry entries[ENTRIES];
+static int errors;
+
+static uint64_t next_rand(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static void on_expire(struct tw_timer *t, void *arg) {
+  timer_wheel_t *tw = arg;
+  struct entry *e = hlist_entry(&t->node, struct entry, timer.node);
+  if (tw_timer_armed(t) || e->due != tw->now || t->expires != tw->now) errors++;
+  e->fired++;
+  if (e->period) {
+    e->period--;
+    e->due = tw->now + 1000 + e->period;
+    timer_wheel_arm(tw, t, e->due);
+  } else {
+    e->due = 0;
+  }
+}
+
+void test_timer_wheel_create_failed(void) {
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(timer_wheel_create(0));
+  set_memory_functions(malloc, calloc, realloc, free);
+}
+
+void test_timer_wheel_basic(void) {
+  timer_wheel_t *tw = timer_wheel_create(1000);
+  TEST_ASSERT_NOT_NULL(tw);
+  struct entry *e = &entries[0];
+  *e = (struct entry){0};
+  tw_timer_init(&e->timer);
+  TEST_ASSERT_FALSE(tw_timer_armed(&e->timer));
+
+  // an expiry in the past fires on the next tick
+  errors = 0;
+  e->due = 1001;
+  timer_wheel_arm(tw, &e->timer, 5);
+  TEST_ASSERT_TRUE(tw_timer_armed(&e->timer));
+  TEST_ASSERT_EQUAL_size_t(1, timer_wheel_advance(tw, 1001, on_expire, tw));
+  TEST_ASSERT_EQUAL_INT(1, e->fired);
+
+  // cancel and rearm, also of a timer that is not armed
+  timer_wheel_arm(tw, &e->timer, 5000);
+  timer_wheel_cancel(tw, &e->timer);
+  timer_wheel_cancel(tw, &e->timer);
+  TEST_ASSERT_EQUAL_size_t(0, tw->count);
+  TEST_ASSERT_EQUAL_size_t(0, timer_wheel_advance(tw, 6000, on_expire, tw));
+  e->due = 7000;
+  timer_wheel_rearm(tw, &e->timer, 9000);
+  timer_wheel_rearm(tw, &e->timer, 7000);
+  TEST_ASSERT_EQUAL_size_t(1, tw->count);
+  TEST_ASSERT_EQUAL_size_t(0, timer_wheel_advance(tw, 6999, on_expire, tw));
+  TEST_ASSERT_EQUAL_size_t(1, timer_wheel_advance(tw, 7000, on_expire, tw));
+
+  // far in the future: cascades through many levels in a few steps
+  e->due = (1ULL << 50) + 12345;
+  timer_wheel_arm(tw, &e->timer, e->due);
+  TEST_ASSERT_EQUAL_size_t(0, timer_wheel_advance(tw, 1ULL << 50, on_expire, tw));
+  TEST_ASSERT_EQUAL_size_t(1, timer_wheel_advance(tw, UINT64_MAX - 1, on_expire, tw));
+  TEST_ASSERT_EQUAL_UINT64(UINT64_MAX - 1, tw->now);
+  TEST_ASSERT_EQUAL_INT(3, e->fired);
+  TEST_ASSERT_EQUAL_INT(0, errors);
+  timer_wheel_free(tw);
+}
+
+// many entries, random timeouts, cancels and re-arms, time moving in random steps
+void test_timer_wheel_random(void) {
+  uint64_t start = 123456789, state = 88172645463325252ULL;
+  timer_wheel_t *tw = timer_wheel_create(start);
+  TEST_ASSERT_NOT_NULL(tw);
+  errors = 0;
+
+  size_t expect = 0;
+  for (int i = 0; i < ENTRIES; i++) {
+    struct entry *e = &entries[i];
+    *e = (struct entry){0};
+    tw_timer_init(&e->timer);
+    uint64_t r = next_rand(&state);
+    // timeouts from 1 tick to about 16M ticks, spread over the levels
+    e->due = start + 1 + r % (1ULL << ((r >> 59) % 25));
+    e->period = i % 10 == 0 ? 2 : 0;
+    timer_wheel_arm(tw, &e->timer, e->due);
+    expect += 1 + e->period;
+  }
+  for (int i = 1; i < ENTRIES; i += 7) {
+    if (entries[i].period) continue;
+    timer_wheel_cancel(tw, &entries[i].timer);
+    entries[i].due = 0;
+    expect--;
+  }
+  for (int i = 2; i < ENTRIES; i += 7) {
+    if (entries[i].period) continue;
+    entries[i].due += 77;
+    timer_wheel_rearm(tw, &entries[i].timer, entries[i].due);
+  }
+
+  size_t fired = 0;
+  uint64_t now = start;
+  while (tw->count) {
+    now += 1 + next_rand(&state) % 5000;
+    fired += timer_wheel_advance(tw, now, on_expire, tw);
+    TEST_ASSERT_EQUAL_UINT64(now, tw->now);
+  }
+  TEST_ASSERT_EQUAL_INT(0, errors);
+  TEST_ASSERT_EQUAL_size_t(expect, fired);
+  for (int i = 0; i < ENTRIES; i++) {
+    TEST_ASSERT_FALSE(tw_timer_armed(&entries[i].timer));
+    TEST_ASSERT_EQUAL_UINT64(0, entries[i].due);
+  }
+  for (int l = 0; l < TW_LEVELS; l++)
+    TEST_ASSERT_EQUAL_UINT64(0, tw->pending[l]);
+  timer_wheel_free(tw);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_timer_wheel_create_failed);
+  RUN_TEST(test_timer_wheel_basic);
+  RUN_TEST(test_timer_wheel_random);
+
+  return UNITY_END();
+}
@@ -0,0 +1,215 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mock_mem_functions.h" //this header allow to use set_mem_functions() to redefine original
+#include "ws_pool.h"
+
+#include "unity.h"
+
+#define THIEVES 3
+#define ITEMS 200000
+#define BITS 14
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// this mock to test code if malloc returns NULL
+void *mock_malloc(size_t size) {
+  return NULL; // Simulate memory allocation failure
+}
+
+void test_ws_pool_create_failed(void) {
+  set_memory_functions(mock_malloc, calloc, realloc, free);
+  TEST_ASSERT_NULL(ws_deque_create(16));
+  TEST_ASSERT_NULL(ws_pool_create(2));
+  set_memory_functions(malloc, calloc, realloc, free);
+  TEST_ASSERT_EQUAL_INT(-1, ws_pool_for(NULL, 0, 1, 0, NULL, NULL));
+}
+
+void test_ws_deque_single(void) {
+  ws_deque_t *q = ws_deque_create(0);
+  TEST_ASSERT_NOT_NULL(q);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)q % HT_CACHELINE_SIZE);
+  void *p = NULL;
+  TEST_ASSERT_EQUAL_INT(-1, ws_deque_pop(q, &p));
+  TEST_ASSERT_EQUAL_INT(-1, ws_deque_steal(q, &p));
+
+  // grows past the initial array, owner pops LIFO, thieves take FIFO
+  for (uintptr_t i = 0; i < 1000; i++)
+    TEST_ASSERT_EQUAL_INT(0, ws_deque_push(q, (void *)i));
+  TEST_ASSERT_EQUAL_size_t(1000, ws_deque_count(q));
+  TEST_ASSERT_NOT_NULL(q->array->prev);
+  TEST_ASSERT_EQUAL_INT(0, ws_deque_pop(q, &p));
+  TEST_ASSERT_EQUAL_PTR((void *)999, p);
+  TEST_ASSERT_EQUAL_INT(0, ws_deque_steal(q, &p));
+  TEST_ASSERT_EQUAL_PTR((void *)0, p);
+  for (uintptr_t i = 998; i > 0; i--) {
+    TEST_ASSERT_EQUAL_INT(0, ws_deque_pop(q, &p));
+    TEST_ASSERT_EQUAL_PTR((void *)i, p);
+  }
+  TEST_ASSERT_EQUAL_INT(-1, ws_deque_pop(q, &p));
+  TEST_ASSERT_EQUAL_size_t(0, ws_deque_count(q));
+  ws_deque_free(q);
+}
+
+struct thief {
+  pthread_t tid;
+  ws_deque_t *q;
+  volatile int *stop;
+  uint64_t sum;
+  size_t count;
+};
+
+static void *thief_run(void *arg) {
+  struct thief *t = arg;
+  void *p;
+  for (;;) {
+    int ret = ws_deque_steal(t->q, &p);
+    if (ret == 0) {
+      t->sum += (uintptr_t)p;
+      t->count++;
+    } else if (ret < 0) {
+      if (__atomic_load_n(t->stop, __ATOMIC_ACQUIRE)) break;
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+// the owner pushes and pops while thieves steal, every element is taken exactly once
+void test_ws_deque_threads(void) {
+  ws_deque_t *q = ws_deque_create(0);
+  TEST_ASSERT_NOT_NULL(q);
+  volatile int stop = 0;
+  struct thief t[THIEVES];
+  for (int i = 0; i < THIEVES; i++) {
+    t[i] = (struct thief){.q = q, .stop = &stop};
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&t[i].tid, NULL, thief_run, &t[i]));
+  }
+
+  uint64_t sum = 0;
+  size_t count = 0;
+  void *p;
+  for (uintptr_t i = 1; i <= ITEMS; i++) {
+    TEST_ASSERT_EQUAL_INT(0, ws_deque_push(q, (void *)i));
+    if (i % 3 == 0 && ws_deque_pop(q, &p) == 0) {
+      sum += (uintptr_t)p;
+      count++;
+    }
+    if (i % 1024 == 0) sched_yield();
+  }
+  while (ws_deque_pop(q, &p) == 0) {
+    sum += (uintptr_t)p;
+    count++;
+  }
+  __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+  for (int i = 0; i < THIEVES; i++) {
+    pthread_join(t[i].tid, NULL);
+    sum += t[i].sum;
+    count += t[i].count;
+  }
+  TEST_ASSERT_EQUAL_size_t(ITEMS, count);
+  TEST_ASSERT_EQUAL_UINT64((uint64_t)ITEMS * (ITEMS + 1) / 2, sum);
+  ws_deque_free(q);
+}
+
+static uint8_t visited[ITEMS];
+
+static void visit_range(size_t lo, size_t hi, void *arg) {
+  size_t *calls = arg;
+  __atomic_fetch_add(calls, 1, __ATOMIC_RELAXED);
+  for (size_t i = lo; i < hi; i++)
+    __atomic_fetch_add(&visited[i], 1, __ATOMIC_RELAXED);
+}
+
+static void check_for(ws_pool_t *pool, size_t begin, size_t end, size_t grain) {
+  size_t calls = 0;
+  memset(visited, 0, sizeof(visited));
+  TEST_ASSERT_EQUAL_INT(0, ws_pool_for(pool, begin, end, grain, visit_range, &calls));
+  for (size_t i = 0; i < ITEMS; i++)
+    TEST_ASSERT_EQUAL_UINT8(i >= begin && i < end, visited[i]);
+  if (grain && end - begin > grain) TEST_ASSERT_TRUE(calls > 1);
+}
+
+void test_ws_pool_for(void) {
+  ws_pool_t *pool = ws_pool_create(3);
+  TEST_ASSERT_NOT_NULL(pool);
+  TEST_ASSERT_EQUAL_INT(0, ws_pool_for(pool, 5, 5, 0, visit_range, NULL));
+  TEST_ASSERT_EQUAL_INT(-1, ws_pool_for(pool, 6, 5, 0, visit_range, NULL));
+  check_for(pool, 0, ITEMS, 0);
+  check_for(pool, 17, ITEMS - 3, 1);
+  check_for(pool, 100, 1100, 7);
+  check_for(pool, 3, 4, 0);
+  ws_pool_free(pool);
+
+  // without workers the caller runs the whole loop
+  pool = ws_pool_create(0);
+  TEST_ASSERT_NOT_NULL(pool);
+  check_for(pool, 0, ITEMS, 100);
+  ws_pool_free(pool);
+}
+
+struct item {
+  struct hlist_node node;
+  uint32_t key;
+};
+
+static void count_buckets(hashtable_t *ht, size_t lo, size_t hi, void *arg) {
+  size_t n = 0;
+  for (size_t bkt = lo; bkt < hi; bkt++) {
+    struct item *it;
+    hlist_for_each_entry(it, &ht->table[bkt], node) {
+      if (ht_bkt(ht, hash_32(it->key, 32)) == bkt) n++;
+    }
+  }
+  __atomic_fetch_add((size_t *)arg, n, __ATOMIC_RELAXED);
+}
+
+static void free_buckets(hashtable_t *ht, size_t lo, size_t hi, void *arg) {
+  for (size_t bkt = lo; bkt < hi; bkt++) {
+    struct item *it;
+    struct hlist_node *tmp;
+    hlist_for_each_entry_safe(it, tmp, &ht->table[bkt], node) {
+      hlist_del(&it->node);
+      free(it);
+    }
+  }
+}
+
+// parallel stats scan and teardown of a table, split by bucket ranges
+void test_ws_pool_for_buckets(void) {
+  ws_pool_t *pool = ws_pool_create(3);
+  TEST_ASSERT_NOT_NULL(pool);
+  hashtable_t *ht = ht_create(BITS);
+  TEST_ASSERT_NOT_NULL(ht);
+  for (uint32_t i = 0; i < ITEMS; i++) {
+    struct item *it = malloc(sizeof(*it));
+    TEST_ASSERT_NOT_NULL(it);
+    it->key = i;
+    hashtable_add(ht, &it->node, hash_32(i, 32));
+  }
+
+  size_t count = 0;
+  TEST_ASSERT_EQUAL_INT(-1, ws_pool_for_buckets(pool, NULL, 0, count_buckets, &count));
+  TEST_ASSERT_EQUAL_INT(0, ws_pool_for_buckets(pool, ht, 64, count_buckets, &count));
+  TEST_ASSERT_EQUAL_size_t(ITEMS, count);
+  TEST_ASSERT_EQUAL_INT(0, ws_pool_for_buckets(pool, ht, 0, free_buckets, NULL));
+  TEST_ASSERT_TRUE(__hash_empty(ht->table, ht->size));
+
+  ht_destroy(ht);
+  ws_pool_free(pool);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+
+  RUN_TEST(test_ws_pool_create_failed);
+  RUN_TEST(test_ws_deque_single);
+  RUN_TEST(test_ws_deque_threads);
+  RUN_TEST(test_ws_pool_for);
+  RUN_TEST(test_ws_pool_for_buckets);
+
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "mock_mem_functions.h"
+#include "timer_wheel.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+
+/**
+ * timer_wheel_create - create an empty timing wheel
+ * @now: current tick, timers armed later must expire after it
+ *
+ * Returns the new wheel or NULL on failure.
+ */
+timer_wheel_t *timer_wheel_create(uint64_t now) {
+  timer_wheel_t *tw = malloc(sizeof(timer_wheel_t));
+  if (!tw) return NULL;
+  tw->now = now;
+  tw->count = 0;
+  for (int l = 0; l < TW_LEVELS; l++)
+    tw->pending[l] = 0;
+  __hash_init(tw->wheel, TW_LEVELS * TW_SLOTS);
+  return tw;
+}
+
+// free the wheel, armed timers are not touched and stay hashed
+void timer_wheel_free(timer_wheel_t *tw) {
+  free(tw);
+}
+
+/*
+ * Hash a timer relative to tw->now: the level is the highest digit where
+ * expiry and now differ, so the timer's slot comes due exactly when now
+ * reaches that digit of its expiry. An expiry of now itself lands in the
+ * level 0 slot of the current tick.
+ */
+static void tw_place(timer_wheel_t *tw, struct tw_timer *t) {
+  uint64_t diff = t->expires ^ tw->now;
+  unsigned level = diff ? (63 - __builtin_clzll(diff)) / TW_SLOT_BITS : 0;
+  unsigned slot = (t->expires >> (level * TW_SLOT_BITS)) & TW_SLOT_MASK;
+
+  t->slot = level * TW_SLOTS + slot;
+  hlist_add_head(&t->node, &tw->wheel[t->slot]);
+  tw->pending[level] |= 1ULL << slot;
+}
+
+static void tw_unlink(timer_wheel_t *tw, struct tw_timer *t) {
+  hlist_del_init(&t->node);
+  if (hlist_empty(&tw->wheel[t->slot]))
+    tw->pending[t->slot / TW_SLOTS] &= ~(1ULL << (t->slot & TW_SLOT_MASK));
+}
+
+/**
+ * timer_wheel_arm - arm a timer that is not armed
+ * @tw: wheel
+ * @t: timer, set up with tw_timer_init()
+ * @expires: tick to fire at, ticks not after tw->now fire on the next tick
+ */
+void timer_wheel_arm(timer_wheel_t *tw, struct tw_timer *t, uint64_t expires) {
+  t->expires = expires > tw->now ? expires : tw->now + 1;
+  tw_place(tw, t);
+  tw->count++;
+}
+
+// move a timer to a new expiry, arming it if it is not armed
+void timer_wheel_rearm(timer_wheel_t *tw, struct tw_timer *t, uint64_t expires) {
+  if (tw_timer_armed(t)) {
+    tw_unlink(tw, t);
+    tw->count--;
+  }
+  timer_wheel_arm(tw, t, expires);
+}
+
+// disarm a timer, nothing happens if it is not armed
+void timer_wheel_cancel(timer_wheel_t *tw, struct tw_timer *t) {
+  if (!tw_timer_armed(t)) return;
+  tw_unlink(tw, t);
+  tw->count--;
+}
+
+// rehash the timers of a slot that came due, they all go to lower levels
+static void tw_cascade(timer_wheel_t *tw, unsigned level) {
+  unsigned slot = (tw->now >> (level * TW_SLOT_BITS)) & TW_SLOT_MASK;
+  if (!(tw->pending[level] & (1ULL << slot))) return;
+
+  struct hlist_head list;
+  hlist_move_list(&tw->wheel[level * TW_SLOTS + slot], &list);
+  tw->pending[level] &= ~(1ULL << slot);
+  while (list.first) {
+    struct tw_timer *t = hlist_entry(list.first, struct tw_timer, node);
+    hlist_del(&t->node);
+    tw_place(tw, t);
+  }
+}
+
+/*
+ * Fire the level 0 slot of the current tick. The slot is detached first,
+ * so callbacks may re-arm the timer they get or cancel any other one,
+ * including timers of the same batch still waiting to fire.
+ */
+static size_t tw_expire(timer_wheel_t *tw, void (*fn)(struct tw_timer *t, void *arg), void *arg) {
+  unsigned slot = tw->now & TW_SLOT_MASK;
+  if (!(tw->pending[0] & (1ULL << slot))) return 0;
+
+  struct hlist_head batch;
+  hlist_move_list(&tw->wheel[slot], &batch);
+  tw->pending[0] &= ~(1ULL << slot);
+  size_t n = 0;
+  while (batch.first) {
+    struct tw_timer *t = hlist_entry(batch.first, struct tw_timer, node);
+    hlist_del_init(&t->node);
+    tw->count--;
+    n++;
+    fn(t, arg);
+  }
+  return n;
+}
+
+/*
+ * Next tick with work, 0 if the wheel is empty. Every timer on level L
+ * shares the digits above L with tw->now and has a larger digit L, so the
+ * first occupied slot above the current digit of each level gives the
+ * tick that level comes due at; the earliest of them wins.
+ */
+static uint64_t tw_next_tick(const timer_wheel_t *tw) {
+  uint64_t next = 0;
+
+  for (unsigned level = 0; level < TW_LEVELS; level++) {
+    unsigned shift = level * TW_SLOT_BITS;
+    unsigned digit = (tw->now >> shift) & TW_SLOT_MASK;
+    uint64_t occupied = tw->pending[level] & (~1ULL << digit);
+    if (!occupied) continue;
+    uint64_t above = shift + TW_SLOT_BITS < 64 ? tw->now >> (shift + TW_SLOT_BITS) << (shift + TW_SLOT_BITS) : 0;
+    uint64_t tick = above | (uint64_t)__builtin_ctzll(occupied) << shift;
+    if (!next || tick < next) next = tick;
+  }
+  return next;
+}
+
+/**
+ * timer_wheel_advance - process all ticks up to @now
+ * @tw: wheel
+ * @now: new current tick, earlier values are ignored
+ * @fn: called for every timer that expires, in tick order; the timer is
+ *      disarmed by then and tw->now is its expiry
+ * @arg: passed to @fn
+ *
+ * Jumps straight from one tick with a due slot to the next, ticks without
+ * work are never visited. Returns the number of timers fired.
+ */
+size_t timer_wheel_advance(timer_wheel_t *tw, uint64_t now, void (*fn)(struct tw_timer *t, void *arg), void *arg) {
+  size_t fired = 0;
+
+  while (tw->now < now) {
+    uint64_t tick = tw_next_tick(tw);
+    if (!tick || tick > now) {
+      tw->now = now;
+      break;
+    }
+    tw->now = tick;
+    if (!(tick & TW_SLOT_MASK)) {
+      // digits that rolled over, highest first so cascaded timers never land in a slot still to cascade
+      unsigned top = __builtin_ctzll(tick) / TW_SLOT_BITS;
+      if (top > TW_LEVELS - 1) top = TW_LEVELS - 1;
+      for (unsigned level = top; level > 0; level--)
+        tw_cascade(tw, level);
+    }
+    fired += tw_expire(tw, fn, arg);
+  }
+  return fired;
+}
@@ -0,0 +1,64 @@
+/*
+ * Hierarchical timing wheel (Varghese and Lauck) for per-entry timeouts
+ *
+ * Timers are hlist nodes hashed into the same struct hlist_head buckets as
+ * hashtable.h: TW_LEVELS wheels of TW_SLOTS slots, level L covering ticks
+ * in units of TW_SLOTS^L. A timer goes to the level of the highest 6-bit
+ * digit in which its expiry differs from the current time, and to the
+ * slot given by that digit of its expiry. Arming, re-arming and
+ * cancelling are O(1), whatever the number of timers.
+ *
+ * timer_wheel_advance() moves time forward: whenever a level's digit rolls
+ * over, the slot coming due is cascaded to lower levels; the level 0 slot
+ * of each tick is detached as a whole and its timers fired as one batch.
+ * Per-level bitmaps of occupied slots give the next tick with work
+ * directly, so advancing costs one step per slot coming due and nothing
+ * per idle tick. Aging a table is then proportional to the entries that
+ * expire, never to the table size.
+ *
+ * 11 levels of 64 slots cover every 64-bit expiry, nothing ever overflows.
+ * The wheel is not thread-safe.
+ */
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdint.h>
+
+#include "hashtable.h"
+
+#define TW_SLOT_BITS 6
+#define TW_SLOTS (1U << TW_SLOT_BITS)
+#define TW_LEVELS ((64 + TW_SLOT_BITS - 1) / TW_SLOT_BITS)
+
+// embedded in the objects to time out
+struct tw_timer {
+  struct hlist_node node; // unhashed while not armed
+  uint64_t expires;       // tick the timer fires at
+  uint32_t slot;          // level * TW_SLOTS + slot of the bucket holding the timer
+};
+
+typedef struct timer_wheel {
+  uint64_t now;                                 // last tick processed
+  size_t count;                                 // armed timers
+  uint64_t pending[TW_LEVELS];                  // occupied slots of every level
+  struct hlist_head wheel[TW_LEVELS * TW_SLOTS];
+} timer_wheel_t;
+
+timer_wheel_t *timer_wheel_create(uint64_t now);
+void timer_wheel_free(timer_wheel_t *tw);
+
+void timer_wheel_arm(timer_wheel_t *tw, struct tw_timer *t, uint64_t expires);
+void timer_wheel_rearm(timer_wheel_t *tw, struct tw_timer *t, uint64_t expires);
+void timer_wheel_cancel(timer_wheel_t *tw, struct tw_timer *t);
+size_t timer_wheel_advance(timer_wheel_t *tw, uint64_t now, void (*fn)(struct tw_timer *t, void *arg), void *arg);
+
+static inline void tw_timer_init(struct tw_timer *t) {
+  INIT_HLIST_NODE(&t->node);
+}
+
+static inline int tw_timer_armed(const struct tw_timer *t) {
+  return !hlist_unhashed(&t->node);
+}
+
+#endif
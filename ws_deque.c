@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "mock_mem_functions.h"
+#include "ws_deque.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+static struct ws_array *ws_array_alloc(size_t cap) {
+  if (cap > (SIZE_MAX - sizeof(struct ws_array)) / sizeof(void *)) return NULL;
+  struct ws_array *a = malloc(sizeof(*a) + cap * sizeof(void *));
+  if (!a) return NULL;
+  a->prev = NULL;
+  a->mask = cap - 1;
+  return a;
+}
+
+/**
+ * ws_deque_init - initialize an embedded work-stealing deque
+ * @q: deque
+ * @capacity: initial number of slots, rounded up to a power of two, at least WS_DEQUE_MIN_CAPACITY
+ *
+ * Returns 0 or -1 on allocation failure.
+ */
+int ws_deque_init(ws_deque_t *q, size_t capacity) {
+  size_t cap = WS_DEQUE_MIN_CAPACITY;
+  while (cap < capacity) {
+    if (cap > SIZE_MAX / 2) return -1;
+    cap <<= 1;
+  }
+  q->array = ws_array_alloc(cap);
+  if (!q->array) return -1;
+  q->top = q->bottom = 0;
+  return 0;
+}
+
+// release the arrays of a deque set up with ws_deque_init(), no thief may still use it
+void ws_deque_destroy(ws_deque_t *q) {
+  struct ws_array *a = q->array;
+  while (a) {
+    struct ws_array *prev = a->prev;
+    free(a);
+    a = prev;
+  }
+  q->array = NULL;
+}
+
+ws_deque_t *ws_deque_create(size_t capacity) {
+  void *mem;
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, sizeof(ws_deque_t))) return NULL;
+  ws_deque_t *q = mem;
+  if (ws_deque_init(q, capacity)) {
+    free(q);
+    return NULL;
+  }
+  return q;
+}
+
+// free the deque, queued pointers are not touched
+void ws_deque_free(ws_deque_t *q) {
+  if (!q) return;
+  ws_deque_destroy(q);
+  free(q);
+}
+
+/*
+ * Double the array holding the elements top..bottom-1. Thieves keep
+ * reading the old array until they load the new pointer, the slots they
+ * can still claim hold the same values in both.
+ */
+static struct ws_array *ws_deque_grow(ws_deque_t *q, struct ws_array *a, long top, long bottom) {
+  if (a->mask + 1 > SIZE_MAX / 2) return NULL;
+  struct ws_array *n = ws_array_alloc((a->mask + 1) * 2);
+  if (!n) return NULL;
+  for (long i = top; i < bottom; i++)
+    n->buf[i & n->mask] = __atomic_load_n(&a->buf[i & a->mask], __ATOMIC_RELAXED);
+  n->prev = a;
+  __atomic_store_n(&q->array, n, __ATOMIC_RELEASE);
+  return n;
+}
+
+/**
+ * ws_deque_push - add a pointer at the bottom, owner only
+ * @q: deque
+ * @data: pointer to add
+ *
+ * Returns 0 or -1 if the array had to grow and allocation failed.
+ */
+int ws_deque_push(ws_deque_t *q, void *data) {
+  long bottom = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED);
+  long top = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+  struct ws_array *a = __atomic_load_n(&q->array, __ATOMIC_RELAXED);
+
+  if ((size_t)(bottom - top) > a->mask) {
+    a = ws_deque_grow(q, a, top, bottom);
+    if (!a) return -1;
+  }
+  __atomic_store_n(&a->buf[bottom & a->mask], data, __ATOMIC_RELAXED);
+  // publishes the slot to thieves
+  __atomic_store_n(&q->bottom, bottom + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * ws_deque_pop - take the pointer at the bottom, owner only
+ * @q: deque
+ * @data: receives the pointer
+ *
+ * Returns 0 or -1 if the deque is empty.
+ */
+int ws_deque_pop(ws_deque_t *q, void **data) {
+  long bottom = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED) - 1;
+  struct ws_array *a = __atomic_load_n(&q->array, __ATOMIC_RELAXED);
+
+  // reserve the slot before looking at top, pairs with the fence in ws_deque_steal()
+  __atomic_store_n(&q->bottom, bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  long top = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+
+  if (top > bottom) {
+    __atomic_store_n(&q->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return -1;
+  }
+  *data = __atomic_load_n(&a->buf[bottom & a->mask], __ATOMIC_RELAXED);
+  if (top < bottom) return 0;
+
+  // last element: race the thieves for it by moving top past it
+  int ret = __atomic_compare_exchange_n(&q->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) ? 0 : -1;
+  __atomic_store_n(&q->bottom, bottom + 1, __ATOMIC_RELAXED);
+  return ret;
+}
+
+/**
+ * ws_deque_steal - take the pointer at the top, any thread
+ * @q: deque
+ * @data: receives the pointer
+ *
+ * Returns 0, -1 if the deque is empty or WS_DEQUE_ABORT if another thread
+ * took the element first.
+ */
+int ws_deque_steal(ws_deque_t *q, void **data) {
+  long top = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  long bottom = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+
+  if (top >= bottom) return -1;
+  struct ws_array *a = __atomic_load_n(&q->array, __ATOMIC_ACQUIRE);
+  void *p = __atomic_load_n(&a->buf[top & a->mask], __ATOMIC_RELAXED);
+  if (!__atomic_compare_exchange_n(&q->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    return WS_DEQUE_ABORT;
+  *data = p;
+  return 0;
+}
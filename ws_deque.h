@@ -0,0 +1,58 @@
+/*
+ * Lock-free work-stealing deque (Chase and Lev, with the memory orders of
+ * Le, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing
+ * for Weak Memory Models")
+ *
+ * One owner thread pushes and pops at the bottom, any number of thieves
+ * steal from the top. The owner only pays a fence on pop and a CAS when it
+ * races a thief for the last element; thieves contend on one CAS of 'top'.
+ * The circular array grows on push and is never shrunk. Replaced arrays
+ * can still be read by a thief that loaded the old pointer, so they are
+ * kept on a list until ws_deque_free().
+ */
+
+#ifndef __WS_DEQUE_H__
+#define __WS_DEQUE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ht_lock.h"
+
+#define WS_DEQUE_MIN_CAPACITY 64
+
+// ws_deque_steal() result when it lost the race for an element, the deque may still hold others
+#define WS_DEQUE_ABORT 1
+
+struct ws_array {
+  struct ws_array *prev; // array replaced by this one, released by ws_deque_free()
+  size_t mask;           // capacity - 1
+  void *buf[];
+};
+
+typedef struct ws_deque {
+  long top __attribute__((aligned(HT_CACHELINE_SIZE)));    // next element to steal, only ever incremented
+  long bottom __attribute__((aligned(HT_CACHELINE_SIZE))); // next free slot, owner only
+  struct ws_array *array;
+} ws_deque_t;
+
+int ws_deque_init(ws_deque_t *q, size_t capacity);
+void ws_deque_destroy(ws_deque_t *q);
+ws_deque_t *ws_deque_create(size_t capacity);
+void ws_deque_free(ws_deque_t *q);
+
+// owner side
+int ws_deque_push(ws_deque_t *q, void *data);
+int ws_deque_pop(ws_deque_t *q, void **data);
+
+// any thread
+int ws_deque_steal(ws_deque_t *q, void **data);
+
+// number of queued elements, a snapshot that may be stale right away
+static inline size_t ws_deque_count(const ws_deque_t *q) {
+  long top = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+  long bottom = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+  return bottom > top ? (size_t)(bottom - top) : 0;
+}
+
+#endif
@@ -0,0 +1,260 @@
+#include <sched.h>
+#include <stdlib.h>
+
+#ifdef JEMALLOC
+#include "jemalloc.h"
+#endif
+#include "mock_mem_functions.h"
+#include "ws_pool.h"
+
+// redefine mem functions with custom version
+#define malloc custom_malloc
+#define free custom_free
+
+// a loop is never cut into more than this many ranges per thread, bounding the task slots of a job
+#define WS_POOL_SPLITS 64
+
+struct ws_task {
+  size_t lo, hi;
+};
+
+struct ws_job {
+  void (*fn)(size_t lo, size_t hi, void *arg);
+  void *arg;
+  size_t grain;
+  size_t remaining;      // indices not processed yet, the loop is done at 0
+  size_t next_task;      // next free slot in 'tasks'
+  size_t ntasks;
+  struct ws_task *tasks; // ranges pushed on the deques
+};
+
+static uint32_t ws_rand(struct ws_worker *w) {
+  uint32_t x = w->rnd;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return w->rnd = x;
+}
+
+// steal from the other deques, starting at a random one
+static int ws_steal(struct ws_worker *w, void **task) {
+  ws_pool_t *pool = w->pool;
+  unsigned n = pool->nworkers + 1;
+  unsigned start = ws_rand(w) % n;
+
+  for (unsigned i = 0; i < n; i++) {
+    struct ws_worker *victim = &pool->workers[(start + i) % n];
+    if (victim != w && ws_deque_steal(&victim->deque, task) == 0) return 0;
+  }
+  return -1;
+}
+
+/*
+ * Process a range: keep pushing its upper half for thieves until it is
+ * down to the grain, then run the loop body on what is left. Running out
+ * of task slots or deque memory only means the range is not split further.
+ */
+static void ws_run(struct ws_worker *w, struct ws_job *job, struct ws_task *t) {
+  size_t lo = t->lo, hi = t->hi;
+
+  while (hi - lo > job->grain) {
+    size_t slot = __atomic_fetch_add(&job->next_task, 1, __ATOMIC_RELAXED);
+    if (slot >= job->ntasks) break;
+    size_t mid = lo + (hi - lo) / 2;
+    job->tasks[slot] = (struct ws_task){mid, hi};
+    if (ws_deque_push(&w->deque, &job->tasks[slot])) break;
+    hi = mid;
+  }
+  job->fn(lo, hi, job->arg);
+  // publishes what fn did to the ws_pool_for() caller
+  __atomic_fetch_sub(&job->remaining, hi - lo, __ATOMIC_ACQ_REL);
+}
+
+static void ws_work(struct ws_worker *w, struct ws_job *job) {
+  void *task;
+
+  while (__atomic_load_n(&job->remaining, __ATOMIC_ACQUIRE)) {
+    if (ws_deque_pop(&w->deque, &task) == 0 || ws_steal(w, &task) == 0)
+      ws_run(w, job, task);
+    else
+      sched_yield();
+  }
+}
+
+static void *ws_worker_run(void *arg) {
+  struct ws_worker *w = arg;
+  ws_pool_t *pool = w->pool;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->stop && pool->gen == seen)
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    if (pool->stop) break;
+    seen = pool->gen;
+    struct ws_job *job = pool->job;
+    if (!job) continue; // woke up after the loop already finished
+    pool->busy++;
+    pthread_mutex_unlock(&pool->lock);
+
+    ws_work(w, job);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->busy == 0) pthread_cond_signal(&pool->idle);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+static void ws_pool_stop(ws_pool_t *pool, unsigned started) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (unsigned i = 1; i <= started; i++)
+    pthread_join(pool->workers[i].tid, NULL);
+}
+
+static void ws_pool_release(ws_pool_t *pool, unsigned ndeques) {
+  for (unsigned i = 0; i < ndeques; i++)
+    ws_deque_destroy(&pool->workers[i].deque);
+  free(pool->workers);
+  pthread_mutex_destroy(&pool->run_lock);
+  pthread_cond_destroy(&pool->idle);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
+
+/**
+ * ws_pool_create - start a work-stealing executor
+ * @nthreads: number of worker threads, 0 runs every loop on the calling thread
+ *
+ * Returns the new pool or NULL on failure.
+ */
+ws_pool_t *ws_pool_create(unsigned nthreads) {
+  ws_pool_t *pool = malloc(sizeof(*pool));
+  if (!pool) return NULL;
+  *pool = (ws_pool_t){.nworkers = nthreads};
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+  pthread_mutex_init(&pool->run_lock, NULL);
+
+  void *mem;
+  if (posix_memalign(&mem, HT_CACHELINE_SIZE, (nthreads + 1) * sizeof(struct ws_worker))) {
+    pool->workers = NULL;
+    ws_pool_release(pool, 0);
+    return NULL;
+  }
+  pool->workers = mem;
+
+  for (unsigned i = 0; i <= nthreads; i++) {
+    struct ws_worker *w = &pool->workers[i];
+    w->pool = pool;
+    w->rnd = 2654435761U * (i + 1);
+    if (ws_deque_init(&w->deque, WS_DEQUE_MIN_CAPACITY)) {
+      ws_pool_release(pool, i);
+      return NULL;
+    }
+  }
+  for (unsigned i = 1; i <= nthreads; i++) {
+    if (pthread_create(&pool->workers[i].tid, NULL, ws_worker_run, &pool->workers[i])) {
+      ws_pool_stop(pool, i - 1);
+      ws_pool_release(pool, nthreads + 1);
+      return NULL;
+    }
+  }
+  return pool;
+}
+
+// stop the workers and free the pool, no loop may be running
+void ws_pool_free(ws_pool_t *pool) {
+  if (!pool) return;
+  ws_pool_stop(pool, pool->nworkers);
+  ws_pool_release(pool, pool->nworkers + 1);
+}
+
+/**
+ * ws_pool_for - run @fn over [@begin, @end) on all threads of the pool
+ * @pool: executor
+ * @begin: first index
+ * @end: index past the last one
+ * @grain: ranges up to this size are not split, 0 picks one from the thread count;
+ *         it is raised so that a loop is never cut into more than
+ *         WS_POOL_SPLITS ranges per thread
+ * @fn: loop body, called with disjoint [lo, hi) ranges covering the loop
+ * @arg: passed to @fn
+ *
+ * Returns 0 once every range was processed, -1 on invalid arguments or
+ * allocation failure, in which case @fn was not called.
+ */
+int ws_pool_for(ws_pool_t *pool, size_t begin, size_t end, size_t grain,
+                void (*fn)(size_t lo, size_t hi, void *arg), void *arg) {
+  if (!pool || !fn || begin > end) return -1;
+  if (begin == end) return 0;
+
+  size_t n = end - begin, threads = pool->nworkers + 1;
+  size_t min_grain = n / (WS_POOL_SPLITS * threads) + 1;
+  if (!grain) grain = n / (8 * threads) + 1;
+  if (grain < min_grain) grain = min_grain;
+
+  struct ws_job job = {.fn = fn, .arg = arg, .grain = grain, .remaining = n, .next_task = 1};
+  // halving stops at ranges of at least grain / 2, so there are fewer than 2 * n / grain of them
+  job.ntasks = 2 * (n / grain) + 2;
+  job.tasks = malloc(job.ntasks * sizeof(struct ws_task));
+  if (!job.tasks) return -1;
+  job.tasks[0] = (struct ws_task){begin, end};
+
+  pthread_mutex_lock(&pool->run_lock);
+  struct ws_worker *self = &pool->workers[0];
+  if (ws_deque_push(&self->deque, &job.tasks[0])) {
+    fn(begin, end, arg); // cannot happen on the empty deque, but never lose the loop
+  } else {
+    pthread_mutex_lock(&pool->lock);
+    pool->job = &job;
+    pool->gen++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    ws_work(self, &job);
+
+    // workers may still be about to look at the finished job
+    pthread_mutex_lock(&pool->lock);
+    pool->job = NULL;
+    while (pool->busy)
+      pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  pthread_mutex_unlock(&pool->run_lock);
+  free(job.tasks);
+  return 0;
+}
+
+struct ws_bucket_loop {
+  hashtable_t *ht;
+  void (*fn)(hashtable_t *ht, size_t lo, size_t hi, void *arg);
+  void *arg;
+};
+
+static void ws_bucket_range(size_t lo, size_t hi, void *arg) {
+  struct ws_bucket_loop *loop = arg;
+  loop->fn(loop->ht, lo, hi, loop->arg);
+}
+
+/**
+ * ws_pool_for_buckets - run @fn over the bucket indices of @ht on all threads of the pool
+ * @pool: executor
+ * @ht: table, its bucket array must not be replaced while the loop runs
+ * @grain: see ws_pool_for()
+ * @fn: loop body, owns the buckets [lo, hi) of ht->table during the call
+ * @arg: passed to @fn
+ *
+ * Returns 0 or -1 as ws_pool_for().
+ */
+int ws_pool_for_buckets(ws_pool_t *pool, hashtable_t *ht, size_t grain,
+                        void (*fn)(hashtable_t *ht, size_t lo, size_t hi, void *arg), void *arg) {
+  if (!ht || !fn) return -1;
+  struct ws_bucket_loop loop = {ht, fn, arg};
+  return ws_pool_for(pool, 0, ht->size, grain, ws_bucket_range, &loop);
+}
@@ -0,0 +1,57 @@
+/*
+ * Minimal work-stealing executor for parallel loops over index ranges
+ *
+ * Every worker owns a ws_deque_t. A range larger than the grain is halved,
+ * the upper half pushed on the own deque and the lower half processed
+ * further, so a worker works depth-first on its own data while idle
+ * workers steal the biggest pending halves from the top of other deques.
+ * The thread calling ws_pool_for() takes part in the loop on a deque of
+ * its own and returns once every index was processed.
+ *
+ * ws_pool_for_buckets() runs such a loop over the buckets of a hashtable_t,
+ * for bulk builds, teardowns and statistics scans. One loop runs at a time,
+ * concurrent ws_pool_for() callers are serialized.
+ */
+
+#ifndef __WS_POOL_H__
+#define __WS_POOL_H__
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "hashtable.h"
+#include "ws_deque.h"
+
+struct ws_pool;
+struct ws_job;
+
+// per-thread state, slot 0 is used by the thread running ws_pool_for()
+struct ws_worker {
+  ws_deque_t deque;
+  struct ws_pool *pool;
+  pthread_t tid;
+  uint32_t rnd; // victim selection state
+} __attribute__((aligned(HT_CACHELINE_SIZE)));
+
+typedef struct ws_pool {
+  pthread_mutex_t lock;  // guards the fields below
+  pthread_cond_t wake;   // a job was published or the pool is stopping
+  pthread_cond_t idle;   // the last worker left a job
+  struct ws_job *job;    // running loop, NULL between loops
+  unsigned long gen;     // bumped for every published job
+  unsigned busy;         // workers inside the running job
+  int stop;
+  pthread_mutex_t run_lock; // serializes ws_pool_for() callers
+  unsigned nworkers;        // worker threads, the caller is not counted
+  struct ws_worker *workers; // nworkers + 1 slots
+} ws_pool_t;
+
+ws_pool_t *ws_pool_create(unsigned nthreads);
+void ws_pool_free(ws_pool_t *pool);
+
+int ws_pool_for(ws_pool_t *pool, size_t begin, size_t end, size_t grain,
+                void (*fn)(size_t lo, size_t hi, void *arg), void *arg);
+int ws_pool_for_buckets(ws_pool_t *pool, hashtable_t *ht, size_t grain,
+                        void (*fn)(hashtable_t *ht, size_t lo, size_t hi, void *arg), void *arg);
+
+#endif